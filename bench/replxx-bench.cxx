@@ -0,0 +1,594 @@
+/*
+ * replxx-bench - replay scripted keystrokes against the editor
+ * and report its throughput and latency.
+ *
+ * Every workload runs in a child process (the benchmark re-executes
+ * itself with `--run`) attached to a pseudo-terminal, so the library
+ * sees a real terminal on its standard descriptors exactly as in an
+ * interactive session. The parent feeds the script through the master
+ * side, drains everything the editor paints and collects statistics
+ * the child reports over a pipe.
+ *
+ * With `--check <file>` quick variants of all workloads listed in
+ * the file are run and bytes and write calls they produced are compared
+ * against checked in thresholds. Output volume is deterministic for a given
+ * script and screen size, so any growth is a regression.
+ *
+ * Heap allocations are counted with replaced global operator new.
+ * Steady state allocations are those made by keystrokes of the last line
+ * in excess of the previous, shorter, line with the same structure.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <new>
+
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#ifdef __APPLE__
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#include "replxx.hxx"
+
+using Replxx = replxx::Replxx;
+
+namespace {
+
+std::atomic<long long> allocations( 0 );
+
+}
+
+void* operator new( size_t size_ ) {
+	++ allocations;
+	void* p( malloc( size_ > 0 ? size_ : 1 ) );
+	if ( ! p ) {
+		throw std::bad_alloc();
+	}
+	return ( p );
+}
+
+void* operator new[]( size_t size_ ) {
+	return ( operator new( size_ ) );
+}
+
+void operator delete( void* p_ ) noexcept {
+	free( p_ );
+}
+
+void operator delete[]( void* p_ ) noexcept {
+	free( p_ );
+}
+
+void operator delete( void* p_, size_t ) noexcept {
+	free( p_ );
+}
+
+void operator delete[]( void* p_, size_t ) noexcept {
+	free( p_ );
+}
+
+namespace {
+
+int const SCREEN_ROWS = 50;
+int const SCREEN_COLUMNS = 120;
+
+struct Workload {
+	char const* name;
+	char const* description;
+	void (*setup)( Replxx&, int scale );
+	std::string (*script)( int scale );
+};
+
+void setup_typing( Replxx&, int ) {
+}
+
+std::string script_typing( int scale_ ) {
+	int len( 10 * 1024 / scale_ );
+	std::string s;
+	s.reserve( len + 2 );
+	for ( int i( 0 ); i < len; ++ i ) {
+		s.push_back( ( i % 8 ) == 7 ? ' ' : static_cast<char>( 'a' + ( i % 26 ) ) );
+	}
+	s.append( "\r\x04" );
+	return ( s );
+}
+
+int history_size( int scale_ ) {
+	return ( 1000 * 1000 / scale_ );
+}
+
+void setup_search( Replxx& replxx_, int scale_ ) {
+	int size( history_size( scale_ ) );
+	replxx_.set_max_history_size( size + 1 );
+	for ( int i( 0 ); i < size; ++ i ) {
+		replxx_.history_add( "command-" + std::to_string( i ) + " --option=" + std::to_string( i % 97 ) );
+	}
+}
+
+std::string script_search( int scale_ ) {
+	return ( "\x12" "command-" + std::to_string( history_size( scale_ ) / 2 ) + "\r\x04" );
+}
+
+void setup_completion( Replxx& replxx_, int scale_ ) {
+	int count( 100 * 1000 / scale_ );
+	std::vector<std::string> candidates;
+	candidates.reserve( count );
+	char buf[32];
+	for ( int i( 0 ); i < count; ++ i ) {
+		snprintf( buf, sizeof ( buf ), "candidate%06d", i );
+		candidates.emplace_back( buf );
+	}
+	replxx_.set_streaming_completion_callback(
+		[candidates]( std::string const& input_, int& contextLen_, Replxx::CompletionSink& sink_ ) {
+			std::string::size_type wordStart( input_.find_last_of( ' ' ) );
+			wordStart = wordStart == std::string::npos ? 0 : wordStart + 1;
+			contextLen_ = static_cast<int>( input_.length() - wordStart );
+			for ( std::string const& c : candidates ) {
+				if ( c.compare( 0, contextLen_, input_, wordStart, contextLen_ ) == 0 ) {
+					sink_.add( c );
+				}
+			}
+		}
+	);
+}
+
+std::string script_completion( int ) {
+	return ( "cand\t\tyq\r\x04" );
+}
+
+std::string last_word( std::string const& input_ ) {
+	std::string::size_type wordStart( input_.find_last_of( " (" ) );
+	return ( input_.substr( wordStart == std::string::npos ? 0 : wordStart + 1 ) );
+}
+
+void setup_editing( Replxx& replxx_, int ) {
+	replxx_.set_highlighter_callback(
+		[]( std::string const& input_, Replxx::colors_t& colors_ ) {
+			for ( int i( 0 ), len( static_cast<int>( std::min( input_.length(), colors_.size() ) ) ); i < len; ++ i ) {
+				char c( input_[i] );
+				if ( ( c >= '0' ) && ( c <= '9' ) ) {
+					colors_[i] = Replxx::Color::BRIGHTMAGENTA;
+				} else if ( ( c == '(' ) || ( c == ')' ) ) {
+					colors_[i] = Replxx::Color::BRIGHTBLUE;
+				}
+			}
+		}
+	);
+	replxx_.set_hint_callback(
+		[]( std::string const& input_, int& contextLen_, Replxx::Color& color_ ) {
+			static char const* const words[] = { "hello", "help", "hexagon", "world", "worldwide" };
+			Replxx::hints_t hints;
+			std::string word( last_word( input_ ) );
+			contextLen_ = static_cast<int>( word.length() );
+			color_ = Replxx::Color::GRAY;
+			if ( word.empty() ) {
+				return ( hints );
+			}
+			for ( char const* w : words ) {
+				if ( ! strncmp( w, word.c_str(), word.length() ) ) {
+					hints.emplace_back( w );
+				}
+			}
+			return ( hints );
+		}
+	);
+}
+
+std::string script_editing( int ) {
+	return (
+		"print( hello world 42 )"
+		"\x1b[D\x1b[D\x1b[D\x1b[D\x1b[D\x1b[D\x1b[D\x7f\x7f\x7f" "wor"
+		"\x0c\x01\x05\x17\x17" "he\r\x04"
+	);
+}
+
+void setup_history( Replxx& replxx_, int ) {
+	for ( int i( 0 ); i < 100; ++ i ) {
+		replxx_.history_add( "history entry number " + std::to_string( i ) );
+	}
+}
+
+void setup_steady( Replxx& replxx_, int scale_ ) {
+	setup_editing( replxx_, scale_ );
+	replxx_.set_hint_callback(
+		[]( std::string const&, int&, Replxx::Color& ) {
+			return ( Replxx::hints_t() );
+		}
+	);
+}
+
+/*
+ * Warm up line followed by two lines differing only in length,
+ * words are never broken so that history learns single token per line.
+ */
+std::string script_steady( int ) {
+	std::string s;
+	int const lengths[] = { 200, 50, 150 };
+	for ( int len : lengths ) {
+		for ( int i( 0 ); i < len; ++ i ) {
+			s.push_back( "abc(12)[x]"[i % 10] );
+		}
+		s.append( "\x1b[D\x1b[C\r" );
+	}
+	s.append( "\x04" );
+	return ( s );
+}
+
+/*
+ * Arrow through a wrapped statement full of braces.
+ */
+std::string script_motion( int ) {
+	std::string s;
+	for ( int i( 0 ); i < 20; ++ i ) {
+		s.append( "f(a[i], {1, 2}) " );
+	}
+	s.append( "\x01" );
+	for ( int i( 0 ); i < 320; ++ i ) {
+		s.append( "\x1b[C" );
+	}
+	for ( int i( 0 ); i < 40; ++ i ) {
+		s.append( "\x1b" "b" );
+	}
+	s.append( "\x05\r\x04" );
+	return ( s );
+}
+
+void setup_multiline( Replxx& replxx_, int scale_ ) {
+	setup_editing( replxx_, scale_ );
+	replxx_.set_multiline( true );
+}
+
+/*
+ * Statement of 40 lines, then edit a line in its middle.
+ */
+std::string script_multiline( int ) {
+	std::string s;
+	for ( int i( 0 ); i < 40; ++ i ) {
+		s.append( "select a, b + 1 from t where x = (1)" );
+		s.append( "\x1b\r" );
+	}
+	for ( int i( 0 ); i < 20; ++ i ) {
+		s.append( "\x1b[A" );
+	}
+	s.append( "\x05" "and y = 2\x7f\x7f" "3\r\x04" );
+	return ( s );
+}
+
+/*
+ * Pasted JSON document of 1 MB, wrapping into far more rows than screen has.
+ */
+void setup_viewport( Replxx& replxx_, int scale_ ) {
+	setup_editing( replxx_, scale_ );
+	int len( 1024 * 1024 / scale_ );
+	std::string json( "[" );
+	json.reserve( len + 64 );
+	for ( int i( 0 ); static_cast<int>( json.length() ) < len; ++ i ) {
+		json.append( "{\"id\": " ).append( std::to_string( i ) ).append( ", \"tags\": [\"a\", \"b\"]}, " );
+	}
+	json.append( "{}]" );
+	replxx_.set_preload_buffer( json );
+}
+
+/*
+ * Edit near the start, in the middle of the screen and at the end of the document.
+ */
+std::string script_viewport( int ) {
+	std::string s( "\x01" );
+	for ( int i( 0 ); i < 200; ++ i ) {
+		s.append( "\x1b" "f" );
+	}
+	s.append( "42\x7f\x7f" );
+	for ( int i( 0 ); i < 100; ++ i ) {
+		s.append( "\x1b[D" );
+	}
+	s.append( "\x05" "\x7f\x7f" "}]\r\x04" );
+	return ( s );
+}
+
+std::string script_history( int ) {
+	std::string s;
+	for ( int i( 0 ); i < 20; ++ i ) {
+		s.append( "\x1b[A" );
+	}
+	for ( int i( 0 ); i < 10; ++ i ) {
+		s.append( "\x1b[B" );
+	}
+	s.append( "\r\x04" );
+	return ( s );
+}
+
+Workload const workloads[] = {
+	{ "typing", "type 10 KB line", setup_typing, script_typing },
+	{ "search", "Ctrl-R over 1M history entries", setup_search, script_search },
+	{ "completion", "Tab with 100k candidates, first page of listing", setup_completion, script_completion },
+	{ "editing", "cursor movement, deletion and Ctrl-L with highlighter and hints", setup_editing, script_editing },
+	{ "history", "history navigation", setup_history, script_history },
+	{ "motion", "cursor movement over long line with braces", setup_editing, script_motion },
+	{ "multiline", "editing statement spanning 40 lines", setup_multiline, script_multiline },
+	{ "viewport", "editing 1 MB pasted document", setup_viewport, script_viewport },
+	{ "steady", "typing with non allocating callbacks, counts steady state allocations", setup_steady, script_steady }
+};
+
+Workload const* find_workload( char const* name_ ) {
+	for ( Workload const& w : workloads ) {
+		if ( ! strcmp( w.name, name_ ) ) {
+			return ( &w );
+		}
+	}
+	return ( nullptr );
+}
+
+struct Result {
+	long long keystrokes;
+	double seconds;
+	long long p50;
+	long long p99;
+	long long max;
+	long long bytesWritten;
+	long long writeCalls;
+	long long steadyAllocations;
+};
+
+/*
+ * Child side: edit until the script ends with Ctrl-D on an empty line.
+ */
+int run( Workload const& workload_, int scale_, int reportFd_ ) {
+	Replxx replxx;
+	workload_.setup( replxx, scale_ );
+	termios t;
+	if ( tcgetattr( 0, &t ) == 0 ) {
+		// input must not be cooked while the editor is not reading it
+		cfmakeraw( &t );
+		tcsetattr( 0, TCSANOW, &t );
+	}
+	replxx.enable_stats( true );
+	if ( write( reportFd_, "R", 1 ) != 1 ) {
+		return ( 1 );
+	}
+	std::chrono::steady_clock::time_point start( std::chrono::steady_clock::now() );
+	std::vector<long long> lineAllocations;
+	lineAllocations.reserve( 1024 );
+	while ( true ) {
+		long long before( allocations );
+		char const* line( replxx.input( "> " ) );
+		if ( ! line && ( errno == EAGAIN ) ) {
+			continue;
+		}
+		if ( ! line ) {
+			break;
+		}
+		lineAllocations.push_back( allocations - before );
+	}
+	double seconds( std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() );
+	int lines( static_cast<int>( lineAllocations.size() ) );
+	long long steadyAllocations(
+		lines >= 3 ? lineAllocations[lines - 1] - lineAllocations[lines - 2] : 0
+	);
+	Replxx::Stats s( replxx.stats() );
+	dprintf(
+		reportFd_, "%lld %f %lld %lld %lld %lld %lld %lld\n",
+		s.keystroke.count, seconds, s.keystroke.percentile( 50 ), s.keystroke.percentile( 99 ), s.keystroke.max,
+		s.bytesWritten, s.writeCalls, steadyAllocations
+	);
+	return ( 0 );
+}
+
+void feed( int master_, std::string const& script_, std::atomic<bool> const& done_ ) {
+	char const* p( script_.data() );
+	char const* e( p + script_.length() );
+	while ( ( p < e ) && ! done_ ) {
+		pollfd fd{ master_, POLLOUT, 0 };
+		if ( poll( &fd, 1, 100 ) <= 0 ) {
+			continue;
+		}
+		ssize_t n( write( master_, p, static_cast<size_t>( e - p ) ) );
+		if ( n > 0 ) {
+			p += n;
+		} else if ( ( n < 0 ) && ( errno != EAGAIN ) && ( errno != EINTR ) ) {
+			break;
+		}
+	}
+}
+
+/*
+ * Parent side: spawn the child on a fresh pseudo-terminal and play the script.
+ */
+bool bench( char const* self_, Workload const& workload_, int scale_, Result& result_ ) {
+	int report[2];
+	if ( pipe( report ) != 0 ) {
+		perror( "pipe" );
+		return ( false );
+	}
+	winsize ws;
+	memset( &ws, 0, sizeof ( ws ) );
+	ws.ws_row = SCREEN_ROWS;
+	ws.ws_col = SCREEN_COLUMNS;
+	int master( -1 );
+	pid_t pid( forkpty( &master, nullptr, nullptr, &ws ) );
+	if ( pid < 0 ) {
+		perror( "forkpty" );
+		return ( false );
+	}
+	if ( pid == 0 ) {
+		close( report[0] );
+		std::string scale( std::to_string( scale_ ) );
+		std::string fd( std::to_string( report[1] ) );
+		execl( self_, self_, "--run", workload_.name, scale.c_str(), fd.c_str(), static_cast<char*>( nullptr ) );
+		_exit( 127 );
+	}
+	close( report[1] );
+	FILE* reportStream( fdopen( report[0], "r" ) );
+	bool ok( fgetc( reportStream ) == 'R' );
+	std::atomic<bool> done( false );
+	std::thread feeder;
+	if ( ok ) {
+		fcntl( master, F_SETFL, fcntl( master, F_GETFL ) | O_NONBLOCK );
+		std::string script( workload_.script( scale_ ) );
+		feeder = std::thread( feed, master, script, std::cref( done ) );
+	}
+	char buf[64 * 1024];
+	while ( true ) {
+		pollfd fd{ master, POLLIN, 0 };
+		if ( poll( &fd, 1, -1 ) < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			break;
+		}
+		ssize_t n( read( master, buf, sizeof ( buf ) ) );
+		if ( ( n < 0 ) && ( ( errno == EAGAIN ) || ( errno == EINTR ) ) ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			break;
+		}
+	}
+	done = true;
+	if ( feeder.joinable() ) {
+		feeder.join();
+	}
+	ok = ok && ( fscanf(
+		reportStream, "%lld %lf %lld %lld %lld %lld %lld %lld",
+		&result_.keystrokes, &result_.seconds, &result_.p50, &result_.p99, &result_.max,
+		&result_.bytesWritten, &result_.writeCalls, &result_.steadyAllocations
+	) == 8 );
+	fclose( reportStream );
+	close( master );
+	int status( 0 );
+	waitpid( pid, &status, 0 );
+	return ( ok && WIFEXITED( status ) && ( WEXITSTATUS( status ) == 0 ) );
+}
+
+/*
+ * Thresholds file holds one `workload max-bytes max-writes [max-allocations]`
+ * entry per line, empty lines and lines starting with '#' are ignored.
+ */
+int check( char const* self_, char const* thresholds_ ) {
+	std::ifstream in( thresholds_ );
+	if ( ! in ) {
+		fprintf( stderr, "cannot open %s\n", thresholds_ );
+		return ( 1 );
+	}
+	printf( "%-12s %12s %12s %8s %8s %8s %8s\n", "workload", "bytes", "max-bytes", "writes", "max", "allocs", "max" );
+	int failures( 0 );
+	int checked( 0 );
+	std::string line;
+	while ( std::getline( in, line ) ) {
+		if ( line.empty() || ( line[0] == '#' ) ) {
+			continue;
+		}
+		std::istringstream entry( line );
+		std::string name;
+		long long maxBytes( 0 );
+		long long maxWrites( 0 );
+		if ( ! ( entry >> name >> maxBytes >> maxWrites ) ) {
+			fprintf( stderr, "malformed entry: %s\n", line.c_str() );
+			return ( 1 );
+		}
+		long long maxAllocations( -1 );
+		entry >> maxAllocations;
+		Workload const* w( find_workload( name.c_str() ) );
+		Result r;
+		if ( ! w || ! bench( self_, *w, 10, r ) ) {
+			printf( "%-12s failed\n", name.c_str() );
+			++ failures;
+			continue;
+		}
+		bool ok(
+			( r.bytesWritten <= maxBytes )
+			&& ( r.writeCalls <= maxWrites )
+			&& ( ( maxAllocations < 0 ) || ( r.steadyAllocations <= maxAllocations ) )
+		);
+		printf(
+			"%-12s %12lld %12lld %8lld %8lld %8lld %8s %s\n",
+			name.c_str(), r.bytesWritten, maxBytes, r.writeCalls, maxWrites, r.steadyAllocations,
+			maxAllocations < 0 ? "-" : std::to_string( maxAllocations ).c_str(), ok ? "ok" : "REGRESSION"
+		);
+		if ( ! ok ) {
+			++ failures;
+		}
+		++ checked;
+	}
+	return ( ( ( failures > 0 ) || ( checked == 0 ) ) ? 1 : 0 );
+}
+
+void usage( char const* self_ ) {
+	printf(
+		"Usage: %s [-q] [workload...]\n"
+		"       %s --check thresholds-file\n\n"
+		"  -q  quick run, workload sizes divided by 10\n\nWorkloads:\n", self_, self_
+	);
+	for ( Workload const& w : workloads ) {
+		printf( "  %-12s %s\n", w.name, w.description );
+	}
+}
+
+}
+
+int main( int argc_, char** argv_ ) {
+	if ( ( argc_ == 5 ) && ! strcmp( argv_[1], "--run" ) ) {
+		Workload const* w( find_workload( argv_[2] ) );
+		return ( w ? run( *w, atoi( argv_[3] ), atoi( argv_[4] ) ) : 1 );
+	}
+	if ( ( argc_ == 3 ) && ! strcmp( argv_[1], "--check" ) ) {
+		return ( check( argv_[0], argv_[2] ) );
+	}
+	int scale( 1 );
+	std::vector<Workload const*> selected;
+	for ( int i( 1 ); i < argc_; ++ i ) {
+		if ( ! strcmp( argv_[i], "-q" ) ) {
+			scale = 10;
+			continue;
+		}
+		Workload const* w( find_workload( argv_[i] ) );
+		if ( ! w ) {
+			usage( argv_[0] );
+			return ( 1 );
+		}
+		selected.push_back( w );
+	}
+	if ( selected.empty() ) {
+		for ( Workload const& w : workloads ) {
+			selected.push_back( &w );
+		}
+	}
+	printf(
+		"%-12s %10s %10s %12s %10s %10s %10s %12s %8s %8s\n",
+		"workload", "keys", "seconds", "keys/s", "p50[us]", "p99[us]", "max[us]", "bytes", "writes", "allocs"
+	);
+	int failures( 0 );
+	for ( Workload const* w : selected ) {
+		Result r;
+		if ( ! bench( argv_[0], *w, scale, r ) ) {
+			printf( "%-12s failed\n", w->name );
+			++ failures;
+			continue;
+		}
+		printf(
+			"%-12s %10lld %10.3f %12.0f %10.1f %10.1f %10.1f %12lld %8lld %8lld\n",
+			w->name, r.keystrokes, r.seconds, r.seconds > 0 ? static_cast<double>( r.keystrokes ) / r.seconds : 0.,
+			static_cast<double>( r.p50 ) / 1000., static_cast<double>( r.p99 ) / 1000., static_cast<double>( r.max ) / 1000.,
+			r.bytesWritten, r.writeCalls, r.steadyAllocations
+		);
+		fflush( stdout );
+	}
+	return ( failures > 0 ? 1 : 0 );
+}
+
@@ -37,10 +37,13 @@ void hintHook(char const* context, replxx_hints* lc, int* contextLen, ReplxxColo
 }
 
 void colorHook( char const* str_, ReplxxColor* colors_, int size_, void* ud ) {
+	int richColors = *(int*)( ud );
 	int i = 0;
 	for ( ; i < size_; ++ i ) {
 		if ( isdigit( str_[i] ) ) {
-			colors_[i] = BRIGHTMAGENTA;
+			colors_[i] = richColors ? replxx_color_rgb( 255, 128, 0 ) : BRIGHTMAGENTA;
+		} else if ( richColors && isupper( str_[i] ) ) {
+			colors_[i] = replxx_color_combine( replxx_color_underline( replxx_color_palette( 208 ) ), replxx_color_bg( BLUE ) );
 		}
 	}
 }
@@ -79,10 +82,14 @@ int main( int argc, char** argv ) {
 	char* examples[MAX_EXAMPLE_COUNT + 1] = {
 		"db", "hello", "hallo", "hans", "hansekogge", "seamann", "quetzalcoatl", "quit", "power", NULL
 	};
+	char* extraExamples[MAX_EXAMPLE_COUNT + 1] = { NULL };
 	Replxx* replxx = replxx_init();
 	replxx_install_window_change_handler( replxx );
 
 	int quiet = 0;
+	int useDictionary = 0;
+	int batch = 0;
+	int richColors = 0;
 	char const* prompt = "\x1b[1;32mreplxx\x1b[0m> ";
 	while ( argc > 1 ) {
 		-- argc;
@@ -96,16 +103,33 @@ int main( int argc, char** argv ) {
 		switch ( (*argv)[0] ) {
 			case 'b': replxx_set_beep_on_ambiguous_completion( replxx, (*argv)[1] - '0' ); break;
 			case 'c': replxx_set_completion_count_cutoff( replxx, atoi( (*argv) + 1 ) );   break;
-			case 'e': replxx_set_complete_on_empty( replxx, (*argv)[1] - '0' );            break;
+			case 'e': replxx_set_complete_on_empty( replxx, (*argv)[1] - '0' );             break;
 			case 'd': replxx_set_double_tab_completion( replxx, (*argv)[1] - '0' );        break;
+			case 'r': replxx_set_completion_ranking( replxx, (*argv)[1] - '0' );           break;
 			case 'h': replxx_set_max_hint_rows( replxx, atoi( (*argv) + 1 ) );             break;
+			case 'l': replxx_set_max_displayed_completions( replxx, atoi( (*argv) + 1 ) ); break;
+			case 'M': replxx_set_completion_menu_rows( replxx, atoi( (*argv) + 1 ) );      break;
+			case 'I': replxx_set_incremental_completion( replxx, (*argv)[1] - '0' );       break;
+			case 'Q': replxx_set_quote_aware_brace_matching( replxx, (*argv)[1] - '0' );   break;
+			case 'L': replxx_set_multiline( replxx, (*argv)[1] - '0' );                    break;
+			case 'T': replxx_set_highlighter_deadline( replxx, atoi( (*argv) + 1 ) );
+			          replxx_set_hint_deadline( replxx, atoi( (*argv) + 1 ) );             break;
 			case 's': replxx_set_max_history_size( replxx, atoi( (*argv) + 1 ) );          break;
+			case 'k': replxx_set_kill_ring_size( replxx, atoi( (*argv) + 1 ),
+			            strchr( *argv, ',' ) ? atoi( strchr( *argv, ',' ) + 1 ) : 0 );      break;
 			case 'i': replxx_set_preload_buffer( replxx, recode( (*argv) + 1 ) );          break;
 			case 'w': replxx_set_word_break_characters( replxx, (*argv) + 1 );             break;
 			case 'm': replxx_set_no_color( replxx, (*argv)[1] - '0' );                     break;
 			case 'p': prompt = recode( (*argv) + 1 );                                      break;
 			case 'q': quiet = atoi( (*argv) + 1 );                                         break;
+			case 'B': batch = atoi( (*argv) + 1 );                                         break;
 			case 'x': split( (*argv) + 1, examples, MAX_EXAMPLE_COUNT );                   break;
+			case 'S': split( (*argv) + 1, extraExamples, MAX_EXAMPLE_COUNT );              break;
+			case 'D': useDictionary = (*argv)[1] - '0';                                    break;
+			case 'H': replxx_set_dictionary_hints( replxx, (*argv)[1] - '0' );             break;
+			case 'R': richColors = (*argv)[1] - '0';                                       break;
+			case 'P': replxx_enable_stats( replxx, 1 );
+			          replxx_set_trace_file( replxx, (*argv) + 1 );                        break;
 		}
 
 	}
@@ -113,16 +137,49 @@ int main( int argc, char** argv ) {
 	const char* file = "./replxx_history.txt";
 
 	replxx_history_load( replxx, file );
-	replxx_set_completion_callback( replxx, completionHook, examples );
-	replxx_set_highlighter_callback( replxx, colorHook, NULL );
-	replxx_set_hint_callback( replxx, hintHook, examples );
+	if ( useDictionary ) {
+		int count = 0;
+		replxx_completion_dictionary* dictionary = NULL;
+		while ( examples[count] != NULL ) {
+			++ count;
+		}
+		dictionary = replxx_completion_dictionary_init( (char const**)examples, NULL, count );
+		replxx_set_completion_dictionary( replxx, dictionary );
+		replxx_completion_dictionary_end( dictionary );
+	} else {
+		replxx_set_completion_callback( replxx, completionHook, examples );
+		replxx_set_hint_callback( replxx, hintHook, examples );
+	}
+	if ( extraExamples[0] != NULL ) {
+		replxx_add_completion_source( replxx, completionHook, extraExamples, 1, 1000 );
+	}
+	replxx_set_highlighter_callback( replxx, colorHook, &richColors );
 
 	printf("starting...\n");
 
-	while (1) {
+	while ( batch > 0 ) {
+		/* Echo input read many lines at a time. */
+		ReplxxLine const* lines = NULL;
+		int count = replxx_input_batch( replxx, prompt, batch, &lines );
+		int i = 0;
+		if ( ( count == 0 ) && ( errno == EAGAIN ) ) {
+			continue;
+		}
+		if ( count == 0 ) {
+			printf("\n");
+			break;
+		}
+		for ( ; i < count; ++ i ) {
+			printf( "%.*s\n", lines[i].length, lines[i].data );
+		}
+	}
+
+	/* Prompt does not change, parse it only once. */
+	replxx_prompt* parsedPrompt = replxx_prompt_init( prompt );
+	while ( batch == 0 ) {
 		char const* result = NULL;
 		do {
-			result = replxx_input( replxx, prompt );
+			result = replxx_input_prompt( replxx, parsedPrompt );
 		} while ( ( result == NULL ) && ( errno == EAGAIN ) );
 
 		if (result == NULL) {
@@ -139,12 +196,21 @@ int main( int argc, char** argv ) {
 				}
 				replxx_print( replxx, "%4d: %s\n", index, hist );
 			}
+		} else if (!strncmp(result, "/stats", 6)) {
+			/* Display keystroke latency summary. */
+			ReplxxStats stats;
+			replxx_get_stats( replxx, &stats );
+			replxx_print(
+				replxx, "keystrokes: %lld, p50: %lldns, p99: %lldns, max: %lldns, bytes: %lld, writes: %lld\n",
+				stats.keystrokes, stats.p50[0], stats.p99[0], stats.max[0], stats.bytesWritten, stats.writeCalls
+			);
 		}
 		if (*result != '\0') {
 			replxx_print( replxx, quiet ? "%s\n" : "thanks for the input: %s\n", result );
 			replxx_history_add( replxx, result );
 		}
 	}
+	replxx_prompt_end( parsedPrompt );
 	replxx_history_save( replxx, file );
 	printf( "Exiting Replxx\n" );
 	replxx_end( replxx );
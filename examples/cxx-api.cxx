@@ -12,21 +12,19 @@
 using Replxx = replxx::Replxx;
 
 // prototypes
-Replxx::completions_t hook_completion(std::string const& context, int& contextLen, std::vector<std::string> const& user_data);
+Replxx::completions_t hook_completion(std::string const& context, int& contextLen, replxx::Completer const& user_data);
 Replxx::hints_t hook_hint(std::string const& context, int& contextLen, Replxx::Color& color, std::vector<std::string> const& user_data);
 void hook_color(std::string const& str, Replxx::colors_t& colors, std::vector<std::pair<std::string, Replxx::Color>> const& user_data);
 
-Replxx::completions_t hook_completion(std::string const& context, int& contextLen, std::vector<std::string> const& examples) {
+Replxx::completions_t hook_completion(std::string const& context, int& contextLen, replxx::Completer const& examples) {
 	Replxx::completions_t completions;
 	int utf8ContextLen( context_len( context.c_str() ) );
 	int prefixLen( context.length() - utf8ContextLen );
 	contextLen = utf8str_codepoint_len( context.c_str() + prefixLen, utf8ContextLen );
 
 	std::string prefix { context.substr(prefixLen) };
-	for (auto const& e : examples) {
-		if (e.compare(0, prefix.size(), prefix) == 0) {
-			completions.emplace_back(e.c_str());
-		}
+	for (auto const& e : examples.complete(prefix)) {
+		completions.emplace_back(e.c_str());
 	}
 
 	return completions;
@@ -171,9 +169,11 @@ int main() {
 
 	// set the callbacks
 	using namespace std::placeholders;
-	rx.set_completion_callback( std::bind( &hook_completion, _1, _2, cref( examples ) ) );
-	rx.set_highlighter_callback( std::bind( &hook_color, _1, _2, cref( regex_color ) ) );
-	rx.set_hint_callback( std::bind( &hook_hint, _1, _2, _3, cref( examples ) ) );
+	// words are looked up in a trie instead of scanning all of them
+	replxx::Completer completer( examples );
+	rx.set_completion_callback( std::bind( &hook_completion, _1, _2, std::cref( completer ) ) );
+	rx.set_highlighter_callback( std::bind( &hook_color, _1, _2, std::cref( regex_color ) ) );
+	rx.set_hint_callback( std::bind( &hook_hint, _1, _2, _3, std::cref( examples ) ) );
 
 	// other api calls
 	rx.set_word_break_characters( " \t.,-%!;:=*~^'\"/?<>|[](){}" );
@@ -190,8 +190,8 @@ int main() {
 		<< "Type '.help' for help\n"
 		<< "Type '.quit' or '.exit' to exit\n\n";
 
-	// set the repl prompt
-	std::string prompt {"\x1b[1;32mreplxx\x1b[0m> "};
+	// set the repl prompt, parsed once and reused for every input
+	Replxx::Prompt prompt {"\x1b[1;32mreplxx\x1b[0m> "};
 
 	// main repl loop
 	for (;;) {
@@ -240,7 +240,7 @@ int main() {
 			if (pos == std::string::npos) {
 				std::cout << "Error: '.prompt' missing argument\n";
 			} else {
-				prompt = input.substr(pos + 1) + " ";
+				prompt = Replxx::Prompt(input.substr(pos + 1) + " ");
 			}
 
 			rx.history_add(input);
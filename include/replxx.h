@@ -44,9 +44,9 @@
 extern "C" {
 #endif
 
-/*! \brief Color definitions to use in highlighter callbacks.
+/*! \brief Named color definitions to use in highlighter callbacks.
  */
-typedef enum {
+enum {
 	BLACK         = 0,
 	RED           = 1,
 	GREEN         = 2,
@@ -67,7 +67,47 @@ typedef enum {
 	DEFAULT       = -1,
 #undef ERROR
 	ERROR         = -2
-} ReplxxColor;
+};
+
+/*! \brief Display attributes of a character.
+ *
+ * One of named colors, or 256 color palette and 24 bit colors, background,
+ * bold and underline attributes composed with replxx_color_*() functions.
+ */
+typedef long long ReplxxColor;
+
+/*! \brief Get foreground color from 256 color palette.
+ *
+ * \param index - palette index (0-255).
+ */
+ReplxxColor replxx_color_palette( int index );
+
+/*! \brief Get 24 bit foreground color.
+ *
+ * \param red - red component (0-255).
+ * \param green - green component (0-255).
+ * \param blue - blue component (0-255).
+ */
+ReplxxColor replxx_color_rgb( int red, int green, int blue );
+
+/*! \brief Turn foreground color into background color.
+ */
+ReplxxColor replxx_color_bg( ReplxxColor color );
+
+/*! \brief Add bold attribute to given color.
+ */
+ReplxxColor replxx_color_bold( ReplxxColor color );
+
+/*! \brief Add underline attribute to given color.
+ */
+ReplxxColor replxx_color_underline( ReplxxColor color );
+
+/*! \brief Combine foreground color with background color.
+ *
+ * Attributes set in either of the colors are kept,
+ * foreground and background of the left one take precedence.
+ */
+ReplxxColor replxx_color_combine( ReplxxColor left, ReplxxColor right );
 
 typedef struct Replxx Replxx;
 
@@ -143,12 +183,80 @@ typedef void(replxx_completion_callback_t)(const char* input, replxx_completions
 void replxx_set_completion_callback( Replxx*, replxx_completion_callback_t* fn, void* userData );
 
 /*! \brief Add another possible completion for current user input.
+ *
+ * Completions are streamed to the library as they are added,
+ * only as many of them as can be displayed are kept.
  *
  * \param completions - pointer to opaque list of user completions.
  * \param str - UTF-8 encoded completion string.
  */
 void replxx_add_completion( replxx_completions* completions, const char* str );
 
+/*! \brief Register additional completion source.
+ *
+ * Sources are invoked in parallel on library worker threads,
+ * their completions are merged in order of decreasing priority
+ * with duplicates removed, completions from a source that does not
+ * finish within \e deadline are ignored.
+ * Source callbacks must be thread safe.
+ *
+ * \param fn - user defined callback function.
+ * \param userData - pointer to opaque user data block to be passed into each invocation of the callback.
+ * \param priority - sources with higher priority are listed first.
+ * \param deadline - maximum time to wait for the source in milliseconds.
+ */
+void replxx_add_completion_source( Replxx*, replxx_completion_callback_t* fn, void* userData, int priority, int deadline );
+
+/*! \brief Remove all additional completion sources.
+ */
+void replxx_clear_completion_sources( Replxx* );
+
+typedef struct replxx_completion_dictionary replxx_completion_dictionary;
+
+/*! \brief Create immutable, shareable set of completion words.
+ *
+ * Use replxx_completion_dictionary_end() to release the handle,
+ * Replxx instances keep using the dictionary as long as they need it.
+ *
+ * \param words - array of UTF-8 encoded words.
+ * \param weights - optional (may be NULL) array of word frequency weights.
+ * \param count - number of words in \e words array.
+ * \return Completion dictionary handle.
+ */
+replxx_completion_dictionary* replxx_completion_dictionary_init( char const** words, int const* weights, int count );
+
+/*! \brief Atomically replace dictionary contents with new set of words.
+ *
+ * \param dictionary - completion dictionary handle.
+ * \param words - array of UTF-8 encoded words.
+ * \param weights - optional (may be NULL) array of word frequency weights.
+ * \param count - number of words in \e words array.
+ */
+void replxx_completion_dictionary_update( replxx_completion_dictionary* dictionary, char const** words, int const* weights, int count );
+
+/*! \brief Release completion dictionary handle.
+ *
+ * \param dictionary - completion dictionary handle.
+ */
+void replxx_completion_dictionary_end( replxx_completion_dictionary* dictionary );
+
+/*! \brief Register built-in completion and hint source.
+ *
+ * Dictionary is used for completions when no completion callback is registered
+ * and, if enabled with replxx_set_dictionary_hints(), for hints when no hint
+ * callback is registered.
+ *
+ * \param dictionary - completion dictionary handle (or NULL to disable).
+ */
+void replxx_set_completion_dictionary( Replxx*, replxx_completion_dictionary* dictionary );
+
+/*! \brief Use completion dictionary as hint source.
+ *
+ * \param val - show heaviest matching dictionary words as hints
+ *              when no hint callback is registered (if != 0).
+ */
+void replxx_set_dictionary_hints( Replxx*, int val );
+
 typedef struct replxx_hints replxx_hints;
 
 /*! \brief Hints callback type definition.
@@ -187,6 +295,68 @@ void replxx_set_hint_callback( Replxx*, replxx_hint_callback_t* fn, void* userDa
  */
 void replxx_add_hint( replxx_hints* hints, const char* str );
 
+/*! \brief Set latency budget for highlighter callback.
+ *
+ * When set, highlighter callback is invoked on a library worker thread,
+ * if it does not return within the budget input is displayed
+ * with the most recent colors and repainted as soon as the late result arrives.
+ *
+ * \param milliseconds - latency budget (0 invokes callback synchronously).
+ */
+void replxx_set_highlighter_deadline( Replxx*, int milliseconds );
+
+/*! \brief Set latency budget for hints callback.
+ *
+ * \param milliseconds - latency budget (0 invokes callback synchronously).
+ */
+void replxx_set_hint_deadline( Replxx*, int milliseconds );
+
+/*! \brief Number of highlighter invocations that exceeded their latency budget.
+ */
+int replxx_highlighter_overruns( Replxx* );
+
+/*! \brief Number of hints invocations that exceeded their latency budget.
+ */
+int replxx_hint_overruns( Replxx* );
+
+/*! \brief Summary of editing latency statistics.
+ *
+ * Percentile arrays are indexed with: 0 - whole keystroke,
+ * 1 - read, 2 - decode, 3 - edit, 4 - highlight, 5 - hint, 6 - layout, 7 - write.
+ * All durations are in nanoseconds.
+ */
+typedef struct ReplxxStats {
+	long long keystrokes;
+	long long p50[8];
+	long long p99[8];
+	long long max[8];
+	long long bytesWritten;
+	long long writeCalls;
+	int highlighterOverruns;
+	int hintOverruns;
+} ReplxxStats;
+
+/*! \brief Enable or disable collection of editing latency statistics.
+ *
+ * \param val - collect statistics (non-zero) or not (zero).
+ */
+void replxx_enable_stats( Replxx*, int val );
+
+/*! \brief Get summary of editing latency statistics collected so far.
+ */
+void replxx_get_stats( Replxx*, ReplxxStats* stats );
+
+/*! \brief Clear collected editing latency statistics.
+ */
+void replxx_reset_stats( Replxx* );
+
+/*! \brief Record every keystroke and its phases to a Chrome trace event JSON file.
+ *
+ * \param filename - trace file path (empty string closes current trace file).
+ * \return 0 on success, -1 if trace file could not be created.
+ */
+int replxx_set_trace_file( Replxx*, char const* filename );
+
 /*! \brief Read line of user input.
  *
  * \param prompt - prompt to be displayed before getting user input.
@@ -194,6 +364,52 @@ void replxx_add_hint( replxx_hints* hints, const char* str );
  */
 char const* replxx_input( Replxx*, const char* prompt );
 
+typedef struct replxx_prompt replxx_prompt;
+
+/*! \brief Parse prompt once for use with many replxx_input_prompt() calls.
+ *
+ * Use replxx_prompt_end() to release the handle.
+ *
+ * \param text - UTF-8 encoded prompt text, may contain escape sequences.
+ * \return Prompt handle.
+ */
+replxx_prompt* replxx_prompt_init( char const* text );
+
+/*! \brief Release prompt handle.
+ *
+ * \param prompt - prompt handle.
+ */
+void replxx_prompt_end( replxx_prompt* prompt );
+
+/*! \brief Read line of user input using pre-parsed prompt.
+ *
+ * \param prompt - prompt handle to be displayed before getting user input.
+ * \return An UTF-8 encoded input given by the user (or nullptr on EOF).
+ */
+char const* replxx_input_prompt( Replxx*, replxx_prompt const* prompt );
+
+/*! \brief Line of input returned by replxx_input_batch().
+ *
+ * Line is not NUL terminated and it does not include line terminator.
+ */
+typedef struct ReplxxLine {
+	char const* data;
+	int length;
+} ReplxxLine;
+
+/*! \brief Read many lines of input at once.
+ *
+ * When standard input is not a terminal lines are returned without copying
+ * as views into large read buffer, or into memory mapped input file.
+ * On a terminal single line is read with replxx_input().
+ *
+ * \param prompt - prompt to be displayed when input is read from a terminal.
+ * \param count - maximum number of lines to return.
+ * \param lines - set to array of lines read, valid until next call to replxx_input() or replxx_input_batch().
+ * \return Number of lines read, 0 on EOF.
+ */
+int replxx_input_batch( Replxx*, const char* prompt, int count, ReplxxLine const** lines );
+
 /*! \brief Print formatted string to standard output.
  *
  * This function ensures proper handling of ANSI escape sequences
@@ -221,6 +437,39 @@ void replxx_set_word_break_characters( Replxx*, char const* wordBreakers );
  */
 void replxx_set_completion_count_cutoff( Replxx*, int count );
 
+/*! \brief Set maximum number of completions kept for display.
+ *
+ * \param count - display limit (0 disables the limit).
+ */
+void replxx_set_max_displayed_completions( Replxx*, int count );
+
+/*! \brief Show ambiguous completions in a scrollable menu.
+ *
+ * \param count - number of visible menu rows (0 lists completions with a pager).
+ */
+void replxx_set_completion_menu_rows( Replxx*, int count );
+
+/*! \brief Reuse fetched completions while the completed word is extended.
+ *
+ * Full set of fetched completions is cached, including those not displayed
+ * due to replxx_set_max_displayed_completions() limit.
+ *
+ * \param val - filter cached completions instead of calling completion callback again (if != 0).
+ */
+void replxx_set_incremental_completion( Replxx*, int val );
+
+/*! \brief Ignore braces inside quoted strings when looking for matching brace.
+ *
+ * \param val - skip quoted strings while matching braces (if != 0).
+ */
+void replxx_set_quote_aware_brace_matching( Replxx*, int val );
+
+/*! \brief Enable editing of input spanning several lines.
+ *
+ * \param val - Meta-Enter inserts a newline into the input (if != 0).
+ */
+void replxx_set_multiline( Replxx*, int val );
+
 /*! \brief Set maximum number of displayed hint rows.
  */
 void replxx_set_max_hint_rows( Replxx*, int count );
@@ -237,6 +486,12 @@ void replxx_set_double_tab_completion( Replxx*, int val );
  */
 void replxx_set_complete_on_empty( Replxx*, int val );
 
+/*! \brief Set completion and hint ordering.
+ *
+ * \param val - rank completions by their usage in history (if != 0).
+ */
+void replxx_set_completion_ranking( Replxx*, int val );
+
 /*! \brief Set tab completion behavior.
  *
  * \param val - beep if completion is ambiguous (if != 0).
@@ -252,6 +507,13 @@ void replxx_set_no_color( Replxx*, int val );
 /*! \brief Set maximum number of entries in history list.
  */
 void replxx_set_max_history_size( Replxx*, int len );
+
+/*! \brief Set how much killed text is kept for yanking.
+ *
+ * \param entries - maximum number of kills kept.
+ * \param characters - maximum number of characters kept, no limit if not positive.
+ */
+void replxx_set_kill_ring_size( Replxx*, int entries, int characters );
 char const* replxx_history_line( Replxx*, int index );
 int replxx_history_save( Replxx*, const char* filename );
 int replxx_history_load( Replxx*, const char* filename );
@@ -31,6 +31,7 @@
 #ifndef HAVE_REPLXX_HXX_INCLUDED
 #define HAVE_REPLXX_HXX_INCLUDED 1
 
+#include <cstdio>
 #include <memory>
 #include <vector>
 #include <string>
@@ -38,9 +39,131 @@
 
 namespace replxx {
 
+/*! \brief Compressed trie of completion words.
+ *
+ * Completer is a static radix trie over UTF-8 encoded words built once
+ * from a word list. Prefix lookups cost O(prefix length + number of results)
+ * regardless of the dictionary size, results are enumerated in lexicographical
+ * order or, when words carry frequency weights, heaviest first.
+ * Completer is immutable and cheap to copy, copies share the trie.
+ */
+class Completer {
+public:
+	typedef std::vector<std::string> words_t;
+	typedef std::vector<int> weights_t;
+	/*! \brief Receiver of matching words, returns false to stop the lookup.
+	 */
+	typedef std::function<bool ( std::string const& word )> visitor_t;
+	class CompleterImpl;
+private:
+	std::shared_ptr<CompleterImpl const> _impl;
+public:
+	Completer( void );
+
+	/*! \brief Build trie from list of words.
+	 *
+	 * \param words - UTF-8 encoded words, duplicates are ignored.
+	 * \param weights - optional frequency weights, one for each word.
+	 */
+	explicit Completer( words_t const& words, weights_t const& weights = weights_t() );
+
+	/*! \brief Find all words starting with given prefix.
+	 *
+	 * \param prefix - UTF-8 encoded prefix to look for.
+	 * \param limit - maximum number of returned words, -1 for no limit.
+	 * \return Matching words in lexicographical order.
+	 */
+	words_t complete( std::string const& prefix, int limit = -1 ) const;
+
+	/*! \brief Pass all words starting with given prefix to the visitor.
+	 *
+	 * Unlike list returning lookup this one does not materialize the matches,
+	 * each word is passed as soon as it is reached.
+	 *
+	 * \param prefix - UTF-8 encoded prefix to look for.
+	 * \param visitor - receiver of matching words in lexicographical order.
+	 */
+	void complete( std::string const& prefix, visitor_t const& visitor ) const;
+
+	/*! \brief Find heaviest words starting with given prefix.
+	 *
+	 * \param prefix - UTF-8 encoded prefix to look for.
+	 * \param limit - maximum number of returned words, -1 for no limit.
+	 * \return Matching words ordered by descending weight.
+	 */
+	words_t complete_weighted( std::string const& prefix, int limit = -1 ) const;
+
+	/*! \brief Find all words containing given string.
+	 *
+	 * Unlike prefix lookups this one has to visit every word in the trie.
+	 *
+	 * \param infix - UTF-8 encoded string to look for.
+	 * \param limit - maximum number of returned words, -1 for no limit.
+	 * \return Matching words in lexicographical order.
+	 */
+	words_t find( std::string const& infix, int limit = -1 ) const;
+
+	/*! \brief Get number of words in the trie.
+	 */
+	int size( void ) const;
+};
+
+/*! \brief Immutable, shareable set of completion words.
+ *
+ * Words are kept in a read-only Completer snapshot which can be used
+ * concurrently by any number of Replxx instances and threads. update()
+ * builds a new snapshot off-line and then publishes it with a single atomic
+ * pointer swap, lookups that are already in progress finish on the old
+ * snapshot which is released when its last reader is done with it.
+ */
+class CompletionDictionary {
+public:
+	typedef Completer::words_t words_t;
+	typedef Completer::weights_t weights_t;
+	typedef std::shared_ptr<Completer const> snapshot_t;
+private:
+	snapshot_t _snapshot;
+public:
+	CompletionDictionary( void );
+	explicit CompletionDictionary( words_t const& words, weights_t const& weights = weights_t() );
+
+	/*! \brief Replace dictionary contents with new set of words.
+	 *
+	 * \param words - new, UTF-8 encoded, dictionary contents.
+	 * \param weights - optional frequency weights, one for each word.
+	 */
+	void update( words_t const& words, weights_t const& weights = weights_t() );
+
+	/*! \brief Get current dictionary snapshot.
+	 *
+	 * Returned snapshot stays valid and unchanged for as long as it is held.
+	 */
+	snapshot_t snapshot( void ) const;
+
+	/*! \brief Find all words starting with given prefix.
+	 *
+	 * \param prefix - UTF-8 encoded prefix to look for.
+	 * \return Matching words in lexicographical order.
+	 */
+	words_t complete( std::string const& prefix ) const;
+
+	/*! \brief Get number of words in the dictionary.
+	 */
+	int size( void ) const;
+private:
+	CompletionDictionary( CompletionDictionary const& ) = delete;
+	CompletionDictionary& operator = ( CompletionDictionary const& ) = delete;
+};
+
 class Replxx {
 public:
-	enum class Color {
+	/*! \brief Display attributes of a character.
+	 *
+	 * Named values are basic terminal colors, replxx::color functions
+	 * compose 256 color palette and 24 bit colors, background,
+	 * bold and underline attributes into a single value.
+	 */
+	enum class Color : long long {
 		BLACK         = 0,
 		RED           = 1,
 		GREEN         = 2,
@@ -66,6 +189,17 @@ public:
 	typedef std::vector<std::string> completions_t;
 	typedef std::vector<std::string> hints_t;
 
+	/*! \brief Line of input returned by input_batch().
+	 *
+	 * Line points into library owned buffer, it is not NUL terminated
+	 * and it does not include line terminator.
+	 */
+	struct LineView {
+		char const* data;
+		int length;
+	};
+	typedef std::vector<LineView> lines_t;
+
 	/*! \brief Completions callback type definition.
 	 *
 	 * \e contextLen is counted in Unicode code points (not in bytes!).
@@ -86,6 +220,35 @@ public:
 	 */
 	typedef std::function<completions_t ( std::string const& input, int& contextLen )> completion_callback_t;
 
+	/*! \brief Receiver of streamed completions.
+	 *
+	 * Library keeps only as many completions as it can display
+	 * (see \e set_max_displayed_completions()) while still counting
+	 * all completions and tracking their longest common prefix,
+	 * so completion source does not have to materialize all of its matches.
+	 * Completions are displayed after completion source returns.
+	 */
+	class CompletionSink {
+	public:
+		virtual ~CompletionSink( void ) {}
+		/*! \brief Add another possible completion for current user input.
+		 *
+		 * \param completion - UTF-8 encoded completion string.
+		 */
+		virtual void add( std::string const& completion ) = 0;
+	};
+
+	/*! \brief Streaming completions callback type definition.
+	 *
+	 * Same as \e completion_callback_t but completions are pushed
+	 * one by one to the \e sink instead of being returned in a single list.
+	 *
+	 * \param input - UTF-8 encoded input entered by the user until current cursor position.
+	 * \param[in,out] contextLen - length of the additional context to provide while displaying completions.
+	 * \param sink - receiver of user completions.
+	 */
+	typedef std::function<void ( std::string const& input, int& contextLen, CompletionSink& sink )> streaming_completion_callback_t;
+
 	/*! \brief Highlighter callback type definition.
 	 *
 	 * If user want to have colorful input she must simply install highlighter callback.
@@ -121,6 +284,77 @@ public:
 	 * \return A list of possible hints.
 	 */
 	typedef std::function<hints_t ( std::string const& input, int& contextLen, Color& color )> hint_callback_t;
+	typedef std::shared_ptr<CompletionDictionary> completion_dictionary_t;
+
+	/*! \brief Editing latency statistics.
+	 *
+	 * Collected only when enabled with \e enable_stats().
+	 * All durations are in nanoseconds.
+	 */
+	struct Stats {
+		/*! \brief Stages of keystroke processing.
+		 */
+		enum class PHASE {
+			READ,      /*!< reading bytes from terminal */
+			DECODE,    /*!< decoding bytes into keystroke */
+			EDIT,      /*!< applying keystroke, i.e. everything not covered by other phases */
+			HIGHLIGHT, /*!< building colored display, including highlighter callback */
+			HINT,      /*!< generating and formatting hints, including hints callback */
+			LAYOUT,    /*!< computing screen positions */
+			WRITE      /*!< writing to terminal */
+		};
+		static int const PHASE_COUNT = 7;
+		/*! \brief Distribution of durations in power of two buckets.
+		 */
+		struct Histogram {
+			static int const BUCKET_COUNT = 40;
+			long long count;
+			long long total;
+			long long max;
+			long long buckets[BUCKET_COUNT]; /*!< bucket i counts durations shorter than 2^i not counted in lower buckets */
+			/*! \brief Get upper bound of given percentile.
+			 *
+			 * \param percent - requested percentile (0-100).
+			 */
+			long long percentile( double percent ) const;
+		};
+		Histogram keystroke;           /*!< whole keystroke processing */
+		Histogram phases[PHASE_COUNT]; /*!< indexed by PHASE */
+		long long bytesWritten;
+		long long writeCalls;
+		int highlighterOverruns;
+		int hintOverruns;
+	};
+
+	/*! \brief Prompt parsed once and reused by many input() calls.
+	 *
+	 * Escape sequences (SGR, other CSI and OSC sequences) are recognized
+	 * and take no screen space, other control characters except newline
+	 * are dropped. Display width and UTF-8 bytes sent to the terminal
+	 * are computed on construction, so showing the prompt costs a single write.
+	 * Prompt is immutable and cheap to copy.
+	 */
+	class Prompt {
+	public:
+		class PromptImpl;
+	private:
+		std::shared_ptr<PromptImpl const> _impl;
+	public:
+		Prompt( void );
+		explicit Prompt( std::string const& text );
+		/*! \brief Get prompt text as given on construction.
+		 */
+		std::string const& text( void ) const;
+		/*! \brief Get number of screen columns taken by the last line of the prompt.
+		 */
+		int width( void ) const;
+		/*! \brief Get number of newlines in the prompt.
+		 */
+		int lines( void ) const;
+		PromptImpl const& impl( void ) const {
+			return ( *_impl );
+		}
+	};
 
 	class ReplxxImpl;
 private:
@@ -129,6 +363,15 @@ private:
 
 public:
 	Replxx( void );
+	/*! \brief Create instance working with given streams instead of standard ones.
+	 *
+	 * Instances reading from different terminals can be used from different threads.
+	 *
+	 * \param in - stream user input is read from, stdin if nullptr.
+	 * \param out - stream prompt and input line are written to, stdout if nullptr.
+	 * \param err - stream bell is written to, stderr if nullptr.
+	 */
+	Replxx( FILE* in, FILE* out, FILE* err );
 	Replxx( Replxx&& ) = default;
 	Replxx& operator = ( Replxx&& ) = default;
 
@@ -138,6 +381,54 @@ public:
 	 */
 	void set_completion_callback( completion_callback_t const& fn );
 
+	/*! \brief Register streaming completion callback.
+	 *
+	 * Replaces callback registered with \e set_completion_callback().
+	 *
+	 * \param fn - user defined callback function.
+	 */
+	void set_streaming_completion_callback( streaming_completion_callback_t const& fn );
+
+	/*! \brief Register additional completion source.
+	 *
+	 * All registered sources are invoked in parallel on library worker threads,
+	 * their completions are merged in order of decreasing priority
+	 * with duplicates removed. Completion callback registered with
+	 * \e set_completion_callback() runs on the calling thread
+	 * and ranks after sources of equal priority.
+	 * Completions from a source that does not finish within \e deadline
+	 * are ignored, such source is not invoked again until it finishes.
+	 * Source callbacks must be thread safe.
+	 *
+	 * \param fn - user defined callback function.
+	 * \param priority - sources with higher priority are listed first.
+	 * \param deadline - maximum time to wait for the source in milliseconds.
+	 */
+	void add_completion_source( streaming_completion_callback_t const& fn, int priority = 0, int deadline = 100 );
+
+	/*! \brief Remove all completion sources registered with \e add_completion_source().
+	 */
+	void clear_completion_sources( void );
+
+	/*! \brief Register built-in completion and hint source.
+	 *
+	 * When no completion callback is installed library completes
+	 * the word under cursor with words from given dictionary.
+	 * If enabled with \e set_dictionary_hints() and no hint callback
+	 * is installed the heaviest matching dictionary words are used as hints.
+	 * Single dictionary can be shared by many Replxx instances.
+	 *
+	 * \param dictionary - shared dictionary of completion words.
+	 */
+	void set_completion_dictionary( completion_dictionary_t const& dictionary );
+
+	/*! \brief Use completion dictionary as hint source.
+	 *
+	 * \param val - show heaviest matching dictionary words as hints
+	 *               when no hint callback is installed, disabled by default.
+	 */
+	void set_dictionary_hints( bool val );
+
 	/*! \brief Register highlighter callback.
 	 *
 	 * \param fn - user defined callback function.
@@ -150,6 +441,62 @@ public:
 	 */
 	void set_hint_callback( hint_callback_t const& fn );
 
+	/*! \brief Set latency budget for highlighter callback.
+	 *
+	 * When set, highlighter callback is invoked on a library worker thread,
+	 * if it does not return within the budget input is displayed
+	 * with the most recent colors and repainted as soon as the late result arrives.
+	 * Highlighter callback must be thread safe.
+	 *
+	 * \param milliseconds - latency budget (0 invokes callback synchronously).
+	 */
+	void set_highlighter_deadline( int milliseconds );
+
+	/*! \brief Set latency budget for hints callback.
+	 *
+	 * Works like \e set_highlighter_deadline(), most recent hints
+	 * that still match the input are shown while callback is late.
+	 *
+	 * \param milliseconds - latency budget (0 invokes callback synchronously).
+	 */
+	void set_hint_deadline( int milliseconds );
+
+	/*! \brief Number of highlighter invocations that exceeded their latency budget.
+	 */
+	int highlighter_overruns( void ) const;
+
+	/*! \brief Number of hints invocations that exceeded their latency budget.
+	 */
+	int hint_overruns( void ) const;
+
+	/*! \brief Enable or disable collection of editing latency statistics.
+	 *
+	 * Keystroke is timed from arrival of its first byte until
+	 * the library is ready to read the next one, keystrokes handled
+	 * by incremental history search and completion menu included.
+	 *
+	 * \param val - collect statistics.
+	 */
+	void enable_stats( bool val );
+
+	/*! \brief Get editing latency statistics collected so far.
+	 */
+	Stats stats( void ) const;
+
+	/*! \brief Clear collected editing latency statistics.
+	 */
+	void reset_stats( void );
+
+	/*! \brief Record every keystroke and its phases to a trace file.
+	 *
+	 * Trace is written in Chrome trace event JSON format,
+	 * statistics collection must be enabled for events to be recorded.
+	 *
+	 * \param filename - trace file path (empty string closes current trace file).
+	 * \return 0 on success, -1 if trace file could not be created.
+	 */
+	int set_trace_file( std::string const& filename );
+
 	/*! \brief Read line of user input.
 	 *
 	 * \param prompt - prompt to be displayed before getting user input.
@@ -157,6 +504,26 @@ public:
 	 */
 	char const* input( std::string const& prompt );
 
+	/*! \brief Read line of user input using pre-parsed prompt.
+	 *
+	 * \param prompt - prompt to be displayed before getting user input.
+	 * \return An UTF-8 encoded input given by the user (or nullptr on EOF).
+	 */
+	char const* input( Prompt const& prompt );
+
+	/*! \brief Read many lines of input at once.
+	 *
+	 * When standard input is not a terminal lines are returned without copying
+	 * as views into large read buffer, or into memory mapped input file,
+	 * so that batch runs are not slowed down by per line overhead.
+	 * On a terminal single line is read with input().
+	 *
+	 * \param prompt - prompt to be displayed when input is read from a terminal.
+	 * \param count - maximum number of lines to return.
+	 * \return Lines read, valid until next call to input() or input_batch(), empty on EOF.
+	 */
+	lines_t const& input_batch( std::string const& prompt, int count );
+
 	/*! \brief Print formatted string to standard output.
 	 *
 	 * This function ensures proper handling of ANSI escape sequences
@@ -187,6 +554,58 @@ public:
 	 */
 	void set_completion_count_cutoff( int count );
 
+	/*! \brief Set maximum number of completions kept for display.
+	 *
+	 * When completion source produces more completions
+	 * only the first (or best ranked) \e count ones are listed.
+	 *
+	 * \param count - display limit (0 disables the limit).
+	 */
+	void set_max_displayed_completions( int count );
+
+	/*! \brief Show ambiguous completions in a scrollable menu.
+	 *
+	 * Menu is drawn in place below the input line, selection is moved
+	 * with Tab, arrow and page keys, Enter inserts selected completion
+	 * and typing further word characters narrows the menu down.
+	 *
+	 * \param count - number of visible menu rows (0 lists completions with a pager).
+	 */
+	void set_completion_menu_rows( int count );
+
+	/*! \brief Reuse fetched completions while the completed word is extended.
+	 *
+	 * When enabled completion callback is invoked once per word,
+	 * further completion requests for that word are served by filtering
+	 * already fetched completions, callback is invoked again only after
+	 * user edits text before or at the beginning of the completed word.
+	 * Cache holds full set of fetched completions, including those not displayed
+	 * due to \e set_max_displayed_completions() limit, so that narrowing
+	 * it down yields the same completions as calling completion callback again.
+	 *
+	 * \param val - filter cached completions instead of calling completion callback again.
+	 */
+	void set_incremental_completion( bool val );
+
+	/*! \brief Ignore braces inside quoted strings when looking for matching brace.
+	 *
+	 * Strings are delimited with single or double quotes,
+	 * backslash escapes the following character inside a string.
+	 *
+	 * \param val - skip quoted strings while matching braces.
+	 */
+	void set_quote_aware_brace_matching( bool val );
+
+	/*! \brief Enable editing of input spanning several lines.
+	 *
+	 * Meta-Enter inserts a newline into the input, Up and Down move
+	 * between its lines, Home and End move to start and end
+	 * of the current line. Enter accepts the whole input.
+	 *
+	 * \param val - allow newlines in the input.
+	 */
+	void set_multiline( bool val );
+
 	/*! \brief Set maximum number of displayed hint rows.
 	 */
 	void set_max_hint_rows( int count );
@@ -203,6 +622,16 @@ public:
 	 */
 	void set_complete_on_empty( bool val );
 
+	/*! \brief Set completion and hint ordering.
+	 *
+	 * When enabled completions and hints are reordered so that words
+	 * used often and recently in history come first,
+	 * words absent from history keep their original order.
+	 *
+	 * \param val - rank completions by usage in history.
+	 */
+	void set_completion_ranking( bool val );
+
 	/*! \brief Set tab completion behavior.
 	 *
 	 * \param val - beep if completion is ambiguous.
@@ -218,6 +647,18 @@ public:
 	/*! \brief Set maximum number of entries in history list.
 	 */
 	void set_max_history_size( int len );
+
+	/*! \brief Set how much killed text is kept for yanking.
+	 *
+	 * Oldest killed text is dropped when there are more than
+	 * \e entries kills kept or when all of them together take more than
+	 * \e characters characters, most recent kill is always kept.
+	 * By default 10 kills of up to 1048576 characters are kept.
+	 *
+	 * \param entries - maximum number of kills kept.
+	 * \param characters - maximum number of characters kept, no limit if not positive.
+	 */
+	void set_kill_ring_size( int entries, int characters );
 	void clear_screen( void );
 	int install_window_change_handler( void );
 
@@ -226,6 +667,43 @@ private:
 	Replxx& operator = ( Replxx const& ) = delete;
 };
 
+namespace color {
+
+/*! \brief Get foreground color from 256 color palette.
+ *
+ * \param index - palette index (0-255).
+ */
+Replxx::Color palette( int index );
+
+/*! \brief Get 24 bit foreground color.
+ *
+ * \param red - red component (0-255).
+ * \param green - green component (0-255).
+ * \param blue - blue component (0-255).
+ */
+Replxx::Color rgb( int red, int green, int blue );
+
+/*! \brief Turn foreground color into background color.
+ */
+Replxx::Color bg( Replxx::Color color );
+
+/*! \brief Add bold attribute to given color.
+ */
+Replxx::Color bold( Replxx::Color color );
+
+/*! \brief Add underline attribute to given color.
+ */
+Replxx::Color underline( Replxx::Color color );
+
+}
+
+/*! \brief Combine foreground color with background color.
+ *
+ * Attributes set in either of the colors are kept,
+ * foreground and background of the left one take precedence.
+ */
+Replxx::Color operator | ( Replxx::Color left, Replxx::Color right );
+
 }
 
 #endif /* HAVE_REPLXX_HXX_INCLUDED */
@@ -0,0 +1,404 @@
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#include "attributes.hxx"
+#include "utf8mirror.hxx"
+#include "conversion.hxx"
+#include "util.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+/*
+ * Layout of composed Replxx::Color value, named colors are stored
+ * as basic foreground without background so that their values stay as they are.
+ */
+long long const VALUE_MASK = 0xffffff;
+int const FG_KIND_SHIFT = 24;
+int const BG_SHIFT = 26;
+int const BG_KIND_SHIFT = 50;
+long long const BOLD = 1LL << 52;
+long long const UNDERLINE = 1LL << 53;
+
+// foreground kind is stored with BASIC as 0
+inline int fg_kind_code( Attr::KIND kind_ ) {
+	return ( kind_ == Attr::BASIC ? 0 : ( kind_ == Attr::DEFAULT ? 1 : kind_ ) );
+}
+
+inline Attr::KIND fg_kind( int code_ ) {
+	return ( code_ == 0 ? Attr::BASIC : ( code_ == 1 ? Attr::DEFAULT : static_cast<Attr::KIND>( code_ ) ) );
+}
+
+bool has_bright_colors( void ) {
+#ifdef _WIN32
+	static bool const has256colorDefault( true );
+#else
+	static bool const has256colorDefault( false );
+#endif
+	static char const* TERM( getenv( "TERM" ) );
+	static bool const has256color( TERM ? ( strstr( TERM, "256" ) != nullptr ) : has256colorDefault );
+	return ( has256color );
+}
+
+/*
+ * SGR parameters for foreground or background color, returns end of written text.
+ */
+char* color_params( char* out_, Attr::KIND kind_, int value_, bool background_ ) {
+	int base( background_ ? 40 : 30 );
+	switch ( kind_ ) {
+		case Attr::DEFAULT: {
+			out_ += sprintf( out_, "%d", base + 9 );
+		} break;
+		case Attr::BASIC: {
+			if ( value_ < 8 ) {
+				out_ += sprintf( out_, "%d", base + value_ );
+			} else {
+				// bright colors of terminals without 256 colors are made with bold
+				int bright( background_ ? 100 : ( has_bright_colors() ? 90 : 30 ) );
+				out_ += sprintf( out_, "%d", bright + value_ - 8 );
+			}
+		} break;
+		case Attr::PALETTE: {
+			out_ += sprintf( out_, "%d;5;%d", base + 8, value_ );
+		} break;
+		case Attr::RGB: {
+			out_ += sprintf( out_, "%d;2;%d;%d;%d", base + 8, ( value_ >> 16 ) & 0xff, ( value_ >> 8 ) & 0xff, value_ & 0xff );
+		} break;
+	}
+	return ( out_ );
+}
+
+inline char* separate( char* out_, char const* begin_ ) {
+	if ( out_ != begin_ ) {
+		*out_ ++ = ';';
+	}
+	return ( out_ );
+}
+
+/*
+ * Parameters setting `to_` after resetting everything.
+ */
+char* full_params( char* out_, Attr const& to_ ) {
+	*out_ ++ = '0';
+	if ( to_.bold ) {
+		out_ += sprintf( out_, ";1" );
+	}
+	if ( to_.underline ) {
+		out_ += sprintf( out_, ";4" );
+	}
+	if ( to_.fgKind != Attr::DEFAULT ) {
+		*out_ ++ = ';';
+		out_ = color_params( out_, to_.fgKind, to_.fg, false );
+	}
+	if ( to_.bgKind != Attr::DEFAULT ) {
+		*out_ ++ = ';';
+		out_ = color_params( out_, to_.bgKind, to_.bg, true );
+	}
+	*out_ = 0;
+	return ( out_ );
+}
+
+/*
+ * Parameters changing only what differs between `from_` and `to_`.
+ */
+char* delta_params( char* out_, Attr const& from_, Attr const& to_ ) {
+	char const* begin( out_ );
+	if ( from_.bold != to_.bold ) {
+		out_ += sprintf( out_, to_.bold ? "1" : "22" );
+	}
+	if ( from_.underline != to_.underline ) {
+		out_ = separate( out_, begin );
+		out_ += sprintf( out_, to_.underline ? "4" : "24" );
+	}
+	if ( ( from_.fgKind != to_.fgKind ) || ( from_.fg != to_.fg ) ) {
+		out_ = separate( out_, begin );
+		out_ = color_params( out_, to_.fgKind, to_.fg, false );
+	}
+	if ( ( from_.bgKind != to_.bgKind ) || ( from_.bg != to_.bg ) ) {
+		out_ = separate( out_, begin );
+		out_ = color_params( out_, to_.bgKind, to_.bg, true );
+	}
+	*out_ = 0;
+	return ( out_ );
+}
+
+/*
+ * Append shortest SGR sequence changing attributes from `from_` to `to_`.
+ */
+void append_transition( std::string& out_, Attr const& from_, Attr const& to_ ) {
+	if ( from_ == to_ ) {
+		return;
+	}
+	char full[64];
+	char delta[64];
+	int fullLen( static_cast<int>( full_params( full, to_ ) - full ) );
+	int deltaLen( static_cast<int>( delta_params( delta, from_, to_ ) - delta ) );
+	out_.append( "\033[", 2 );
+	if ( fullLen <= deltaLen ) {
+		out_.append( full, fullLen );
+	} else {
+		out_.append( delta, deltaLen );
+	}
+	out_.push_back( 'm' );
+}
+
+void append_utf8( std::string& out_, char32_t const* text_, int len_ ) {
+	int size( static_cast<int>( out_.size() ) );
+	int room( 4 * len_ + 1 );
+	int count( 0 );
+	out_.resize( size + room );
+	copyString32to8( &out_[size], room, text_, len_, &count );
+	out_.resize( size + count );
+}
+
+}
+
+Attr::Attr( Replxx::Color color_ )
+	: Attr() {
+	long long value( static_cast<long long>( color_ ) );
+	if ( value == static_cast<long long>( Replxx::Color::ERROR ) ) {
+		fgKind = BASIC;
+		fg = static_cast<int>( Replxx::Color::BROWN );
+		bgKind = BASIC;
+		bg = static_cast<int>( Replxx::Color::BRIGHTRED );
+		bold = true;
+		return;
+	}
+	if ( value < 0 ) {
+		return;
+	}
+	fgKind = fg_kind( static_cast<int>( ( value >> FG_KIND_SHIFT ) & 3 ) );
+	fg = static_cast<int>( value & VALUE_MASK );
+	if ( fgKind == BASIC ) {
+		fg &= 15;
+	} else if ( fgKind == DEFAULT ) {
+		fg = 0;
+	}
+	bgKind = static_cast<KIND>( ( value >> BG_KIND_SHIFT ) & 3 );
+	bg = bgKind != DEFAULT ? static_cast<int>( ( value >> BG_SHIFT ) & VALUE_MASK ) : 0;
+	if ( bgKind == BASIC ) {
+		bg &= 15;
+	}
+	bold = ( ( value & BOLD ) != 0 ) || ( ( fgKind == BASIC ) && ( fg >= 8 ) );
+	underline = ( value & UNDERLINE ) != 0;
+}
+
+Replxx::Color Attr::color( void ) const {
+	if ( *this == Attr() ) {
+		return ( Replxx::Color::DEFAULT );
+	}
+	long long value(
+		static_cast<long long>( fg )
+		| ( static_cast<long long>( fg_kind_code( fgKind ) ) << FG_KIND_SHIFT )
+		| ( static_cast<long long>( bg ) << BG_SHIFT )
+		| ( static_cast<long long>( bgKind ) << BG_KIND_SHIFT )
+	);
+	if ( bold && ! ( ( fgKind == BASIC ) && ( fg >= 8 ) ) ) {
+		value |= BOLD;
+	}
+	if ( underline ) {
+		value |= UNDERLINE;
+	}
+	return ( static_cast<Replxx::Color>( value ) );
+}
+
+namespace color {
+
+Replxx::Color palette( int index_ ) {
+	Attr attr;
+	attr.fgKind = Attr::PALETTE;
+	attr.fg = index_ & 0xff;
+	return ( attr.color() );
+}
+
+Replxx::Color rgb( int red_, int green_, int blue_ ) {
+	Attr attr;
+	attr.fgKind = Attr::RGB;
+	attr.fg = ( ( red_ & 0xff ) << 16 ) | ( ( green_ & 0xff ) << 8 ) | ( blue_ & 0xff );
+	return ( attr.color() );
+}
+
+Replxx::Color bg( Replxx::Color color_ ) {
+	Attr fg( color_ );
+	Attr attr;
+	attr.bgKind = fg.fgKind;
+	attr.bg = fg.fg;
+	return ( attr.color() );
+}
+
+Replxx::Color bold( Replxx::Color color_ ) {
+	Attr attr( color_ );
+	attr.bold = true;
+	return ( attr.color() );
+}
+
+Replxx::Color underline( Replxx::Color color_ ) {
+	Attr attr( color_ );
+	attr.underline = true;
+	return ( attr.color() );
+}
+
+}
+
+Replxx::Color operator | ( Replxx::Color left_, Replxx::Color right_ ) {
+	Attr attr( left_ );
+	Attr other( right_ );
+	if ( attr.fgKind == Attr::DEFAULT ) {
+		attr.fgKind = other.fgKind;
+		attr.fg = other.fg;
+	}
+	if ( attr.bgKind == Attr::DEFAULT ) {
+		attr.bgKind = other.bgKind;
+		attr.bg = other.bg;
+	}
+	attr.bold = attr.bold || other.bold;
+	attr.underline = attr.underline || other.underline;
+	return ( attr.color() );
+}
+
+char32_t const AttrTable::MARK;
+char32_t const AttrTable::RESET;
+int const AttrTable::MAX_SIZE;
+
+AttrTable::AttrTable( void )
+	: _entries()
+	, _marks() {
+	clear();
+}
+
+void AttrTable::clear( void ) {
+	_entries.clear();
+	_marks.clear();
+	mark( Replxx::Color::DEFAULT );
+}
+
+char32_t AttrTable::mark( Replxx::Color color_ ) {
+	long long key( static_cast<long long>( color_ ) );
+	std::unordered_map<long long, char32_t>::const_iterator it( _marks.find( key ) );
+	if ( it != _marks.end() ) {
+		return ( it->second );
+	}
+	Entry entry{ Attr( color_ ), std::string() };
+	if ( ( key >= static_cast<long long>( Replxx::Color::ERROR ) ) && ( key <= static_cast<long long>( Replxx::Color::WHITE ) ) ) {
+		// named colors keep their traditional sequences
+		entry.sgr = ansi_color( color_ );
+	} else {
+		char params[64];
+		full_params( params, entry.attr );
+		entry.sgr.assign( "\033[" ).append( params ).append( "m" );
+	}
+	char32_t m( MARK + static_cast<char32_t>( _entries.size() ) );
+	_entries.push_back( entry );
+	_marks.insert( std::make_pair( key, m ) );
+	return ( m );
+}
+
+void AttrTable::change( Attr const*& current_, Entry const& wanted_, std::string& out_ ) const {
+	if ( wanted_.attr == *current_ ) {
+		return;
+	}
+#ifdef _WIN32
+	// console emulation of escape sequences does not keep state between them
+	out_.append( wanted_.sgr );
+#else
+	append_transition( out_, *current_, wanted_.attr );
+#endif
+	current_ = &wanted_.attr;
+}
+
+void AttrTable::encode( char32_t const* text_, int len_, std::string& out_ ) const {
+	Attr const* current( &_entries.front().attr );
+	Entry const* wanted( &_entries.front() );
+	int i( 0 );
+	while ( i < len_ ) {
+		int run( i );
+		while ( ( run < len_ ) && ! is_mark( text_[run] ) ) {
+			++ run;
+		}
+		if ( run > i ) {
+			// attributes change only right before text they apply to
+			change( current, *wanted, out_ );
+			append_utf8( out_, text_ + i, run - i );
+		}
+		if ( run < len_ ) {
+			wanted = &_entries[text_[run] - MARK];
+			++ run;
+		}
+		i = run;
+	}
+	if ( *current != Attr() ) {
+		out_.append( _entries.front().sgr );
+	}
+}
+
+/*
+ * Encode text with separate runs, its first `mirror_.length()` characters
+ * are the mirrored text and their bytes are copied as they are.
+ */
+void AttrTable::encode( char32_t const* text_, int len_, attr_spans_t const& spans_, Utf8Mirror const& mirror_, std::string& out_ ) const {
+	Attr const* current( &_entries.front().attr );
+	int mirrored( min( mirror_.length(), len_ ) );
+	int spanCount( static_cast<int>( spans_.size() ) );
+	for ( int s( 0 ); s < spanCount; ++ s ) {
+		int start( spans_[s].start );
+		int end( ( s + 1 ) < spanCount ? spans_[s + 1].start : len_ );
+		if ( end > len_ ) {
+			end = len_;
+		}
+		if ( end > start ) {
+			change( current, _entries[spans_[s].attr - MARK], out_ );
+			if ( start < mirrored ) {
+				mirror_.append( out_, start, min( end, mirrored ) );
+				start = min( end, mirrored );
+			}
+			if ( end > start ) {
+				append_utf8( out_, text_ + start, end - start );
+			}
+		}
+	}
+	if ( *current != Attr() ) {
+		out_.append( _entries.front().sgr );
+	}
+}
+
+void reset_spans( attr_spans_t& spans_ ) {
+	spans_.assign( 1, AttrSpan{ 0, AttrTable::RESET } );
+}
+
+/*
+ * Attributes `attr_` apply from `pos_` on, `pos_` is not before start of the last run.
+ */
+void add_span( attr_spans_t& spans_, int pos_, char32_t attr_ ) {
+	if ( spans_.back().start == pos_ ) {
+		if ( spans_.size() == 1 ) {
+			spans_.back().attr = attr_;
+			return;
+		}
+		// run that would stay empty is replaced
+		spans_.pop_back();
+	}
+	if ( spans_.back().attr != attr_ ) {
+		spans_.push_back( AttrSpan{ pos_, attr_ } );
+	}
+}
+
+/*
+ * Index of the run containing `pos_`.
+ */
+int span_at( attr_spans_t const& spans_, int pos_ ) {
+	attr_spans_t::const_iterator it(
+		upper_bound(
+			spans_.begin(), spans_.end(), pos_,
+			[]( int pos, AttrSpan const& span ) { return ( pos < span.start ); }
+		)
+	);
+	return ( static_cast<int>( it - spans_.begin() ) - 1 );
+}
+
+}
+
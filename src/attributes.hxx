@@ -0,0 +1,116 @@
+#ifndef REPLXX_ATTRIBUTES_HXX_INCLUDED
+#define REPLXX_ATTRIBUTES_HXX_INCLUDED 1
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include "replxx.hxx"
+
+namespace replxx {
+
+class Utf8Mirror;
+
+/*
+ * Display attributes decoded from Replxx::Color.
+ */
+struct Attr {
+	enum KIND : unsigned char {
+		DEFAULT, // terminal default color
+		BASIC,   // one of 16 named colors
+		PALETTE, // 256 color palette index
+		RGB      // 24 bit color, 0xRRGGBB
+	};
+	KIND fgKind;
+	KIND bgKind;
+	int fg;
+	int bg;
+	bool bold;
+	bool underline;
+	Attr( void )
+		: fgKind( DEFAULT )
+		, bgKind( DEFAULT )
+		, fg( 0 )
+		, bg( 0 )
+		, bold( false )
+		, underline( false ) {
+	}
+	explicit Attr( Replxx::Color );
+	Replxx::Color color( void ) const;
+	bool operator == ( Attr const& other_ ) const {
+		return (
+			( fgKind == other_.fgKind ) && ( bgKind == other_.bgKind )
+			&& ( fg == other_.fg ) && ( bg == other_.bg )
+			&& ( bold == other_.bold ) && ( underline == other_.underline )
+		);
+	}
+	bool operator != ( Attr const& other_ ) const {
+		return ( ! operator == ( other_ ) );
+	}
+};
+
+/*
+ * Run of display text with the same attributes, it starts at `start`
+ * and lasts until start of the next run. Runs are kept canonical,
+ * first one starts at 0, none is empty and neighbours differ, so that
+ * equal text with equal runs shows the same on screen.
+ */
+struct AttrSpan {
+	int start;
+	char32_t attr; // marker of interned attributes
+	bool operator == ( AttrSpan const& other_ ) const {
+		return ( ( start == other_.start ) && ( attr == other_.attr ) );
+	}
+};
+typedef std::vector<AttrSpan> attr_spans_t;
+
+void reset_spans( attr_spans_t& );
+void add_span( attr_spans_t&, int, char32_t );
+int span_at( attr_spans_t const&, int );
+
+/*
+ * Attributes used in display, each one is referenced from runs of display
+ * and from patch text by a single marker character past the Unicode range,
+ * so that comparing displays compares attributes by identity. Escape sequence setting
+ * each attribute from scratch is encoded once when it is interned.
+ *
+ * encode() turns text into UTF-8, attribute changes given by markers
+ * inlined in the text or by separate runs become SGR sequences
+ * with only parameters that differ from attributes in effect.
+ * Characters of text that have a UTF-8 mirror are copied from it.
+ * Text written starts and ends with terminal default attributes.
+ */
+class AttrTable {
+public:
+	static char32_t const MARK = 0x110000;
+	static char32_t const RESET = MARK; // default attributes are interned first
+	static int const MAX_SIZE = 4096;
+private:
+	struct Entry {
+		Attr attr;
+		std::string sgr;
+	};
+	std::vector<Entry> _entries;
+	std::unordered_map<long long, char32_t> _marks;
+public:
+	AttrTable( void );
+	char32_t mark( Replxx::Color );
+	static bool is_mark( char32_t c_ ) {
+		return ( c_ >= MARK );
+	}
+	int size( void ) const {
+		return ( static_cast<int>( _entries.size() ) );
+	}
+	void clear( void );
+	void encode( char32_t const*, int, std::string& ) const;
+	void encode( char32_t const*, int, attr_spans_t const&, Utf8Mirror const&, std::string& ) const;
+private:
+	void change( Attr const*&, Entry const&, std::string& ) const;
+	AttrTable( AttrTable const& ) = delete;
+	AttrTable& operator = ( AttrTable const& ) = delete;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,126 @@
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+
+#include <io.h>
+
+#else /* _WIN32 */
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#endif /* _WIN32 */
+
+#include "batch.hxx"
+
+namespace replxx {
+
+BatchReader::BatchReader( int fd_ )
+	: _fd( fd_ )
+	, _map( nullptr )
+	, _mapSize( 0 )
+	, _buffer()
+	, _data( nullptr )
+	, _pos( 0 )
+	, _end( 0 )
+	, _eof( false ) {
+#ifndef _WIN32
+	struct stat st;
+	if ( ( fstat( _fd, &st ) == 0 ) && S_ISREG( st.st_mode ) && ( st.st_size > 0 ) ) {
+		off_t offset( lseek( _fd, 0, SEEK_CUR ) );
+		void* map( offset >= 0 ? mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0 ) : MAP_FAILED );
+		if ( map != MAP_FAILED ) {
+			madvise( map, st.st_size, MADV_SEQUENTIAL );
+			_map = static_cast<char const*>( map );
+			_mapSize = st.st_size;
+			_data = _map;
+			// input may have been partially consumed already
+			_pos = offset < st.st_size ? offset : st.st_size;
+			_end = _mapSize;
+			_eof = true;
+			return;
+		}
+	}
+#endif
+	_buffer.resize( BUFFER_SIZE );
+	_data = _buffer.data();
+}
+
+BatchReader::~BatchReader( void ) {
+#ifndef _WIN32
+	if ( _map ) {
+		// leave file offset where a reader of the same descriptor would expect it
+		lseek( _fd, _pos, SEEK_SET );
+		munmap( const_cast<char*>( _map ), _mapSize );
+	}
+#endif
+}
+
+/*
+ * Move unread part of the chunk to its start and read more after it,
+ * chunk is grown when a single line does not fit into it.
+ */
+void BatchReader::fill( void ) {
+	long long rest( _end - _pos );
+	if ( ( rest > 0 ) && ( _pos > 0 ) ) {
+		memmove( _buffer.data(), _buffer.data() + _pos, rest );
+	}
+	_pos = 0;
+	_end = rest;
+	if ( _end == static_cast<long long>( _buffer.size() ) ) {
+		_buffer.resize( _buffer.size() * 2 );
+	}
+	_data = _buffer.data();
+	int n( 0 );
+	do {
+#ifdef _WIN32
+		n = _read( _fd, _buffer.data() + _end, static_cast<unsigned>( _buffer.size() - _end ) );
+#else
+		n = static_cast<int>( ::read( _fd, _buffer.data() + _end, _buffer.size() - _end ) );
+#endif
+	} while ( ( n < 0 ) && ( errno == EINTR ) );
+	if ( n > 0 ) {
+		_end += n;
+	} else {
+		_eof = true;
+	}
+}
+
+/*
+ * Get up to `count` lines, without line terminators, fewer lines are returned
+ * when more input is needed for the next one, none only at the end of input.
+ */
+int BatchReader::read( Replxx::lines_t& lines_, int count_ ) {
+	lines_.clear();
+	while ( static_cast<int>( lines_.size() ) < count_ ) {
+		char const* start( _data + _pos );
+		char const* eol( static_cast<char const*>( memchr( start, '\n', _end - _pos ) ) );
+		if ( ! eol ) {
+			if ( _eof ) {
+				if ( _pos < _end ) {
+					// last line is not terminated
+					eol = _data + _end;
+				} else {
+					break;
+				}
+			} else if ( lines_.empty() ) {
+				fill();
+				continue;
+			} else {
+				break;
+			}
+		}
+		char const* end( eol );
+		while ( ( end > start ) && ( end[-1] == '\r' ) ) {
+			-- end;
+		}
+		lines_.push_back( Replxx::LineView{ start, static_cast<int>( end - start ) } );
+		_pos = eol - _data + ( eol < ( _data + _end ) ? 1 : 0 );
+	}
+	return ( static_cast<int>( lines_.size() ) );
+}
+
+}
+
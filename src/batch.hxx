@@ -0,0 +1,40 @@
+#ifndef REPLXX_BATCH_HXX_INCLUDED
+#define REPLXX_BATCH_HXX_INCLUDED 1
+
+#include <vector>
+
+#include "replxx.hxx"
+
+namespace replxx {
+
+/*
+ * Reader of non-interactive input handing out lines as views into its buffer.
+ *
+ * Regular file is mapped into memory as a whole, any other input is read
+ * in large chunks. Lines returned by read() stay valid until its next call,
+ * chunk is refilled only when no line of current batch points into it.
+ */
+class BatchReader {
+	static int const BUFFER_SIZE = 1024 * 1024;
+	int _fd;
+	char const* _map;          // whole input file, nullptr if input is read
+	long long _mapSize;
+	std::vector<char> _buffer; // chunk of input read so far
+	char const* _data;         // mapped file or read buffer
+	long long _pos;            // first character not yet returned
+	long long _end;            // end of valid data
+	bool _eof;
+public:
+	BatchReader( int );
+	~BatchReader( void );
+	int read( Replxx::lines_t&, int );
+private:
+	void fill( void );
+	BatchReader( BatchReader const& ) = delete;
+	BatchReader& operator = ( BatchReader const& ) = delete;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,150 @@
+#include <algorithm>
+
+#include "braces.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+int brace_type( char32_t c, bool& opening ) {
+	switch ( c ) {
+		case '(': opening = true;  return ( 0 );
+		case ')': opening = false; return ( 0 );
+		case '[': opening = true;  return ( 1 );
+		case ']': opening = false; return ( 1 );
+		case '{': opening = true;  return ( 2 );
+		case '}': opening = false; return ( 2 );
+	}
+	return ( -1 );
+}
+
+}
+
+BraceIndex::BraceIndex( void )
+	: _match()
+	, _balance( 1, 0 )
+	, _blocks()
+	, _state()
+	, _dirty( 0 )
+	, _quoteAware( false ) {
+	clear();
+}
+
+void BraceIndex::set_quote_aware( bool quoteAware_ ) {
+	if ( quoteAware_ != _quoteAware ) {
+		_quoteAware = quoteAware_;
+		clear();
+	}
+}
+
+void BraceIndex::clear( void ) {
+	_match.clear();
+	_balance.assign( 1, 0 );
+	_blocks.clear();
+	_state = State();
+	_state.quote = 0;
+	_state.escape = false;
+	_blocks.push_back( _state );
+	_dirty = 0;
+}
+
+/*
+ * Note that input was modified starting at `pos_`.
+ */
+void BraceIndex::changed( int pos_ ) {
+	_dirty = min( _dirty, pos_ );
+}
+
+/*
+ * Bring the table in sync with given text.
+ */
+void BraceIndex::update( char32_t const* text_, int len_ ) {
+	int oldLen( static_cast<int>( _match.size() ) );
+	int common( min( _dirty, min( oldLen, len_ ) ) );
+	_dirty = len_;
+	if ( ( common == oldLen ) && ( common == len_ ) ) {
+		return;
+	}
+	if ( common < oldLen ) {
+		// rewind to the last block boundary not past the first modified character
+		int block( common / BLOCK_SIZE );
+		int start( block * BLOCK_SIZE );
+		_state = _blocks[block];
+		for ( std::vector<int> const& open : _state.open ) {
+			for ( int pos : open ) {
+				_match[pos] = -1;
+			}
+		}
+		_blocks.resize( block + 1 );
+		_match.resize( start );
+		_balance.resize( start + 1 );
+		common = start;
+	}
+	for ( int i( common ); i < len_; ++ i ) {
+		if ( ( ( i % BLOCK_SIZE ) == 0 ) && ( ( i / BLOCK_SIZE ) == static_cast<int>( _blocks.size() ) ) ) {
+			_blocks.push_back( _state );
+		}
+		scan( i, text_[i] );
+	}
+}
+
+void BraceIndex::scan( int pos_, char32_t c_ ) {
+	_match.push_back( -1 );
+	int balance( _balance.back() );
+	if ( _quoteAware && ( _state.quote != 0 ) ) {
+		if ( _state.escape ) {
+			_state.escape = false;
+		} else if ( c_ == '\\' ) {
+			_state.escape = true;
+		} else if ( c_ == _state.quote ) {
+			_state.quote = 0;
+		}
+		_balance.push_back( balance );
+		return;
+	}
+	if ( _quoteAware && ( ( c_ == '"' ) || ( c_ == '\'' ) ) ) {
+		_state.quote = c_;
+		_balance.push_back( balance );
+		return;
+	}
+	bool opening( false );
+	int type( brace_type( c_, opening ) );
+	if ( type >= 0 ) {
+		std::vector<int>& open( _state.open[type] );
+		if ( opening ) {
+			open.push_back( pos_ );
+			++ balance;
+		} else {
+			if ( ! open.empty() ) {
+				_match[pos_] = open.back();
+				_match[open.back()] = pos_;
+				open.pop_back();
+			}
+			-- balance;
+		}
+	}
+	_balance.push_back( balance );
+}
+
+/*
+ * Get position of brace matching the one at `pos`, -1 if there is none,
+ * `error` tells if other braces between the pair are not balanced.
+ */
+int BraceIndex::match( int pos_, bool& error_ ) const {
+	error_ = false;
+	if ( ( pos_ < 0 ) || ( pos_ >= static_cast<int>( _match.size() ) ) ) {
+		return ( -1 );
+	}
+	int other( _match[pos_] );
+	if ( other >= 0 ) {
+		int lo( min( pos_, other ) );
+		int hi( max( pos_, other ) );
+		error_ = ( _balance[hi] - _balance[lo + 1] ) != 0;
+	}
+	return ( other );
+}
+
+}
+
@@ -0,0 +1,46 @@
+#ifndef REPLXX_BRACES_HXX_INCLUDED
+#define REPLXX_BRACES_HXX_INCLUDED 1
+
+#include <vector>
+
+namespace replxx {
+
+/*
+ * Matching brace lookup table for the input line.
+ *
+ * Each bracket type is matched independently, a match is reported
+ * as an error when brackets of other types between the pair
+ * do not balance. Edits of the input only note the first modified
+ * character with changed(), table is refreshed lazily with update()
+ * which rescans only text following it, starting from scanner state
+ * saved at nearest block boundary.
+ */
+class BraceIndex {
+	static int const TYPE_COUNT = 3;
+	static int const BLOCK_SIZE = 256;
+	struct State {
+		std::vector<int> open[TYPE_COUNT]; // positions of not yet closed braces
+		char32_t quote;                     // quote character of string being scanned, 0 outside of string
+		bool escape;                        // previous character was backslash inside string
+	};
+	std::vector<int> _match;   // matching brace position, -1 if none, one per scanned character
+	std::vector<int> _balance; // _balance[i] - opening minus closing braces in [0, i)
+	std::vector<State> _blocks; // scanner state at each BLOCK_SIZE boundary
+	State _state;               // scanner state at the end of scanned text
+	int _dirty;                 // first character modified since last update()
+	bool _quoteAware;
+public:
+	BraceIndex( void );
+	void set_quote_aware( bool );
+	void changed( int );
+	void update( char32_t const*, int );
+	int match( int, bool& ) const;
+	void clear( void );
+private:
+	void scan( int, char32_t );
+};
+
+}
+
+#endif
+
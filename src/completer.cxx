@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <queue>
+#include <memory>
+
+#include "completer.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+/*
+ * Node reached by complete_weighted(), text of its path is built
+ * only if a word ending in it is returned.
+ */
+struct Step {
+	int node;
+	int parent; // index of parent step, -1 for the node prefix leads to
+	int depth;  // bytes of path below the node prefix leads to
+};
+
+struct Candidate {
+	int weight;
+	int order;
+	bool isWord;
+	int step;
+	bool operator < ( Candidate const& other_ ) const {
+		// heaviest first, then lexicographical order, then words before subtrees
+		if ( weight != other_.weight ) {
+			return ( weight < other_.weight );
+		}
+		if ( order != other_.order ) {
+			return ( order > other_.order );
+		}
+		return ( ! isWord && other_.isWord );
+	}
+};
+
+inline bool has_room( Completer::words_t const& words_, int limit_ ) {
+	return ( ( limit_ < 0 ) || ( static_cast<int>( words_.size() ) < limit_ ) );
+}
+
+}
+
+Completer::CompleterImpl::CompleterImpl( void )
+	: _labels()
+	, _nodes( 1, Node{ 0, 0, 1, 0, -1, -1, 0 } )
+	, _size( 0 ) {
+}
+
+Completer::CompleterImpl::CompleterImpl( words_t const& words_, weights_t const& weights_ )
+	: _labels()
+	, _nodes( 1, Node{ 0, 0, 1, 0, -1, -1, 0 } )
+	, _size( 0 ) {
+	vector<int> order;
+	order.reserve( words_.size() );
+	for ( int i( 0 ), count( static_cast<int>( words_.size() ) ); i < count; ++ i ) {
+		if ( ! words_[i].empty() ) {
+			order.push_back( i );
+		}
+	}
+	sort(
+		order.begin(), order.end(),
+		[&words_]( int l, int r ) {
+			return ( words_[l] < words_[r] );
+		}
+	);
+	words_t words;
+	weights_t weights;
+	words.reserve( order.size() );
+	weights.reserve( order.size() );
+	for ( int i : order ) {
+		int weight( i < static_cast<int>( weights_.size() ) ? max( weights_[i], 0 ) : 0 );
+		if ( ! words.empty() && ( words.back() == words_[i] ) ) {
+			weights.back() = max( weights.back(), weight );
+			continue;
+		}
+		words.push_back( words_[i] );
+		weights.push_back( weight );
+	}
+	_size = static_cast<int>( words.size() );
+	int preorder( 0 );
+	build( words, weights, 0, 0, _size, 0, preorder );
+}
+
+/*
+ * All words in [lo, hi) share first `depth` bytes which are already
+ * represented by the path leading to `node`, nodes are visited in preorder.
+ */
+void Completer::CompleterImpl::build( words_t const& words_, weights_t const& weights_, int node_, int lo_, int hi_, int depth_, int& order_ ) {
+	_nodes[node_].order = order_;
+	++ order_;
+	int maxWeight( -1 );
+	if ( ( lo_ < hi_ ) && ( static_cast<int>( words_[lo_].length() ) == depth_ ) ) {
+		_nodes[node_].weight = maxWeight = weights_[lo_];
+		++ lo_;
+	}
+	vector<int> groups;
+	for ( int i( lo_ ); i < hi_; ) {
+		groups.push_back( i );
+		char c( words_[i][depth_] );
+		while ( ( i < hi_ ) && ( words_[i][depth_] == c ) ) {
+			++ i;
+		}
+	}
+	groups.push_back( hi_ );
+	int childCount( static_cast<int>( groups.size() ) - 1 );
+	int firstChild( static_cast<int>( _nodes.size() ) );
+	_nodes[node_].firstChild = firstChild;
+	_nodes[node_].childCount = childCount;
+	_nodes.resize( firstChild + childCount );
+	for ( int i( 0 ); i < childCount; ++ i ) {
+		std::string const& first( words_[groups[i]] );
+		std::string const& last( words_[groups[i + 1] - 1] );
+		int commonLength( depth_ + 1 );
+		int maxLength( static_cast<int>( min( first.length(), last.length() ) ) );
+		while ( ( commonLength < maxLength ) && ( first[commonLength] == last[commonLength] ) ) {
+			++ commonLength;
+		}
+		Node& child( _nodes[firstChild + i] );
+		child.labelOffset = static_cast<int>( _labels.length() );
+		child.labelLength = commonLength - depth_;
+		child.weight = -1;
+		_labels.append( first, depth_, commonLength - depth_ );
+		build( words_, weights_, firstChild + i, groups[i], groups[i + 1], commonLength, order_ );
+		maxWeight = max( maxWeight, _nodes[firstChild + i].maxWeight );
+	}
+	_nodes[node_].maxWeight = maxWeight;
+}
+
+/*
+ * Find the topmost node which subtree holds all words starting with `prefix`,
+ * `path` receives full text leading to that node.
+ */
+int Completer::CompleterImpl::locate( std::string const& prefix_, std::string& path_ ) const {
+	path_.clear();
+	int node( 0 );
+	int pos( 0 );
+	int len( static_cast<int>( prefix_.length() ) );
+	while ( pos < len ) {
+		Node const& parent( _nodes[node] );
+		unsigned char c( static_cast<unsigned char>( prefix_[pos] ) );
+		int lo( parent.firstChild );
+		int hi( parent.firstChild + parent.childCount );
+		while ( lo < hi ) {
+			int mid( ( lo + hi ) / 2 );
+			if ( static_cast<unsigned char>( _labels[_nodes[mid].labelOffset] ) < c ) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		if ( ( lo == ( parent.firstChild + parent.childCount ) ) || ( static_cast<unsigned char>( _labels[_nodes[lo].labelOffset] ) != c ) ) {
+			return ( -1 );
+		}
+		Node const& child( _nodes[lo] );
+		int cmpLen( min( child.labelLength, len - pos ) );
+		if ( _labels.compare( child.labelOffset, cmpLen, prefix_, pos, cmpLen ) != 0 ) {
+			return ( -1 );
+		}
+		path_.append( _labels, child.labelOffset, child.labelLength );
+		pos += child.labelLength;
+		node = lo;
+	}
+	return ( node );
+}
+
+/*
+ * Pass all words in subtree of `node` to the visitor,
+ * false is returned when visitor stopped the walk.
+ */
+bool Completer::CompleterImpl::collect( int node_, std::string& path_, visitor_t const& visitor_ ) const {
+	Node const& node( _nodes[node_] );
+	if ( ( node.weight >= 0 ) && ! visitor_( path_ ) ) {
+		return ( false );
+	}
+	for ( int i( 0 ); i < node.childCount; ++ i ) {
+		Node const& child( _nodes[node.firstChild + i] );
+		path_.append( _labels, child.labelOffset, child.labelLength );
+		bool more( collect( node.firstChild + i, path_, visitor_ ) );
+		path_.erase( path_.length() - child.labelLength );
+		if ( ! more ) {
+			return ( false );
+		}
+	}
+	return ( true );
+}
+
+void Completer::CompleterImpl::scan( int node_, std::string& path_, std::string const& infix_, words_t& words_, int limit_ ) const {
+	Node const& node( _nodes[node_] );
+	if ( ( node.weight >= 0 ) && has_room( words_, limit_ ) && ( path_.find( infix_ ) != std::string::npos ) ) {
+		words_.push_back( path_ );
+	}
+	for ( int i( 0 ); ( i < node.childCount ) && has_room( words_, limit_ ); ++ i ) {
+		Node const& child( _nodes[node.firstChild + i] );
+		path_.append( _labels, child.labelOffset, child.labelLength );
+		scan( node.firstChild + i, path_, infix_, words_, limit_ );
+		path_.erase( path_.length() - child.labelLength );
+	}
+}
+
+void Completer::CompleterImpl::complete( std::string const& prefix_, visitor_t const& visitor_ ) const {
+	std::string path;
+	int node( locate( prefix_, path ) );
+	if ( node >= 0 ) {
+		collect( node, path, visitor_ );
+	}
+}
+
+Completer::words_t Completer::CompleterImpl::complete_weighted( std::string const& prefix_, int limit_ ) const {
+	words_t words;
+	std::string path;
+	int node( locate( prefix_, path ) );
+	if ( node < 0 ) {
+		return ( words );
+	}
+	vector<Step> steps( 1, Step{ node, -1, 0 } );
+	priority_queue<Candidate> candidates;
+	candidates.push( Candidate{ _nodes[node].maxWeight, _nodes[node].order, false, 0 } );
+	while ( ! candidates.empty() && has_room( words, limit_ ) ) {
+		Candidate candidate( candidates.top() );
+		candidates.pop();
+		Step const step( steps[candidate.step] );
+		if ( candidate.isWord ) {
+			words.push_back( path );
+			std::string& word( words.back() );
+			word.resize( path.length() + step.depth );
+			for ( int s( candidate.step ); steps[s].parent >= 0; s = steps[s].parent ) {
+				Node const& n( _nodes[steps[s].node] );
+				word.replace( path.length() + steps[s].depth - n.labelLength, n.labelLength, _labels, n.labelOffset, n.labelLength );
+			}
+			continue;
+		}
+		Node const& n( _nodes[step.node] );
+		if ( n.weight >= 0 ) {
+			candidates.push( Candidate{ n.weight, n.order, true, candidate.step } );
+		}
+		for ( int i( 0 ); i < n.childCount; ++ i ) {
+			Node const& child( _nodes[n.firstChild + i] );
+			steps.push_back( Step{ n.firstChild + i, candidate.step, step.depth + child.labelLength } );
+			candidates.push( Candidate{ child.maxWeight, child.order, false, static_cast<int>( steps.size() ) - 1 } );
+		}
+	}
+	return ( words );
+}
+
+Completer::words_t Completer::CompleterImpl::find( std::string const& infix_, int limit_ ) const {
+	words_t words;
+	std::string path;
+	scan( 0, path, infix_, words, limit_ );
+	return ( words );
+}
+
+Completer::Completer( void )
+	: _impl( std::make_shared<CompleterImpl>() ) {
+}
+
+Completer::Completer( words_t const& words_, weights_t const& weights_ )
+	: _impl( std::make_shared<CompleterImpl>( words_, weights_ ) ) {
+}
+
+Completer::words_t Completer::complete( std::string const& prefix_, int limit_ ) const {
+	words_t words;
+	if ( limit_ != 0 ) {
+		complete(
+			prefix_,
+			[&words, limit_]( std::string const& word_ ) {
+				words.push_back( word_ );
+				return ( has_room( words, limit_ ) );
+			}
+		);
+	}
+	return ( words );
+}
+
+void Completer::complete( std::string const& prefix_, visitor_t const& visitor_ ) const {
+	_impl->complete( prefix_, visitor_ );
+}
+
+Completer::words_t Completer::complete_weighted( std::string const& prefix_, int limit_ ) const {
+	return ( _impl->complete_weighted( prefix_, limit_ ) );
+}
+
+Completer::words_t Completer::find( std::string const& infix_, int limit_ ) const {
+	return ( _impl->find( infix_, limit_ ) );
+}
+
+int Completer::size( void ) const {
+	return ( _impl->size() );
+}
+
+}
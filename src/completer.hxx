@@ -0,0 +1,50 @@
+#ifndef REPLXX_COMPLETER_HXX_INCLUDED
+#define REPLXX_COMPLETER_HXX_INCLUDED 1
+
+#include <vector>
+#include <string>
+
+#include "replxx.hxx"
+
+namespace replxx {
+
+// compressed trie, immutable once built, shared by all Completer copies
+class Completer::CompleterImpl {
+public:
+	typedef Completer::words_t words_t;
+	typedef Completer::weights_t weights_t;
+	typedef Completer::visitor_t visitor_t;
+private:
+	struct Node {
+		int labelOffset; // edge label position in _labels
+		int labelLength;
+		int firstChild;  // children are stored contiguously, sorted by first label byte
+		int childCount;
+		int weight;      // word weight, -1 if no word ends in this node
+		int maxWeight;   // maximum word weight in this subtree
+		int order;       // position in preorder walk, same as lexicographical order of paths
+	};
+	typedef std::vector<Node> nodes_t;
+	std::string _labels;
+	nodes_t _nodes;
+	int _size;
+public:
+	CompleterImpl( void );
+	CompleterImpl( words_t const&, weights_t const& );
+	void complete( std::string const&, visitor_t const& ) const;
+	words_t complete_weighted( std::string const&, int ) const;
+	words_t find( std::string const&, int ) const;
+	int size( void ) const {
+		return ( _size );
+	}
+private:
+	void build( words_t const&, weights_t const&, int, int, int, int, int& );
+	int locate( std::string const&, std::string& ) const;
+	bool collect( int, std::string&, visitor_t const& ) const;
+	void scan( int, std::string&, std::string const&, words_t&, int ) const;
+};
+
+}
+
+#endif
+
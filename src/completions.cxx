@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cstring>
+
+#include "completions.hxx"
+#include "history.hxx"
+#include "conversion.hxx"
+#include "utf8string.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+CompletionCollector::CompletionCollector( int limit_, History const* history_ )
+	: _limit( limit_ )
+	, _history( history_ )
+	, _count( 0 )
+	, _commonPrefix()
+	, _entries() {
+}
+
+bool CompletionCollector::better( Entry const& l, Entry const& r ) {
+	return ( ( l.score > r.score ) || ( ( l.score == r.score ) && ( l.order < r.order ) ) );
+}
+
+void CompletionCollector::add( std::string const& completion_ ) {
+	if ( _count == 0 ) {
+		_commonPrefix = completion_;
+	} else {
+		string::size_type len( min( _commonPrefix.length(), completion_.length() ) );
+		string::size_type common( 0 );
+		while ( ( common < len ) && ( _commonPrefix[common] == completion_[common] ) ) {
+			++ common;
+		}
+		_commonPrefix.erase( common );
+	}
+	Entry entry{ _history ? _history->token_score( completion_ ) : 0.0, _count, string() };
+	++ _count;
+	/* _entries is a heap with the worst kept completion on top */
+	if ( ( _limit <= 0 ) || ( static_cast<int>( _entries.size() ) < _limit ) ) {
+		entry.text = completion_;
+		_entries.push_back( std::move( entry ) );
+		push_heap( _entries.begin(), _entries.end(), &CompletionCollector::better );
+	} else if ( better( entry, _entries.front() ) ) {
+		entry.text = completion_;
+		pop_heap( _entries.begin(), _entries.end(), &CompletionCollector::better );
+		_entries.back() = std::move( entry );
+		push_heap( _entries.begin(), _entries.end(), &CompletionCollector::better );
+	}
+}
+
+/*
+ * Common prefix is tracked in bytes,
+ * do not count incomplete trailing UTF-8 sequence.
+ */
+int CompletionCollector::common_prefix_length( void ) const {
+	int len( static_cast<int>( _commonPrefix.length() ) );
+	int lead( len );
+	while ( ( lead > 0 ) && ( ( static_cast<unsigned char>( _commonPrefix[lead - 1] ) & 0xc0 ) == 0x80 ) ) {
+		-- lead;
+	}
+	if ( ! locale::is8BitEncoding && ( lead > 0 ) ) {
+		unsigned char c( static_cast<unsigned char>( _commonPrefix[lead - 1] ) );
+		int seqLen( c < 0x80 ? 1 : ( c < 0xe0 ? 2 : ( c < 0xf0 ? 3 : 4 ) ) );
+		if ( ( len - lead + 1 ) < seqLen ) {
+			len = lead - 1;
+		}
+	}
+	return ( UnicodeString( _commonPrefix.substr( 0, static_cast<size_t>( len ) ) ).length() );
+}
+
+CompletionCollector::data_t CompletionCollector::data( void ) {
+	sort_heap( _entries.begin(), _entries.end(), &CompletionCollector::better );
+	data_t data;
+	data.reserve( _entries.size() );
+	for ( Entry const& e : _entries ) {
+		data.emplace_back( e.text );
+	}
+	return ( data );
+}
+
+CompletionCache::CompletionCache( void )
+	: _anchor()
+	, _contextLen( 0 )
+	, _context()
+	, _arena()
+	, _offsets( 1, 0 )
+	, _matches()
+	, _filter()
+	, _valid( false ) {
+}
+
+void CompletionCache::clear( void ) {
+	_valid = false;
+	_anchor.clear();
+	_context.clear();
+	_arena.clear();
+	_offsets.assign( 1, 0 );
+	_matches.clear();
+	_filter.clear();
+}
+
+void CompletionCache::add( std::string const& completion_ ) {
+	_arena.append( completion_ );
+	_offsets.push_back( static_cast<int>( _arena.length() ) );
+}
+
+void CompletionCache::commit( UnicodeString const& anchor_, int contextLen_ ) {
+	_anchor.assign( anchor_ );
+	_contextLen = contextLen_;
+	_context = Utf8String( UnicodeString( anchor_.get() + anchor_.length() - contextLen_, contextLen_ ) ).get();
+	_filter = _context;
+	int count( static_cast<int>( _offsets.size() ) - 1 );
+	_matches.resize( count );
+	for ( int i( 0 ); i < count; ++ i ) {
+		_matches[i] = i;
+	}
+	_valid = true;
+}
+
+/*
+ * Only candidates that survived previous, shorter filter need
+ * to be checked again when the filter is extended.
+ */
+void CompletionCache::filter( std::string const& prefix_, Replxx::CompletionSink& sink_ ) {
+	bool narrowing( ( prefix_.length() >= _filter.length() ) && ( prefix_.compare( 0, _filter.length(), _filter ) == 0 ) );
+	if ( ! narrowing ) {
+		int count( static_cast<int>( _offsets.size() ) - 1 );
+		_matches.resize( count );
+		for ( int i( 0 ); i < count; ++ i ) {
+			_matches[i] = i;
+		}
+	}
+	if ( prefix_.length() > _context.length() ) {
+		char const* arena( _arena.data() );
+		int len( static_cast<int>( prefix_.length() ) );
+		int kept( 0 );
+		for ( int i : _matches ) {
+			int offset( _offsets[i] );
+			if ( ( ( _offsets[i + 1] - offset ) >= len ) && ( memcmp( arena + offset, prefix_.data(), len ) == 0 ) ) {
+				_matches[kept] = i;
+				++ kept;
+			}
+		}
+		_matches.resize( kept );
+	}
+	_filter = prefix_;
+	for ( int i : _matches ) {
+		sink_.add( _arena.substr( _offsets[i], _offsets[i + 1] - _offsets[i] ) );
+	}
+}
+
+}
+
@@ -0,0 +1,131 @@
+#ifndef REPLXX_COMPLETIONS_HXX_INCLUDED
+#define REPLXX_COMPLETIONS_HXX_INCLUDED 1
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+
+#include "replxx.hxx"
+#include "unicodestring.hxx"
+
+namespace replxx {
+
+class History;
+
+/*
+ * Collects streamed completions keeping only `limit` best of them
+ * in a heap, total count and common prefix cover all of them.
+ */
+class CompletionCollector : public Replxx::CompletionSink {
+public:
+	typedef std::vector<UnicodeString> data_t;
+private:
+	struct Entry {
+		double score;
+		int order;
+		std::string text;
+	};
+	typedef std::vector<Entry> entries_t;
+	int _limit;
+	History const* _history; // used for ranking, nullptr if ranking is disabled
+	int _count;
+	std::string _commonPrefix;
+	entries_t _entries;
+public:
+	CompletionCollector( int limit, History const* history );
+	virtual void add( std::string const& completion ) override;
+	int count( void ) const {
+		return ( _count );
+	}
+	int common_prefix_length( void ) const;
+	data_t data( void );
+private:
+	static bool better( Entry const&, Entry const& );
+	CompletionCollector( CompletionCollector const& ) = delete;
+	CompletionCollector& operator = ( CompletionCollector const& ) = delete;
+};
+
+/*
+ * Plain list of completions.
+ */
+class CompletionList : public Replxx::CompletionSink {
+public:
+	Replxx::completions_t data;
+	virtual void add( std::string const& completion_ ) override {
+		data.push_back( completion_ );
+	}
+};
+
+/*
+ * Single asynchronous run of a completion source.
+ */
+struct CompletionJob {
+	std::mutex mutex;
+	std::condition_variable done;
+	bool finished;
+	int contextLen;
+	Replxx::completions_t completions;
+	CompletionJob( int contextLen_ )
+		: mutex()
+		, done()
+		, finished( false )
+		, contextLen( contextLen_ )
+		, completions() {
+	}
+};
+
+/*
+ * Candidates fetched from completion source for given input,
+ * narrowed down in place as user keeps extending the completion context.
+ */
+class CompletionCache {
+	UnicodeString _anchor; // input up to cursor when candidates were fetched
+	int _contextLen;       // context length reported by completion source
+	std::string _context;  // UTF-8 encoded context candidates were fetched for
+	std::string _arena;    // all candidates stored back to back
+	std::vector<int> _offsets; // candidate i spans [_offsets[i], _offsets[i + 1])
+	std::vector<int> _matches; // candidates starting with _filter
+	std::string _filter;
+	bool _valid;
+public:
+	/*
+	 * Records candidates into the cache while forwarding them to the collector,
+	 * all candidates are recorded, not only those the collector keeps.
+	 */
+	class Recorder : public Replxx::CompletionSink {
+		CompletionCache& _cache;
+		Replxx::CompletionSink& _sink;
+	public:
+		Recorder( CompletionCache& cache_, Replxx::CompletionSink& sink_ )
+			: _cache( cache_ )
+			, _sink( sink_ ) {
+			_cache.clear();
+		}
+		virtual void add( std::string const& completion_ ) override {
+			_cache.add( completion_ );
+			_sink.add( completion_ );
+		}
+	};
+	CompletionCache( void );
+	void clear( void );
+	void commit( UnicodeString const& anchor, int contextLen );
+	bool valid( void ) const {
+		return ( _valid );
+	}
+	UnicodeString const& anchor( void ) const {
+		return ( _anchor );
+	}
+	int context_length( void ) const {
+		return ( _contextLen );
+	}
+	void filter( std::string const& prefix, Replxx::CompletionSink& sink );
+private:
+	void add( std::string const& );
+	CompletionCache( CompletionCache const& ) = delete;
+	CompletionCache& operator = ( CompletionCache const& ) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef REPLXX_DEADLINE_HXX_INCLUDED
+#define REPLXX_DEADLINE_HXX_INCLUDED 1
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+#include "threadpool.hxx"
+
+namespace replxx {
+
+/*
+ * Runs user callback on a worker thread bounding the time
+ * the caller waits for its result.
+ *
+ * At most one invocation is in flight at any time, when it does not
+ * finish before the deadline the result for the most recent input is
+ * returned instead and the overrun is counted.
+ */
+template<typename result_t>
+class DeadlineCall {
+public:
+	typedef std::function<result_t ( void )> call_t;
+private:
+	struct Job {
+		std::mutex mutex;
+		std::condition_variable done;
+		bool finished;
+		std::string key;
+		result_t result;
+	};
+	std::shared_ptr<Job> _job;
+	result_t _last;
+	int _overruns;
+public:
+	DeadlineCall( void )
+		: _job()
+		, _last()
+		, _overruns( 0 ) {
+	}
+	/*
+	 * Return true if `result` is fresh, i.e. was produced for `key`.
+	 */
+	bool call( ThreadPool& pool_, int deadline_, std::string const& key_, call_t const& fn_, result_t& result_ ) {
+		std::chrono::steady_clock::time_point deadline( std::chrono::steady_clock::now() + std::chrono::milliseconds( deadline_ ) );
+		if ( !! _job && ! wait( deadline ) ) {
+			++ _overruns;
+			result_ = _last;
+			return ( false );
+		}
+		if ( ! _job || ( _job->key != key_ ) ) {
+			std::shared_ptr<Job> job( std::make_shared<Job>() );
+			job->finished = false;
+			job->key = key_;
+			_job = job;
+			pool_.post(
+				[job, fn_]() {
+					result_t result( fn_() );
+					std::lock_guard<std::mutex> l( job->mutex );
+					job->result = std::move( result );
+					job->finished = true;
+					job->done.notify_all();
+				}
+			);
+			if ( ! wait( deadline ) ) {
+				++ _overruns;
+				result_ = _last;
+				return ( false );
+			}
+		}
+		_last = _job->result;
+		result_ = _last;
+		return ( true );
+	}
+	bool in_flight( void ) const {
+		if ( ! _job ) {
+			return ( false );
+		}
+		std::lock_guard<std::mutex> l( _job->mutex );
+		return ( ! _job->finished );
+	}
+	int overruns( void ) const {
+		return ( _overruns );
+	}
+	void reset( void ) {
+		_job.reset();
+		_last = result_t();
+	}
+private:
+	bool wait( std::chrono::steady_clock::time_point deadline_ ) {
+		Job& job( *_job );
+		std::unique_lock<std::mutex> l( job.mutex );
+		return ( job.done.wait_until( l, deadline_, [&job]() { return ( job.finished ); } ) );
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,35 @@
+#include <memory>
+
+#include "replxx.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+CompletionDictionary::CompletionDictionary( void )
+	: _snapshot( make_shared<Completer const>() ) {
+}
+
+CompletionDictionary::CompletionDictionary( words_t const& words_, weights_t const& weights_ )
+	: _snapshot( make_shared<Completer const>( words_, weights_ ) ) {
+}
+
+void CompletionDictionary::update( words_t const& words_, weights_t const& weights_ ) {
+	snapshot_t snapshot( make_shared<Completer const>( words_, weights_ ) );
+	atomic_store( &_snapshot, snapshot );
+}
+
+CompletionDictionary::snapshot_t CompletionDictionary::snapshot( void ) const {
+	return ( atomic_load( &_snapshot ) );
+}
+
+CompletionDictionary::words_t CompletionDictionary::complete( std::string const& prefix_ ) const {
+	return ( snapshot()->complete( prefix_ ) );
+}
+
+int CompletionDictionary::size( void ) const {
+	return ( snapshot()->size() );
+}
+
+}
+
@@ -38,7 +38,9 @@ namespace EscapeSequenceProcessing { // move these out of global namespace
 // changes and extensions without having to touch a lot of code.
 
 
-static char32_t thisKeyMetaCtrl = 0;	// holds pre-set Meta and/or Ctrl modifiers
+// State of sequence being parsed, valid only during doDispatch( Terminal&, char32_t ).
+static thread_local char32_t thisKeyMetaCtrl = 0;	// holds pre-set Meta and/or Ctrl modifiers
+static thread_local Terminal* thisTerminal = nullptr;	// terminal sequence is read from
 
 // This dispatch routine is given a dispatch table and then farms work out to
 // routines
@@ -100,7 +102,7 @@ static char32_t ctrlLeftArrowKeyRoutine(char32_t) {
 	return thisKeyMetaCtrl | CTRL | LEFT_ARROW_KEY;
 }
 static char32_t escFailureRoutine(char32_t) {
-	beep();
+	thisTerminal->beep();
 	return -1;
 }
 
@@ -115,13 +117,13 @@ static CharacterDispatch escLeftBracket1Semicolon3or5Dispatch = {
 // Handle ESC [ 1 ; <more stuff> escape sequences
 //
 static char32_t escLeftBracket1Semicolon3Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	thisKeyMetaCtrl |= META;
 	return doDispatch(c, escLeftBracket1Semicolon3or5Dispatch);
 }
 static char32_t escLeftBracket1Semicolon5Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	thisKeyMetaCtrl |= CTRL;
 	return doDispatch(c, escLeftBracket1Semicolon3or5Dispatch);
@@ -135,7 +137,7 @@ static CharacterDispatch escLeftBracket1SemicolonDispatch = {
 // Handle ESC [ 1 <more stuff> escape sequences
 //
 static char32_t escLeftBracket1SemicolonRoutine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket1SemicolonDispatch);
 }
@@ -193,7 +195,7 @@ static char32_t escLeftBracket0Routine(char32_t c) {
 	return escFailureRoutine(c);
 }
 static char32_t escLeftBracket1Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket1Dispatch);
 }
@@ -201,32 +203,32 @@ static char32_t escLeftBracket2Routine(char32_t c) {
 	return escFailureRoutine(c);	// Insert key, unused
 }
 static char32_t escLeftBracket3Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket3Dispatch);
 }
 static char32_t escLeftBracket4Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket4Dispatch);
 }
 static char32_t escLeftBracket5Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket5Dispatch);
 }
 static char32_t escLeftBracket6Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket6Dispatch);
 }
 static char32_t escLeftBracket7Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket7Dispatch);
 }
 static char32_t escLeftBracket8Routine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracket8Dispatch);
 }
@@ -259,12 +261,12 @@ static CharacterDispatch escODispatch = {10, "ABCDHFabcd", escORoutines};
 // sequence
 //
 static char32_t escLeftBracketRoutine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escLeftBracketDispatch);
 }
 static char32_t escORoutine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escODispatch);
 }
@@ -276,7 +278,7 @@ static CharacterDispatch escDispatch = {2, "[O", escRoutines};
 // Initial dispatch -- we are not in the middle of anything yet
 //
 static char32_t escRoutine(char32_t c) {
-	c = readUnicodeCharacter();
+	c = thisTerminal->readUnicodeCharacter();
 	if (c == 0) return 0;
 	return doDispatch(c, escDispatch);
 }
@@ -289,15 +291,16 @@ static CharacterDispatch initialDispatch = {2, "\x1B\x7F", initialRoutines};
 static char32_t setMetaRoutine(char32_t c) {
 	thisKeyMetaCtrl = META;
 	if (c == 0x1B) {	// another ESC, stay in ESC processing mode
-		c = readUnicodeCharacter();
+		c = thisTerminal->readUnicodeCharacter();
 		if (c == 0) return 0;
 		return doDispatch(c, escDispatch);
 	}
 	return doDispatch(c, initialDispatch);
 }
 
-char32_t doDispatch(char32_t c) {
+char32_t doDispatch(Terminal& terminal_, char32_t c) {
 	EscapeSequenceProcessing::thisKeyMetaCtrl = 0;	// no modifiers yet at initialDispatch
+	EscapeSequenceProcessing::thisTerminal = &terminal_;
 	return doDispatch(c, initialDispatch);
 }
 
@@ -15,6 +15,10 @@ using namespace std;
 namespace replxx {
 
 static int const REPLXX_DEFAULT_HISTORY_MAX_LEN( 1000 );
+/*
+ * Number of history entries after which token score drops by half.
+ */
+static double const REPLXX_TOKEN_RECENCY_SCALE( 32.0 );
 
 History::History( void )
 	: _data()
@@ -22,12 +26,23 @@ History::History( void )
 	, _maxLineLength( 0 )
 	, _index( 0 )
 	, _previousIndex( -2 )
-	, _recallMostRecent( false ) {
+	, _recallMostRecent( false )
+	, _lastIsTemporary( false )
+	, _tokenStats()
+	, _tokenClock( 0 )
+	, _breakChars() {
 }
 
-void History::add( std::string const& line ) {
-	if ( ( _maxSize > 0 ) && ( _data.empty() || ( line != _data.back() ) ) ) {
+/*
+ * Temporary entry holding line being edited is added even if it repeats
+ * previous line, it is edited in place and removed with drop_last().
+ */
+void History::add( std::string const& line, bool temporary_ ) {
+	if ( ( _maxSize > 0 ) && ( temporary_ || _data.empty() || ( line != _data.back() ) ) ) {
 		if ( size() > _maxSize ) {
+			if ( ! ( _lastIsTemporary && ( size() == 1 ) ) ) {
+				learn( _data.front(), -1 );
+			}
 			_data.erase( _data.begin() );
 			if ( -- _previousIndex < -1 ) {
 				_previousIndex = -2;
@@ -37,7 +52,65 @@ void History::add( std::string const& line ) {
 			_maxLineLength = static_cast<int>( line.length() );
 		}
 		_data.push_back( line );
+		_lastIsTemporary = temporary_;
+		if ( ! temporary_ ) {
+			++ _tokenClock;
+			learn( line, 1 );
+		}
+	}
+}
+
+void History::drop_last( void ) {
+	if ( ! _lastIsTemporary ) {
+		return;
 	}
+	_data.pop_back();
+	_lastIsTemporary = false;
+}
+
+/*
+ * Update token frequency table with all words from given line.
+ */
+void History::learn( std::string const& line_, int delta_ ) {
+	std::string::size_type start( line_.find_first_not_of( _breakChars ) );
+	while ( start != std::string::npos ) {
+		std::string::size_type end( line_.find_first_of( _breakChars, start ) );
+		std::string token( line_, start, end != std::string::npos ? end - start : std::string::npos );
+		if ( delta_ > 0 ) {
+			TokenStats& ts( _tokenStats[token] );
+			ts.count += delta_;
+			ts.lastUse = _tokenClock;
+		} else {
+			token_stats_t::iterator it( _tokenStats.find( token ) );
+			if ( ( it != _tokenStats.end() ) && ( ( it->second.count += delta_ ) <= 0 ) ) {
+				_tokenStats.erase( it );
+			}
+		}
+		start = end != std::string::npos ? line_.find_first_not_of( _breakChars, end ) : end;
+	}
+}
+
+void History::set_word_break_characters( char const* breakChars_ ) {
+	_breakChars.assign( breakChars_ );
+	_tokenStats.clear();
+	_tokenClock = 0;
+	for ( int i( 0 ), count( size() - ( _lastIsTemporary ? 1 : 0 ) ); i < count; ++ i ) {
+		++ _tokenClock;
+		learn( _data[i], 1 );
+	}
+}
+
+/*
+ * Frequency of given token in history decayed by the number of history
+ * entries added since the token was last used.
+ */
+double History::token_score( std::string const& token_ ) const {
+	token_stats_t::const_iterator it( _tokenStats.find( token_ ) );
+	if ( it == _tokenStats.end() ) {
+		return ( 0.0 );
+	}
+	int age( _tokenClock - it->second.lastUse );
+	return ( it->second.count * REPLXX_TOKEN_RECENCY_SCALE / ( REPLXX_TOKEN_RECENCY_SCALE + age ) );
 }
 
 int History::save( std::string const& filename ) {
@@ -83,6 +156,11 @@ void History::set_max_size( int size_ ) {
 		_maxSize = size_;
 		int curSize( size() );
 		if ( _maxSize < curSize ) {
+			for ( int i( 0 ); i < ( curSize - _maxSize ); ++ i ) {
+				if ( ! ( _lastIsTemporary && ( i == ( curSize - 1 ) ) ) ) {
+					learn( _data[i], -1 );
+				}
+			}
 			_data.erase( _data.begin(), _data.begin() + ( curSize - _maxSize ) );
 		}
 	}
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 #include "conversion.hxx"
 
@@ -12,15 +13,24 @@ class History {
 public:
 	typedef std::vector<std::string> lines_t;
 private:
+	struct TokenStats {
+		int count;   // number of occurrences in history
+		int lastUse; // value of _tokenClock when token was last seen
+	};
+	typedef std::unordered_map<std::string, TokenStats> token_stats_t;
 	lines_t _data;
 	int _maxSize;
 	int _maxLineLength;
 	int _index;
 	int _previousIndex;
 	bool _recallMostRecent;
+	bool _lastIsTemporary; // last entry holds line being edited
+	token_stats_t _tokenStats;
+	int _tokenClock;
+	std::string _breakChars;
 public:
 	History( void );
-	void add( std::string const& line );
+	void add( std::string const& line, bool temporary = false );
 	int save( std::string const& filename );
 	int load( std::string const& filename );
 	void set_max_size( int len );
@@ -32,9 +42,7 @@ public:
 	void reset_recall_most_recent( void ) {
 		_recallMostRecent = false;
 	}
-	void drop_last( void ) {
-		_data.pop_back();
-	}
+	void drop_last( void );
 	void commit_index( void ) {
 		_previousIndex = _recallMostRecent ? _index : -2;
 	}
@@ -62,7 +70,10 @@ public:
 	int max_line_length( void ) {
 		return ( _maxLineLength );
 	}
+	void set_word_break_characters( char const* );
+	double token_score( std::string const& ) const;
 private:
+	void learn( std::string const&, int );
 	History( History const& ) = delete;
 	History& operator = ( History const& ) = delete;
 };
@@ -1,6 +1,11 @@
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
 #include <cerrno>
 #include <cstdlib>
+#include <stdexcept>
 
 #ifdef _WIN32
 
@@ -19,6 +24,8 @@
 
 #include <unistd.h>
 #include <termios.h>
+#include <poll.h>
+#include <signal.h>
 #include <sys/ioctl.h>
 
 #endif /* _WIN32 */
@@ -32,23 +39,33 @@ using namespace std;
 
 namespace replxx {
 
-#ifdef _WIN32
-HANDLE console_out;
-static HANDLE console_in;
-static DWORD oldMode;
-static WORD oldDisplayAttribute;
-static UINT const inputCodePage( GetConsoleCP() );
-static UINT const outputCodePage( GetConsoleOutputCP() );
-#else
-static struct termios orig_termios; /* in order to restore at exit */
-#endif
+#ifndef _WIN32
 
-static int rawmode = 0; /* for atexit() function to check if restore is needed*/
-static int atexit_registered = 0; /* register atexit just 1 time */
-// At exit we'll try to fix the terminal to the initial conditions
-static void repl_at_exit(void) { disableRawMode(); }
+namespace {
 
-namespace tty {
+/*
+ * Window size changes seen by the SIGWINCH handler, each Terminal
+ * remembers how many of them it already handled.
+ */
+volatile sig_atomic_t resizeCount( 0 );
+
+void window_size_changed( int ) {
+	resizeCount = resizeCount + 1;
+}
+
+/*
+ * Terminals in raw mode, their original mode is restored
+ * at exit if their owners did not do it.
+ */
+std::mutex rawModeMutex;
+std::vector<Terminal*> rawModeTerminals;
+bool atexitRegistered( false );
+
+}
+
+#endif
+
+namespace {
 
 bool is_a_tty( int fd_ ) {
 	bool aTTY( isatty( fd_ ) != 0 );
@@ -71,91 +88,145 @@ bool is_a_tty( int fd_ ) {
 	return ( aTTY );
 }
 
-bool in( is_a_tty( 0 ) );
-bool out( is_a_tty( 1 ) );
 
+/*
+ * Accumulate time spent in enclosing scope.
+ */
+class IOTimer {
+	long long& _total;
+	std::chrono::steady_clock::time_point _start;
+public:
+	IOTimer( long long& total_ )
+		: _total( total_ )
+		, _start( std::chrono::steady_clock::now() ) {
+	}
+	~IOTimer( void ) {
+		_total += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _start ).count();
+	}
+};
+
+}
+
+Terminal::Terminal( int in_, int out_, int err_ )
+	: _in( in_ )
+	, _out( out_ )
+	, _err( err_ )
+	, _inTTY( is_a_tty( in_ ) )
+	, _outTTY( is_a_tty( out_ ) )
+#ifdef _WIN32
+	, _consoleIn( 0 )
+	, _consoleOut( 0 )
+	, _oldMode( 0 )
+	, _inputCodePage( GetConsoleCP() )
+	, _outputCodePage( GetConsoleOutputCP() )
+	, _rawMode( false )
+#else
+	, _origTermios()
+	, _utf8String()
+	, _utf8Count( 0 )
+	, _resizeCount( resizeCount )
+	, _rawMode( false )
+#endif
+	, _text8()
+	, _counters{ 0, 0, 0, 0 }
+	, _bellBytes( 0 ) {
+}
+
+Terminal::~Terminal( void ) {
+	disableRawMode();
 }
 
-void write32( char32_t const* text32, int len32 ) {
+void Terminal::write32( char32_t const* text32, int len32 ) {
+	IOTimer t( _counters.writeTime );
 	int len8 = 4 * len32 + 1;
-	unique_ptr<char[]> text8(new char[len8]);
+	vector<char>& text8( _text8 );
+	if ( static_cast<int>( text8.size() ) < len8 ) {
+		text8.resize( len8 );
+	}
 	int count8 = 0;
 
-	copyString32to8(text8.get(), len8, text32, len32, &count8);
+	copyString32to8(text8.data(), len8, text32, len32, &count8);
 	int nWritten( 0 );
 #ifdef _WIN32
-	nWritten = win_write( text8.get(), count8 );
+	nWritten = win_write( _out, _outTTY, text8.data(), count8 );
 #else
-	nWritten = write( 1, text8.get(), count8 );
+	nWritten = write( _out, text8.data(), count8 );
 #endif
+	++ _counters.writeCalls;
+	_counters.bytesWritten += count8;
 	if ( nWritten != count8 ) {
 		throw std::runtime_error( "write failed" );
 	}
 	return;
 }
 
-void write8( void const* data_, int size_ ) {
-	if ( write( 1, data_, size_ ) != size_ ) {
+void Terminal::write8( void const* data_, int size_ ) {
+	IOTimer t( _counters.writeTime );
+	++ _counters.writeCalls;
+	_counters.bytesWritten += size_;
+#ifdef _WIN32
+	int nWritten( win_write( _out, _outTTY, static_cast<char const*>( data_ ), size_ ) );
+#else
+	int nWritten( static_cast<int>( write( _out, data_, size_ ) ) );
+#endif
+	if ( nWritten != size_ ) {
 		throw std::runtime_error( "write failed" );
 	}
 	return;
 }
 
-int getScreenColumns(void) {
+int Terminal::screen_columns( void ) const {
 	int cols;
 #ifdef _WIN32
 	CONSOLE_SCREEN_BUFFER_INFO inf;
-	GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &inf);
+	GetConsoleScreenBufferInfo( reinterpret_cast<HANDLE>( _get_osfhandle( _out ) ), &inf );
 	cols = inf.dwSize.X;
 #else
 	struct winsize ws;
-	cols = (ioctl(1, TIOCGWINSZ, &ws) == -1) ? 80 : ws.ws_col;
+	cols = (ioctl(_out, TIOCGWINSZ, &ws) == -1) ? 80 : ws.ws_col;
 #endif
 	// cols is 0 in certain circumstances like inside debugger, which creates
 	// further issues
 	return (cols > 0) ? cols : 80;
 }
 
-int getScreenRows(void) {
+int Terminal::screen_rows( void ) const {
 	int rows;
 #ifdef _WIN32
 	CONSOLE_SCREEN_BUFFER_INFO inf;
-	GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &inf);
+	GetConsoleScreenBufferInfo( reinterpret_cast<HANDLE>( _get_osfhandle( _out ) ), &inf );
 	rows = 1 + inf.srWindow.Bottom - inf.srWindow.Top;
 #else
 	struct winsize ws;
-	rows = (ioctl(1, TIOCGWINSZ, &ws) == -1) ? 24 : ws.ws_row;
+	rows = (ioctl(_out, TIOCGWINSZ, &ws) == -1) ? 24 : ws.ws_row;
 #endif
 	return (rows > 0) ? rows : 24;
 }
 
-int enableRawMode(void) {
+int Terminal::enableRawMode(void) {
 #ifdef _WIN32
-	if ( ! console_in ) {
-		console_in = GetStdHandle( STD_INPUT_HANDLE );
-		console_out = GetStdHandle( STD_OUTPUT_HANDLE );
+	if ( ! _consoleIn ) {
+		_consoleIn = reinterpret_cast<HANDLE>( _get_osfhandle( _in ) );
+		_consoleOut = reinterpret_cast<HANDLE>( _get_osfhandle( _out ) );
 		SetConsoleCP( 65001 );
 		SetConsoleOutputCP( 65001 );
-		GetConsoleMode( console_in, &oldMode );
+		GetConsoleMode( _consoleIn, &_oldMode );
 		SetConsoleMode(
-			console_in,
-			oldMode & ~( ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT | ENABLE_PROCESSED_INPUT )
+			_consoleIn,
+			_oldMode & ~( ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT | ENABLE_PROCESSED_INPUT )
 		);
+		_rawMode = true;
 	}
 	return 0;
 #else
 	struct termios raw;
 
-	if ( ! tty::in ) {
+	if ( ! _inTTY ) {
 		goto fatal;
 	}
-	if (!atexit_registered) {
-		atexit(repl_at_exit);
-		atexit_registered = 1;
-	}
-	if (tcgetattr(0, &orig_termios) == -1) goto fatal;
+	if (tcgetattr(_in, &_origTermios) == -1) goto fatal;
 
-	raw = orig_termios; /* modify the original mode */
+	raw = _origTermios; /* modify the original mode */
 	/* input modes: no break, no CR to NL, no parity check, no strip char,
 	 * no start/stop output control. */
 	raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
@@ -174,8 +245,16 @@ int enableRawMode(void) {
 	raw.c_cc[VTIME] = 0; /* 1 byte, no timer */
 
 	/* put terminal in raw mode after flushing */
-	if (tcsetattr(0, TCSADRAIN, &raw) < 0) goto fatal;
-	rawmode = 1;
+	if (tcsetattr(_in, TCSADRAIN, &raw) < 0) goto fatal;
+	if ( ! _rawMode ) {
+		std::lock_guard<std::mutex> l( rawModeMutex );
+		if ( ! atexitRegistered ) {
+			atexit( &Terminal::restore_at_exit );
+			atexitRegistered = true;
+		}
+		rawModeTerminals.push_back( this );
+	}
+	_rawMode = true;
 	return 0;
 
 fatal:
@@ -184,24 +263,44 @@ fatal:
 #endif
 }
 
-void disableRawMode(void) {
+void Terminal::disableRawMode(void) {
 #ifdef _WIN32
-	if ( console_in ) {
-		SetConsoleMode(console_in, oldMode);
-		SetConsoleCP( inputCodePage );
-		SetConsoleOutputCP( outputCodePage );
-		console_in = 0;
-		console_out = 0;
+	if ( _consoleIn ) {
+		SetConsoleMode(_consoleIn, _oldMode);
+		SetConsoleCP( _inputCodePage );
+		SetConsoleOutputCP( _outputCodePage );
+		_consoleIn = 0;
+		_consoleOut = 0;
+		_rawMode = false;
 	}
 #else
-	if ( rawmode && tcsetattr(0, TCSADRAIN, &orig_termios ) != -1 ) {
-		rawmode = 0;
+	if ( _rawMode && tcsetattr(_in, TCSADRAIN, &_origTermios ) != -1 ) {
+		_rawMode = false;
+		std::lock_guard<std::mutex> l( rawModeMutex );
+		rawModeTerminals.erase( std::find( rawModeTerminals.begin(), rawModeTerminals.end(), this ) );
 	}
 #endif
 }
 
 #ifndef _WIN32
 
+/*
+ * At exit we'll try to fix the terminal to the initial conditions,
+ * terminals that entered raw mode first are restored last.
+ */
+void Terminal::restore_at_exit( void ) {
+	std::lock_guard<std::mutex> l( rawModeMutex );
+	for ( std::vector<Terminal*>::reverse_iterator it( rawModeTerminals.rbegin() ); it != rawModeTerminals.rend(); ++ it ) {
+		tcsetattr( (*it)->_in, TCSADRAIN, &(*it)->_origTermios );
+		(*it)->_rawMode = false;
+	}
+	rawModeTerminals.clear();
+}
+
+#endif
+
+#ifndef _WIN32
+
 /**
  * Read a UTF-8 sequence from the non-Windows keyboard and return the Unicode
  * (char32_t) character it
@@ -209,23 +308,24 @@ void disableRawMode(void) {
  *
  * @return	char32_t Unicode character
  */
-char32_t readUnicodeCharacter(void) {
-	static char8_t utf8String[5];
-	static size_t utf8Count = 0;
+char32_t Terminal::readUnicodeCharacter(void) {
+	char8_t* utf8String( _utf8String );
+	int& utf8Count( _utf8Count );
 	while (true) {
 		char8_t c;
 
 		/* Continue reading if interrupted by signal. */
 		ssize_t nread;
 		do {
-			nread = read(0, &c, 1);
+			IOTimer t( _counters.readTime );
+			nread = read(_in, &c, 1);
 		} while ((nread == -1) && (errno == EINTR));
 
 		if (nread <= 0) return 0;
 		if (c <= 0x7F || locale::is8BitEncoding) {	// short circuit ASCII
 			utf8Count = 0;
 			return c;
-		} else if (utf8Count < sizeof(utf8String) - 1) {
+		} else if (utf8Count < static_cast<int>( sizeof(_utf8String) ) - 1) {
 			utf8String[utf8Count++] = c;
 			utf8String[utf8Count] = 0;
 			char32_t unicodeChar[2];
@@ -243,9 +343,43 @@ char32_t readUnicodeCharacter(void) {
 
 #endif	// #ifndef _WIN32
 
-void beep() {
-	fprintf(stderr, "\x7");	// ctrl-G == bell/beep
-	fflush(stderr);
+void Terminal::beep() {
+	IOTimer t( _counters.writeTime );
+	++ _counters.writeCalls;
+	++ _counters.bytesWritten;
+	++ _bellBytes;
+	static_cast<void>( write( _err, "\x7", 1 ) ); // ctrl-G == bell/beep
+}
+
+/*
+ * Wait at most timeoutMs_ milliseconds for user input,
+ * return true if read_char() would not block.
+ */
+bool Terminal::wait_for_input( int timeoutMs_ ) {
+#ifdef _WIN32
+	return ( WaitForSingleObject( _consoleIn, static_cast<DWORD>( timeoutMs_ ) ) == WAIT_OBJECT_0 );
+#else
+	typedef std::chrono::steady_clock clock_t;
+	clock_t::time_point deadline( clock_t::now() + std::chrono::milliseconds( timeoutMs_ ) );
+	pollfd fd{ _in, POLLIN, 0 };
+	int timeout( timeoutMs_ );
+	while ( true ) {
+		int ready( poll( &fd, 1, timeout ) );
+		if ( ready >= 0 ) {
+			return ( ready > 0 );
+		}
+		if ( errno != EINTR ) {
+			return ( false );
+		}
+		/* interrupted by a signal, e.g. SIGWINCH, wait for the rest of the time */
+		if ( timeoutMs_ >= 0 ) {
+			timeout = static_cast<int>( std::chrono::duration_cast<std::chrono::milliseconds>( deadline - clock_t::now() ).count() );
+			if ( timeout < 0 ) {
+				timeout = 0;
+			}
+		}
+	}
+#endif
 }
 
 // replxx_read_char -- read a keystroke or keychord from the keyboard, and
@@ -257,7 +391,7 @@ void beep() {
 // A return value of zero means "no input available", and a return value of -1
 // means "invalid key".
 //
-char32_t read_char(void) {
+char32_t Terminal::read_char(void) {
 #ifdef _WIN32
 
 	INPUT_RECORD rec;
@@ -266,7 +400,10 @@ char32_t read_char(void) {
 	bool escSeen = false;
 	int highSurrogate( 0 );
 	while (true) {
-		ReadConsoleInputW(console_in, &rec, 1, &count);
+		{
+			IOTimer t( _counters.readTime );
+			ReadConsoleInputW(_consoleIn, &rec, 1, &count);
+		}
 #if __REPLXX_DEBUG__	// helper for debugging keystrokes, display info in the debug "Output"
 			 // window in the debugger
 				{
@@ -395,7 +532,7 @@ char32_t read_char(void) {
 				"this mode\n");
 		while (true) {
 			unsigned char keys[10];
-			int ret = read(0, keys, 10);
+			int ret = read(_in, keys, 10);
 
 			if (ret <= 0) {
 				printf("\nret: %d\n", ret);
@@ -440,18 +577,18 @@ char32_t read_char(void) {
 	}
 #endif	// __REPLXX_DEBUG__
 
-	return EscapeSequenceProcessing::doDispatch(c);
+	return EscapeSequenceProcessing::doDispatch( *this, c );
 #endif	// #_WIN32
 }
 
 /**
  * Clear the screen ONLY (no redisplay of anything)
  */
-void clear_screen( CLEAR_SCREEN clearScreen_ ) {
+void Terminal::clear_screen( CLEAR_SCREEN clearScreen_ ) {
 #ifdef _WIN32
 	COORD coord = {0, 0};
 	CONSOLE_SCREEN_BUFFER_INFO inf;
-	HANDLE screenHandle = GetStdHandle( STD_OUTPUT_HANDLE );
+	HANDLE screenHandle( reinterpret_cast<HANDLE>( _get_osfhandle( _out ) ) );
 	bool toEnd( clearScreen_ == CLEAR_SCREEN::TO_END );
 	GetConsoleScreenBufferInfo( screenHandle, &inf );
 	if ( ! toEnd ) {
@@ -467,12 +604,40 @@ void clear_screen( CLEAR_SCREEN clearScreen_ ) {
 #else
 	if ( clearScreen_ == CLEAR_SCREEN::WHOLE ) {
 		char const clearCode[] = "\033c\033[H\033[2J\033[0m";
-		static_cast<void>( write(1, clearCode, sizeof ( clearCode ) - 1) >= 0 );
+		write8( clearCode, sizeof ( clearCode ) - 1 );
 	} else {
 		char const clearCode[] = "\033[J";
-		static_cast<void>( write(1, clearCode, sizeof ( clearCode ) - 1) >= 0 );
+		write8( clearCode, sizeof ( clearCode ) - 1 );
+	}
+#endif
+}
+
+int Terminal::install_window_change_handler( void ) {
+#ifndef _WIN32
+	struct sigaction sa;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sa.sa_handler = &window_size_changed;
+
+	if (sigaction(SIGWINCH, &sa, nullptr) == -1) {
+		return errno;
+	}
+#endif
+	return 0;
+}
+
+/*
+ * Tell if window size changed since previous call.
+ */
+bool Terminal::got_resize( void ) {
+#ifndef _WIN32
+	int count( resizeCount );
+	if ( count != _resizeCount ) {
+		_resizeCount = count;
+		return ( true );
 	}
 #endif
+	return ( false );
 }
 
 }
@@ -1,37 +1,106 @@
 #ifndef REPLXX_IO_HXX_INCLUDED
 #define REPLXX_IO_HXX_INCLUDED 1
 
+#include <vector>
+
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <termios.h>
 #endif
 
 namespace replxx {
 
-void write32( char32_t const*, int );
-void write8( void const*, int );
-int getScreenColumns(void);
-int getScreenRows(void);
-int enableRawMode(void);
-void disableRawMode(void);
-char32_t readUnicodeCharacter(void);
-void beep();
-char32_t read_char(void);
+/*
+ * Terminal I/O counters, times are in nanoseconds.
+ */
+struct IOCounters {
+	long long readTime;
+	long long writeTime;
+	long long bytesWritten;
+	long long writeCalls;
+};
+
 enum class CLEAR_SCREEN {
 	WHOLE,
 	TO_END
 };
-void clear_screen( CLEAR_SCREEN );
-
-namespace tty {
-
-extern bool in;
-extern bool out;
-
-}
 
+/*
+ * Terminal as seen by one Replxx instance.
+ *
+ * Descriptors the instance reads from and writes to, saved terminal mode,
+ * state of partially read UTF-8 sequence, window size changes not yet handled
+ * and I/O counters are kept per instance so that instances do not disturb each other.
+ */
+class Terminal {
+	int _in;
+	int _out;
+	int _err;
+	bool _inTTY;
+	bool _outTTY;
+#ifdef _WIN32
+	HANDLE _consoleIn;
+	HANDLE _consoleOut;
+	DWORD _oldMode;
+	UINT _inputCodePage;
+	UINT _outputCodePage;
+#else
+	struct termios _origTermios; // in order to restore it in disableRawMode()
+	char unsigned _utf8String[5];
+	int _utf8Count;
+	int _resizeCount;            // window size changes already handled
+#endif
+	bool _rawMode;
+	std::vector<char> _text8;    // write32() conversion buffer, kept so that steady state editing does not allocate
+	IOCounters _counters;
+	long long _bellBytes;        // part of bytesWritten that did not change the screen
+public:
+	Terminal( int, int, int );
+	~Terminal( void );
+	void write32( char32_t const*, int );
+	void write8( void const*, int );
+	int enableRawMode( void );
+	void disableRawMode( void );
+	char32_t readUnicodeCharacter( void );
+	void beep( void );
+	char32_t read_char( void );
+	bool wait_for_input( int );
+	void clear_screen( CLEAR_SCREEN );
+	int install_window_change_handler( void );
+	bool got_resize( void );
+	int screen_columns( void ) const;
+	int screen_rows( void ) const;
+	int input_fd( void ) const {
+		return ( _in );
+	}
+	bool input_is_tty( void ) const {
+		return ( _inTTY );
+	}
+	bool output_is_tty( void ) const {
+		return ( _outTTY );
+	}
+	IOCounters const& counters( void ) const {
+		return ( _counters );
+	}
+	/*
+	 * Bytes written so far that could have changed the screen.
+	 */
+	long long screen_bytes( void ) const {
+		return ( _counters.bytesWritten - _bellBytes );
+	}
 #ifdef _WIN32
-extern HANDLE console_out;
+	HANDLE console_out( void ) const {
+		return ( _consoleOut );
+	}
 #endif
+private:
+#ifndef _WIN32
+	static void restore_at_exit( void );
+#endif
+	Terminal( Terminal const& ) = delete;
+	Terminal& operator = ( Terminal const& ) = delete;
+};
 
 }
 
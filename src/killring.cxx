@@ -0,0 +1,71 @@
+#include "killring.hxx"
+
+namespace replxx {
+
+int const KillRing::DEFAULT_CAPACITY;
+int const KillRing::DEFAULT_MAX_CHARS;
+
+KillRing::KillRing( void )
+	: _entries()
+	, _index( 0 )
+	, _capacity( DEFAULT_CAPACITY )
+	, _maxChars( DEFAULT_MAX_CHARS )
+	, _chars( 0 )
+	, lastAction( actionOther )
+	, lastYankSize( 0 ) {
+}
+
+void KillRing::set_limits( int capacity_, int maxChars_ ) {
+	_capacity = capacity_ > 0 ? capacity_ : 1;
+	_maxChars = maxChars_;
+	trim();
+}
+
+void KillRing::kill( char32_t const* text_, int len_, bool forward_ ) {
+	if ( len_ == 0 ) {
+		return;
+	}
+	if ( ( lastAction == actionKill ) && ! _entries.empty() ) {
+		entry_t& entry( _entries.front() );
+		entry.insert( forward_ ? entry.end() : entry.begin(), text_, text_ + len_ );
+	} else {
+		_entries.emplace_front( text_, text_ + len_ );
+		_index = 0;
+	}
+	_chars += len_;
+	trim();
+}
+
+void KillRing::trim( void ) {
+	while (
+		( _entries.size() > 1 )
+		&& (
+			( static_cast<int>( _entries.size() ) > _capacity )
+			|| ( ( _maxChars > 0 ) && ( _chars > _maxChars ) )
+		)
+	) {
+		_chars -= static_cast<long long>( _entries.back().size() );
+		_entries.pop_back();
+	}
+	if ( _index >= static_cast<int>( _entries.size() ) ) {
+		_index = 0;
+	}
+}
+
+KillRing::entry_t const* KillRing::yank( void ) {
+	return ( ! _entries.empty() ? &_entries[_index] : nullptr );
+}
+
+KillRing::entry_t const* KillRing::yankPop( void ) {
+	if ( _entries.empty() ) {
+		return ( nullptr );
+	}
+	++ _index;
+	if ( _index == static_cast<int>( _entries.size() ) ) {
+		_index = 0;
+	}
+	return ( &_entries[_index] );
+}
+
+}
+
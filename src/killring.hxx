@@ -1,73 +1,43 @@
 #ifndef REPLXX_KILLRING_HXX_INCLUDED
 #define REPLXX_KILLRING_HXX_INCLUDED 1
 
-#include <vector>
-
-#include "unicodestring.hxx"
+#include <deque>
 
 namespace replxx {
 
+/*
+ * Killed text, most recent entry first. Consecutive kills accumulate
+ * in the most recent entry, each entry is a deque so that both appending
+ * and prepending cost only the length of text killed.
+ * Oldest entries are dropped when there are more than `capacity` entries
+ * or when all entries together hold more than `maxChars` characters,
+ * the most recent entry is always kept.
+ */
 class KillRing {
-	static const int capacity = 10;
-	int size;
-	int index;
-	char indexToSlot[10];
-	std::vector<UnicodeString> theRing;
-
 public:
+	typedef std::deque<char32_t> entry_t;
+	static int const DEFAULT_CAPACITY = 10;
+	static int const DEFAULT_MAX_CHARS = 1024 * 1024;
 	enum action { actionOther, actionKill, actionYank };
+private:
+	std::deque<entry_t> _entries;
+	int _index;    // entry yanked last
+	int _capacity;
+	int _maxChars; // no limit if not positive
+	long long _chars;
+public:
 	action lastAction;
-	size_t lastYankSize;
-
-	KillRing() : size(0), index(0), lastAction(actionOther) {
-		theRing.reserve(capacity);
-	}
-
-	void kill(const char32_t* text, int textLen, bool forward) {
-		if (textLen == 0) {
-			return;
-		}
-		UnicodeString killedText(text, textLen);
-		if (lastAction == actionKill && size > 0) {
-			int slot = indexToSlot[0];
-			int currentLen = static_cast<int>(theRing[slot].length());
-			UnicodeString temp;
-			if ( forward ) {
-				temp.append( theRing[slot].get(), currentLen ).append( killedText.get(), textLen );
-			} else {
-				temp.append( killedText.get(), textLen ).append( theRing[slot].get(), currentLen );
-			}
-			theRing[slot] = temp;
-		} else {
-			if (size < capacity) {
-				if (size > 0) {
-					memmove(&indexToSlot[1], &indexToSlot[0], size);
-				}
-				indexToSlot[0] = size;
-				size++;
-				theRing.push_back(killedText);
-			} else {
-				int slot = indexToSlot[capacity - 1];
-				theRing[slot] = killedText;
-				memmove(&indexToSlot[1], &indexToSlot[0], capacity - 1);
-				indexToSlot[0] = slot;
-			}
-			index = 0;
-		}
-	}
-
-	UnicodeString* yank() { return (size > 0) ? &theRing[indexToSlot[index]] : 0; }
-
-	UnicodeString* yankPop() {
-		if (size == 0) {
-			return 0;
-		}
-		++index;
-		if (index == size) {
-			index = 0;
-		}
-		return &theRing[indexToSlot[index]];
-	}
+	int lastYankSize;
+
+	KillRing( void );
+	void set_limits( int, int );
+	void kill( char32_t const*, int, bool );
+	entry_t const* yank( void );
+	entry_t const* yankPop( void );
+private:
+	void trim( void );
+	KillRing( KillRing const& ) = delete;
+	KillRing& operator = ( KillRing const& ) = delete;
 };
 
 }
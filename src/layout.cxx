@@ -0,0 +1,174 @@
+#include <algorithm>
+
+#include "layout.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+int mk_wcwidth( char32_t );
+
+namespace {
+
+inline int char_width( char32_t c ) {
+	int w( mk_wcwidth( c ) );
+	// control characters are written as they are, count them as single column
+	return ( w >= 0 ? w : 1 );
+}
+
+}
+
+Layout::Layout( void )
+	: _columns()
+	, _lines()
+	, _indent( -1 )
+	, _screenColumns( -1 ) {
+}
+
+void Layout::clear( void ) {
+	_columns.assign( 1, _indent );
+	_lines.assign( 1, Line{ 0, 0, 0, 1 } );
+	if ( _screenColumns > 0 ) {
+		_lines.front().rows = _indent / _screenColumns + 1;
+	}
+}
+
+/*
+ * Set prompt width and screen width the layout is made for,
+ * a change of either lays out whole `text_` again.
+ */
+void Layout::update( char32_t const* text_, int len_, int indent_, int screenColumns_ ) {
+	if ( ( indent_ == _indent ) && ( screenColumns_ == _screenColumns ) ) {
+		return;
+	}
+	_indent = indent_;
+	_screenColumns = screenColumns_ > 0 ? screenColumns_ : 1;
+	clear();
+	changed( text_, len_, 0, 0, len_ );
+}
+
+/*
+ * `removedLen_` characters at `pos_` were replaced with `insertedLen_`
+ * characters, `text_` is the whole input after the edit.
+ * Nothing is laid out until the first update().
+ */
+void Layout::changed( char32_t const* text_, int len_, int pos_, int removedLen_, int insertedLen_ ) {
+	if ( ( _screenColumns <= 0 ) || ( ( removedLen_ == 0 ) && ( insertedLen_ == 0 ) ) ) {
+		return;
+	}
+	int oldLen( len_ - insertedLen_ + removedLen_ );
+	int prefix( pos_ );
+	int suffix( oldLen - pos_ - removedLen_ );
+	// lines whose terminating '\n' and all characters lie in unchanged prefix or suffix are kept
+	int first( line_of( prefix ) );
+	int kept( first + 1 );
+	int lineCount( static_cast<int>( _lines.size() ) );
+	while ( ( kept < lineCount ) && ( _lines[kept].start <= ( oldLen - suffix ) ) ) {
+		++ kept;
+	}
+	int delta( len_ - oldLen );
+	int from( _lines[first].start );
+	int newTo( kept < lineCount ? _lines[kept].start + delta : len_ + 1 );
+	int oldRowsEnd( kept < lineCount ? _lines[kept].row : _lines.back().row + _lines.back().rows );
+
+	// column of first changed character and of first character of unchanged suffix, as laid out before
+	int prefixColumn( _columns[prefix] );
+	int suffixColumn( _columns[oldLen - suffix] );
+	_columns.erase( _columns.begin() + prefix, _columns.begin() + ( oldLen - suffix ) );
+	_columns.insert( _columns.begin() + prefix, len_ - suffix - prefix, 0 );
+	_lines.erase( _lines.begin() + first, _lines.begin() + kept );
+
+	/*
+	 * Only characters of the changed part are measured, unchanged suffix
+	 * within the last touched line has no '\n' and keeps its widths,
+	 * its columns are shifted.
+	 */
+	int row( first > 0 ? _lines[first - 1].row + _lines[first - 1].rows : 0 );
+	int lineNo( first );
+	int lineStart( from );
+	int changedEnd( len_ - suffix );
+	int end( newTo - 1 );
+	int col( prefixColumn );
+	int i( prefix );
+	while ( true ) {
+		while ( ( i < changedEnd ) && ( text_[i] != '\n' ) ) {
+			_columns[i] = col;
+			col += char_width( text_[i] );
+			++ i;
+		}
+		if ( i == changedEnd ) {
+			int shift( col - suffixColumn );
+			if ( shift != 0 ) {
+				for ( int j( i ); j <= end; ++ j ) {
+					_columns[j] += shift;
+				}
+			}
+			i = end;
+			col = _columns[end];
+		} else {
+			_columns[i] = col;
+		}
+		Line line{ lineStart, i - lineStart, row, col / _screenColumns + 1 };
+		row += line.rows;
+		_lines.insert( _lines.begin() + lineNo, line );
+		++ lineNo;
+		if ( i >= end ) {
+			break;
+		}
+		++ i;
+		lineStart = i;
+		col = 0;
+	}
+	int rowDelta( row - oldRowsEnd );
+	for ( int l( lineNo ), count( static_cast<int>( _lines.size() ) ); l < count; ++ l ) {
+		_lines[l].start += delta;
+		_lines[l].row += rowDelta;
+	}
+}
+
+/*
+ * Logical line containing character at `pos`,
+ * position of terminating '\n' belongs to the line it ends.
+ */
+int Layout::line_of( int pos_ ) const {
+	auto it( upper_bound( _lines.begin(), _lines.end(), pos_, []( int pos, Line const& line ) { return ( pos < line.start ); } ) );
+	return ( static_cast<int>( it - _lines.begin() ) - 1 );
+}
+
+/*
+ * Screen position of character at `pos`, `extra` columns further.
+ */
+void Layout::position( int pos_, int& x_, int& y_, int extra_ ) const {
+	Line const& line( _lines[line_of( pos_ )] );
+	int col( _columns[pos_] + ( extra_ > 0 ? extra_ : 0 ) );
+	x_ = col % _screenColumns;
+	y_ = line.row + col / _screenColumns;
+}
+
+/*
+ * Position in logical line `line` closest to given column.
+ */
+int Layout::pos_at( int line_, int column_ ) const {
+	Line const& line( _lines[line_] );
+	std::vector<int>::const_iterator begin( _columns.begin() + line.start );
+	return ( static_cast<int>( lower_bound( begin, begin + line.length, column_ ) - _columns.begin() ) );
+}
+
+/*
+ * Position of first character shown in screen row `row`.
+ */
+int Layout::row_start( int row_ ) const {
+	auto it( upper_bound( _lines.begin(), _lines.end(), row_, []( int row, Line const& line ) { return ( row < line.row ); } ) );
+	int line( static_cast<int>( it - _lines.begin() ) - 1 );
+	if ( line < 0 ) {
+		return ( 0 );
+	}
+	Line const& l( _lines[line] );
+	if ( row_ >= ( l.row + l.rows ) ) {
+		return ( static_cast<int>( _columns.size() ) - 1 );
+	}
+	return ( row_ > l.row ? pos_at( line, ( row_ - l.row ) * _screenColumns ) : l.start );
+}
+
+}
+
@@ -0,0 +1,65 @@
+#ifndef REPLXX_LAYOUT_HXX_INCLUDED
+#define REPLXX_LAYOUT_HXX_INCLUDED 1
+
+#include <vector>
+
+namespace replxx {
+
+/*
+ * Screen layout of the input split into logical lines at '\n'.
+ *
+ * First logical line starts right after the prompt, following ones
+ * at column 0. For every logical line its first row and number of rows
+ * it wraps into are kept together with column of each character within
+ * its logical line. Every edit of the input is passed to changed()
+ * which measures only inserted characters, columns of the rest
+ * of touched lines and rows of following lines are shifted.
+ */
+class Layout {
+	struct Line {
+		int start;  // index of first character
+		int length; // characters excluding terminating '\n'
+		int row;    // first screen row, relative to the row of the prompt end
+		int rows;   // rows taken, end of line in the last column adds an empty row
+	};
+	std::vector<int> _columns; // _columns[i] - column of i-th character within its logical line, len + 1 elements
+	std::vector<Line> _lines;
+	int _indent;
+	int _screenColumns;
+public:
+	Layout( void );
+	void update( char32_t const*, int, int, int );
+	void changed( char32_t const*, int, int, int, int );
+	void position( int, int&, int&, int = 0 ) const;
+	int line_of( int ) const;
+	int line_count( void ) const {
+		return ( static_cast<int>( _lines.size() ) );
+	}
+	int line_start( int line_ ) const {
+		return ( _lines[line_].start );
+	}
+	int line_end( int line_ ) const {
+		return ( _lines[line_].start + _lines[line_].length );
+	}
+	int line_row( int line_ ) const {
+		return ( _lines[line_].row );
+	}
+	// columns taken by logical line `line`, not counting the prompt
+	int line_width( int line_ ) const {
+		return ( _columns[line_end( line_ )] - ( line_ > 0 ? 0 : _indent ) );
+	}
+	int column( int pos_ ) const {
+		return ( _columns[pos_] );
+	}
+	int pos_at( int, int ) const;
+	int row_start( int ) const;
+	int row_count( void ) const {
+		return ( _lines.back().row + _lines.back().rows );
+	}
+	void clear( void );
+};
+
+}
+
+#endif
+
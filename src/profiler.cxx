@@ -0,0 +1,207 @@
+#include <cstring>
+#include <cmath>
+
+#include "profiler.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+namespace {
+
+char const* const PHASE_NAMES[] = {
+	"read", "decode", "edit", "highlight", "hint", "layout", "write"
+};
+
+inline long long elapsed( Profiler::clock_t::time_point from_, Profiler::clock_t::time_point to_ ) {
+	return ( chrono::duration_cast<chrono::nanoseconds>( to_ - from_ ).count() );
+}
+
+void add_sample( Replxx::Stats::Histogram& histogram_, long long ns_ ) {
+	if ( ns_ < 0 ) {
+		ns_ = 0;
+	}
+	int bucket( 0 );
+	for ( long long v( ns_ ); ( v > 0 ) && ( bucket < ( Replxx::Stats::Histogram::BUCKET_COUNT - 1 ) ); v >>= 1 ) {
+		++ bucket;
+	}
+	++ histogram_.count;
+	histogram_.total += ns_;
+	if ( ns_ > histogram_.max ) {
+		histogram_.max = ns_;
+	}
+	++ histogram_.buckets[bucket];
+}
+
+}
+
+long long Replxx::Stats::Histogram::percentile( double percent_ ) const {
+	if ( count == 0 ) {
+		return ( 0 );
+	}
+	long long target( static_cast<long long>( ceil( static_cast<double>( count ) * percent_ / 100. ) ) );
+	if ( target < 1 ) {
+		target = 1;
+	}
+	long long seen( 0 );
+	for ( int i( 0 ); i < BUCKET_COUNT; ++ i ) {
+		seen += buckets[i];
+		if ( seen >= target ) {
+			long long bound( i > 0 ? ( 1LL << i ) - 1 : 0 );
+			return ( bound < max ? bound : max );
+		}
+	}
+	return ( max );
+}
+
+Profiler::Profiler( IOCounters const& io_ )
+	: _enabled( false )
+	, _inKeystroke( false )
+	, _stats()
+	, _origin( clock_t::now() )
+	, _keystrokeStart()
+	, _phaseTime()
+	, _phaseSeen()
+	, _io( io_ )
+	, _ioStart( io_ )
+	, _key( 0 )
+	, _trace( nullptr )
+	, _firstEvent( true ) {
+	reset();
+}
+
+Profiler::~Profiler( void ) {
+	set_trace_file( "" );
+}
+
+void Profiler::enable( bool enabled_ ) {
+	_enabled = enabled_;
+	if ( ! _enabled ) {
+		_inKeystroke = false;
+	}
+}
+
+void Profiler::reset( void ) {
+	memset( &_stats, 0, sizeof ( _stats ) );
+}
+
+int Profiler::set_trace_file( std::string const& filename_ ) {
+	if ( _trace ) {
+		fputs( "\n]\n", _trace );
+		fclose( _trace );
+		_trace = nullptr;
+	}
+	if ( filename_.empty() ) {
+		return ( 0 );
+	}
+	_trace = fopen( filename_.c_str(), "w" );
+	if ( ! _trace ) {
+		return ( -1 );
+	}
+	fputs( "[", _trace );
+	_firstEvent = true;
+	return ( 0 );
+}
+
+void Profiler::begin_keystroke( void ) {
+	if ( ! _enabled ) {
+		return;
+	}
+	_inKeystroke = true;
+	memset( _phaseTime, 0, sizeof ( _phaseTime ) );
+	memset( _phaseSeen, 0, sizeof ( _phaseSeen ) );
+	_ioStart = _io;
+	_keystrokeStart = clock_t::now();
+}
+
+/*
+ * Time spent in read() system calls is READ,
+ * the rest of getting a keystroke is DECODE.
+ */
+void Profiler::end_read( int key_ ) {
+	if ( ! _inKeystroke ) {
+		return;
+	}
+	_key = key_;
+	long long readTime( _io.readTime - _ioStart.readTime );
+	long long total( elapsed( _keystrokeStart, clock_t::now() ) );
+	add( PHASE::READ, readTime );
+	add( PHASE::DECODE, total - readTime );
+	if ( _trace ) {
+		trace( PHASE_NAMES[static_cast<int>( PHASE::READ )], _keystrokeStart, readTime );
+		trace( PHASE_NAMES[static_cast<int>( PHASE::DECODE )], _keystrokeStart + chrono::nanoseconds( readTime ), total - readTime );
+	}
+}
+
+/*
+ * Writes are scattered all over refresh code so WRITE is taken
+ * from I/O counters, EDIT is whatever is left unaccounted for.
+ */
+void Profiler::end_keystroke( void ) {
+	if ( ! _inKeystroke ) {
+		return;
+	}
+	_inKeystroke = false;
+	IOCounters const& io( _io );
+	long long total( elapsed( _keystrokeStart, clock_t::now() ) );
+	add( PHASE::WRITE, io.writeTime - _ioStart.writeTime );
+	long long accounted( 0 );
+	for ( long long t : _phaseTime ) {
+		accounted += t;
+	}
+	add( PHASE::EDIT, total - accounted );
+	add_sample( _stats.keystroke, total );
+	for ( int i( 0 ); i < Replxx::Stats::PHASE_COUNT; ++ i ) {
+		if ( _phaseSeen[i] ) {
+			add_sample( _stats.phases[i], _phaseTime[i] );
+		}
+	}
+	long long bytes( io.bytesWritten - _ioStart.bytesWritten );
+	long long writes( io.writeCalls - _ioStart.writeCalls );
+	_stats.bytesWritten += bytes;
+	_stats.writeCalls += writes;
+	if ( _trace ) {
+		char args[128];
+		snprintf(
+			args, sizeof ( args ),
+			"{\"key\":%d,\"edit\":%lld,\"write\":%lld,\"bytes\":%lld,\"writes\":%lld}",
+			_key, _phaseTime[static_cast<int>( PHASE::EDIT )], _phaseTime[static_cast<int>( PHASE::WRITE )], bytes, writes
+		);
+		trace( "keystroke", _keystrokeStart, total, args );
+		fflush( _trace );
+	}
+}
+
+void Profiler::record( PHASE phase_, clock_t::time_point start_, clock_t::time_point end_ ) {
+	if ( ! _inKeystroke ) {
+		return;
+	}
+	long long duration( elapsed( start_, end_ ) );
+	add( phase_, duration );
+	if ( _trace ) {
+		trace( PHASE_NAMES[static_cast<int>( phase_ )], start_, duration );
+	}
+}
+
+void Profiler::add( PHASE phase_, long long duration_ ) {
+	int idx( static_cast<int>( phase_ ) );
+	_phaseTime[idx] += duration_ > 0 ? duration_ : 0;
+	_phaseSeen[idx] = true;
+}
+
+void Profiler::trace( char const* name_, clock_t::time_point start_, long long duration_, char const* args_ ) {
+	fprintf(
+		_trace,
+		"%s\n{\"name\":\"%s\",\"cat\":\"replxx\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1%s%s}",
+		_firstEvent ? "" : ",",
+		name_,
+		static_cast<double>( elapsed( _origin, start_ ) ) / 1000.,
+		static_cast<double>( duration_ > 0 ? duration_ : 0 ) / 1000.,
+		args_ ? ",\"args\":" : "",
+		args_ ? args_ : ""
+	);
+	_firstEvent = false;
+}
+
+}
+
@@ -0,0 +1,87 @@
+#ifndef REPLXX_PROFILER_HXX_INCLUDED
+#define REPLXX_PROFILER_HXX_INCLUDED 1
+
+#include <cstdio>
+#include <chrono>
+#include <string>
+
+#include "replxx.hxx"
+#include "io.hxx"
+
+namespace replxx {
+
+/*
+ * Keystroke latency instrumentation backing Replxx::stats().
+ */
+class Profiler {
+public:
+	typedef std::chrono::steady_clock clock_t;
+	typedef Replxx::Stats::PHASE PHASE;
+	/*
+	 * Time enclosing scope as given phase of current keystroke.
+	 */
+	class Scope {
+		Profiler& _profiler;
+		PHASE _phase;
+		bool _active;
+		clock_t::time_point _start;
+	public:
+		Scope( Profiler& profiler_, PHASE phase_ )
+			: _profiler( profiler_ )
+			, _phase( phase_ )
+			, _active( profiler_._inKeystroke )
+			, _start( _active ? clock_t::now() : clock_t::time_point() ) {
+		}
+		~Scope( void ) {
+			stop();
+		}
+		/*
+		 * End timed part before end of enclosing scope,
+		 * e.g. to leave out terminal writes timed as WRITE.
+		 */
+		void stop( void ) {
+			if ( _active ) {
+				_profiler.record( _phase, _start, clock_t::now() );
+				_active = false;
+			}
+		}
+	};
+private:
+	bool _enabled;
+	bool _inKeystroke;
+	Replxx::Stats _stats;
+	clock_t::time_point _origin; // time base for trace events
+	clock_t::time_point _keystrokeStart;
+	long long _phaseTime[Replxx::Stats::PHASE_COUNT]; // accumulated during current keystroke
+	bool _phaseSeen[Replxx::Stats::PHASE_COUNT];
+	IOCounters const& _io;   // counters of terminal keystrokes are read from
+	IOCounters _ioStart;
+	int _key;
+	FILE* _trace;
+	bool _firstEvent;
+public:
+	Profiler( IOCounters const& );
+	~Profiler( void );
+	void enable( bool );
+	bool enabled( void ) const {
+		return ( _enabled );
+	}
+	void reset( void );
+	int set_trace_file( std::string const& );
+	void begin_keystroke( void );
+	void end_read( int key );
+	void end_keystroke( void );
+	Replxx::Stats const& stats( void ) const {
+		return ( _stats );
+	}
+private:
+	void record( PHASE, clock_t::time_point, clock_t::time_point );
+	void add( PHASE, long long );
+	void trace( char const*, clock_t::time_point, long long, char const* = nullptr );
+	Profiler( Profiler const& ) = delete;
+	Profiler& operator = ( Profiler const& ) = delete;
+};
+
+}
+
+#endif
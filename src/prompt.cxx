@@ -23,87 +23,204 @@
 
 namespace replxx {
 
+int mk_wcwidth( char32_t );
 
-PromptBase::PromptBase( int columns_ )
-	: promptExtraLines( 0 )
-	, promptLastLinePosition( 0 )
-	, promptPreviousInputLen( 0 )
-	, promptScreenColumns( columns_ )
-	, promptPreviousLen( 0 ) {
+namespace {
+
+/*
+ * Length of escape sequence starting at `text[0]` (ESC):
+ * CSI - ESC [ parameters intermediates final,
+ * OSC - ESC ] ... terminated by BEL or ST (ESC \),
+ * any other ESC sequence is taken as ESC followed by single character.
+ */
+int escape_length( char32_t const* text_, int len_ ) {
+	if ( len_ < 2 ) {
+		return ( len_ );
+	}
+	int i( 2 );
+	if ( text_[1] == '[' ) {
+		while ( ( i < len_ ) && ( text_[i] >= 0x30 ) && ( text_[i] <= 0x3f ) ) {
+			++ i;
+		}
+		while ( ( i < len_ ) && ( text_[i] >= 0x20 ) && ( text_[i] <= 0x2f ) ) {
+			++ i;
+		}
+		if ( ( i < len_ ) && ( text_[i] >= 0x40 ) && ( text_[i] <= 0x7e ) ) {
+			++ i;
+		}
+	} else if ( text_[1] == ']' ) {
+		while ( i < len_ ) {
+			if ( text_[i] == '\a' ) {
+				return ( i + 1 );
+			}
+			if ( ( text_[i] == '\x1b' ) && ( ( i + 1 ) < len_ ) && ( text_[i + 1] == '\\' ) ) {
+				return ( i + 2 );
+			}
+			++ i;
+		}
+	}
+	return ( i );
 }
 
-void PromptBase::write() {
-	write32( promptText.get(), promptBytes );
 }
 
-PromptInfo::PromptInfo( std::string const& text_, int columns )
-	: PromptBase( columns ) {
-	UnicodeString tempUnicode( text_ );
+Replxx::Prompt::PromptImpl::PromptImpl( std::string const& text_ )
+	: _text( text_ )
+	, _display( text_ )
+	, _plain()
+	, _widths()
+	, _utf8()
+	, _plainUtf8()
+	, _lines( 0 )
+	, _width( 0 ) {
+	// drop control characters other than newline, plain variant drops escape sequences too
+	int len( _display.length() );
+	_plain.assign( _display );
+	int out( 0 );
+	int plainOut( 0 );
+	for ( int in( 0 ); in < len; ) {
+		char32_t c( _display[in] );
+		if ( c == '\x1b' ) {
+			int escLen( escape_length( _display.get() + in, len - in ) );
+			for ( int i( 0 ); i < escLen; ++ i ) {
+				_display[out ++] = _display[in + i];
+			}
+			in += escLen;
+			continue;
+		}
+		++ in;
+		if ( c == '\n' ) {
+			_widths.push_back( -1 );
+			++ _lines;
+			_width = 0;
+		} else if ( ! isControlChar( c ) ) {
+			int w( mk_wcwidth( c ) );
+			_widths.push_back( w > 0 ? w : 0 );
+			_width += _widths.back();
+		} else {
+			continue;
+		}
+		_display[out ++] = c;
+		_plain[plainOut ++] = c;
+	}
+	_display.erase( out, len - out );
+	_plain.erase( plainOut, len - plainOut );
+	std::vector<char> utf8( 4 * out + 1 );
+	int bytes( 0 );
+	copyString32to8( utf8.data(), static_cast<int>( utf8.size() ), _display.get(), out, &bytes );
+	_utf8.assign( utf8.data(), bytes ).push_back( '\n' );
+	copyString32to8( utf8.data(), static_cast<int>( utf8.size() ), _plain.get(), plainOut, &bytes );
+	_plainUtf8.assign( utf8.data(), bytes ).push_back( '\n' );
+}
+
+/*
+ * Screen rows and end column of the prompt on screen `columns_` wide,
+ * double width character that does not fit at line end goes to next row.
+ */
+void Replxx::Prompt::PromptImpl::layout( int columns_, int& extraLines_, int& indentation_, int& lastLinePosition_ ) const {
+	extraLines_ = 0;
+	lastLinePosition_ = 0;
+	int x( 0 );
+	for ( int i( 0 ), count( static_cast<int>( _widths.size() ) ); i < count; ++ i ) {
+		int w( _widths[i] );
+		if ( w < 0 ) {
+			x = 0;
+			++ extraLines_;
+			lastLinePosition_ = i + 1;
+			continue;
+		}
+		if ( ( x + w ) > columns_ ) {
+			x = 0;
+			++ extraLines_;
+			lastLinePosition_ = i;
+		}
+		x += w;
+		if ( x >= columns_ ) {
+			x = 0;
+			++ extraLines_;
+			lastLinePosition_ = i + 1;
+		}
+	}
+	indentation_ = x;
+}
+
+Replxx::Prompt::Prompt( void )
+	: Prompt( std::string() ) {
+}
+
+Replxx::Prompt::Prompt( std::string const& text_ )
+	: _impl( std::make_shared<PromptImpl>( text_ ) ) {
+}
 
-	// strip control characters from the prompt -- we do allow newline
-	UnicodeString::const_iterator in( tempUnicode.begin() );
-	UnicodeString::iterator out( tempUnicode.begin() );
+std::string const& Replxx::Prompt::text( void ) const {
+	return ( _impl->_text );
+}
 
-	int len = 0;
-	int x = 0;
+int Replxx::Prompt::width( void ) const {
+	return ( _impl->_width );
+}
 
-	bool const strip = !tty::out;
+int Replxx::Prompt::lines( void ) const {
+	return ( _impl->_lines );
+}
 
-	while (in != tempUnicode.end()) {
-		char32_t c = *in;
-		if ('\n' == c || !isControlChar(c)) {
-			*out = c;
-			++out;
-			++in;
-			++len;
-			if ('\n' == c || ++x >= promptScreenColumns) {
-				x = 0;
-				++promptExtraLines;
-				promptLastLinePosition = len;
-			}
-		} else if (c == '\x1b') {
-			if (strip) {
-				// jump over control chars
-				++in;
-				if (*in == '[') {
-					++in;
-					while ( ( in != tempUnicode.end() ) && ( ( *in == ';' ) || ( ( ( *in >= '0' ) && ( *in <= '9' ) ) ) ) ) {
-						++in;
-					}
-					if (*in == 'm') {
-						++in;
-					}
-				}
-			} else {
-				// copy control chars
-				*out = *in;
-				++out;
-				++in;
-				if (*in == '[') {
-					*out = *in;
-					++out;
-					++in;
-					while ( ( in != tempUnicode.end() ) && ( ( *in == ';' ) || ( ( ( *in >= '0' ) && ( *in <= '9' ) ) ) ) ) {
-						*out = *in;
-						++out;
-						++in;
-					}
-					if (*in == 'm') {
-						*out = *in;
-						++out;
-						++in;
-					}
-				}
-			}
-		} else {
-			++in;
+PromptBase::PromptBase( Terminal& terminal_, int columns_ )
+	: terminal( terminal_ )
+	, promptExtraLines( 0 )
+	, promptLastLinePosition( 0 )
+	, promptPreviousInputLen( 0 )
+	, promptScreenColumns( columns_ )
+	, promptScreenRows( 0 )
+	, promptPreviousLen( 0 )
+	, promptUtf8( nullptr )
+	, promptUtf8Bytes( 0 ) {
+}
+
+void PromptBase::write() {
+	if ( promptUtf8 ) {
+		terminal.write8( promptUtf8, promptUtf8Bytes );
+	} else {
+		terminal.write32( promptText.get(), promptBytes );
+	}
+}
+
+// append last line of the prompt, together with escape sequences preceding it
+void PromptBase::last_line( std::vector<char32_t>& out_ ) const {
+	int visible( 0 );
+	for ( int i( 0 ); i < promptBytes; ) {
+		char32_t c( promptText[i] );
+		if ( c == '\x1b' ) {
+			int escLen( escape_length( promptText.get() + i, promptBytes - i ) );
+			out_.insert( out_.end(), promptText.get() + i, promptText.get() + i + escLen );
+			i += escLen;
+			continue;
+		}
+		if ( ( visible >= promptLastLinePosition ) && ( c != '\n' ) ) {
+			out_.push_back( c );
 		}
+		++ visible;
+		++ i;
 	}
-	promptChars = len;
-	promptBytes = static_cast<int>(out - tempUnicode.begin());
-	promptText = tempUnicode;
+}
 
-	promptIndentation = len - promptLastLinePosition;
+PromptInfo::PromptInfo( Replxx::Prompt::PromptImpl const& prompt_, Terminal& terminal_, int columns )
+	: PromptBase( terminal_, columns ) {
+	// escape sequences are kept only for a terminal
+	bool const tty( terminal_.output_is_tty() );
+	UnicodeString const& display( tty ? prompt_._display : prompt_._plain );
+	std::string const& utf8( tty ? prompt_._utf8 : prompt_._plainUtf8 );
+	promptText = display;
+	promptChars = static_cast<int>( prompt_._widths.size() );
+	promptBytes = display.length();
+	prompt_.layout( columns, promptExtraLines, promptIndentation, promptLastLinePosition );
+	promptUtf8 = utf8.data();
+	promptUtf8Bytes = static_cast<int>( utf8.length() ) - 1;
+#ifndef _WIN32
+	// we have to generate our own newline on line wrap on Linux
+	if ( ( promptIndentation == 0 ) && ( promptExtraLines > 0 ) ) {
+		++ promptUtf8Bytes;
+	}
+#endif
 	promptCursorRowOffset = promptExtraLines;
 }
 
@@ -112,10 +229,9 @@ PromptInfo::PromptInfo( std::string const& text_, int columns )
 const UnicodeString forwardSearchBasePrompt("(i-search)`");
 const UnicodeString reverseSearchBasePrompt("(reverse-i-search)`");
 const UnicodeString endSearchBasePrompt("': ");
-UnicodeString previousSearchText;	// remembered across invocations of replxx_input()
 
 DynamicPrompt::DynamicPrompt(PromptBase& pi, int initialDirection)
-	: PromptBase( pi.promptScreenColumns )
+	: PromptBase( pi.terminal, pi.promptScreenColumns )
 	, searchText()
 	, direction( initialDirection ) {
 	promptScreenColumns = pi.promptScreenColumns;
@@ -2,11 +2,32 @@
 #define REPLXX_PROMPT_HXX_INCLUDED 1
 
 #include <cstdlib>
+#include <vector>
+#include <string>
 
+#include "replxx.hxx"
 #include "unicodestring.hxx"
 
 namespace replxx {
+
+class Terminal;
+
+// prompt text parsed once, shared by all Replxx::Prompt copies
+class Replxx::Prompt::PromptImpl {
+public:
+	std::string _text;         // prompt as given by the user
+	UnicodeString _display;    // control characters dropped, escape sequences kept, for a terminal
+	UnicodeString _plain;      // escape sequences dropped too, for output that is not a terminal
+	std::vector<int> _widths;  // width of each visible character, -1 for '\n'
+	std::string _utf8;         // _display encoded for the terminal, followed by "\n"
+	std::string _plainUtf8;    // _plain encoded, followed by "\n"
+	int _lines;                // newlines in the prompt
+	int _width;                // columns taken by the last line
+	explicit PromptImpl( std::string const& );
+	void layout( int, int&, int&, int& ) const;
+};
 struct PromptBase {						// a convenience struct for grouping prompt info
+	Terminal& terminal;					// terminal the prompt is written to
 	UnicodeString promptText;			// our copy of the prompt text, edited
 	char* promptCharWidths;			// character widths from mk_wcwidth()
 	int promptChars;						 // chars in promptText
@@ -19,19 +40,21 @@ struct PromptBase {						// a convenience struct for grouping prompt info
 	int promptCursorRowOffset;	 // where the cursor is relative to the start of
 															 // the prompt
 	int promptScreenColumns;		 // width of screen in columns
+	int promptScreenRows;				 // height of screen in rows, 0 if unknown
 	int promptPreviousLen;			 // help erasing
 	int promptErrorCode;				 // error code (invalid UTF-8) or zero
+	char const* promptUtf8;			 // pre-encoded promptText, null if it has to be encoded on each write
+	int promptUtf8Bytes;				 // bytes written, including newline needed when prompt ends at line wrap
 
-	PromptBase( int );
+	PromptBase( Terminal&, int );
 	void write();
+	void last_line( std::vector<char32_t>& ) const;
 };
 
 struct PromptInfo : public PromptBase {
-	PromptInfo(std::string const& textPtr, int columns);
+	PromptInfo( Replxx::Prompt::PromptImpl const&, Terminal&, int columns );
 };
 
-extern UnicodeString previousSearchText;	// remembered across invocations of replxx_input()
-
 // changing prompt for "(reverse-i-search)`text':" etc.
 //
 struct DynamicPrompt : public PromptBase {
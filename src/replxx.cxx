@@ -85,6 +85,7 @@
 
 #include <algorithm>
 #include <cstdarg>
+#include <cstddef>
 
 #ifdef _WIN32
 
@@ -120,10 +121,34 @@ Replxx::Replxx( void )
 	: _impl( new Replxx::ReplxxImpl( nullptr, nullptr, nullptr ), delete_ReplxxImpl ) {
 }
 
+Replxx::Replxx( FILE* in_, FILE* out_, FILE* err_ )
+	: _impl( new Replxx::ReplxxImpl( in_, out_, err_ ), delete_ReplxxImpl ) {
+}
+
 void Replxx::set_completion_callback( completion_callback_t const& fn ) {
 	_impl->set_completion_callback( fn );
 }
 
+void Replxx::set_streaming_completion_callback( streaming_completion_callback_t const& fn ) {
+	_impl->set_streaming_completion_callback( fn );
+}
+
+void Replxx::add_completion_source( streaming_completion_callback_t const& fn, int priority, int deadline ) {
+	_impl->add_completion_source( fn, priority, deadline );
+}
+
+void Replxx::clear_completion_sources( void ) {
+	_impl->clear_completion_sources();
+}
+
+void Replxx::set_completion_dictionary( completion_dictionary_t const& dictionary ) {
+	_impl->set_completion_dictionary( dictionary );
+}
+
+void Replxx::set_dictionary_hints( bool val ) {
+	_impl->set_dictionary_hints( val );
+}
+
 void Replxx::set_highlighter_callback( highlighter_callback_t const& fn ) {
 	_impl->set_highlighter_callback( fn );
 }
@@ -132,10 +157,50 @@ void Replxx::set_hint_callback( hint_callback_t const& fn ) {
 	_impl->set_hint_callback( fn );
 }
 
+void Replxx::set_highlighter_deadline( int milliseconds ) {
+	_impl->set_highlighter_deadline( milliseconds );
+}
+
+void Replxx::set_hint_deadline( int milliseconds ) {
+	_impl->set_hint_deadline( milliseconds );
+}
+
+int Replxx::highlighter_overruns( void ) const {
+	return ( _impl->highlighter_overruns() );
+}
+
+int Replxx::hint_overruns( void ) const {
+	return ( _impl->hint_overruns() );
+}
+
+void Replxx::enable_stats( bool val_ ) {
+	_impl->enable_stats( val_ );
+}
+
+Replxx::Stats Replxx::stats( void ) const {
+	return ( _impl->stats() );
+}
+
+void Replxx::reset_stats( void ) {
+	_impl->reset_stats();
+}
+
+int Replxx::set_trace_file( std::string const& filename_ ) {
+	return ( _impl->set_trace_file( filename_ ) );
+}
+
 char const* Replxx::input( std::string const& prompt ) {
 	return ( _impl->input( prompt ) );
 }
 
+char const* Replxx::input( Prompt const& prompt ) {
+	return ( _impl->input( prompt ) );
+}
+
+Replxx::lines_t const& Replxx::input_batch( std::string const& prompt, int count ) {
+	return ( _impl->input_batch( prompt, count ) );
+}
+
 void Replxx::history_add( std::string const& line ) {
 	_impl->history_add( line );
 }
@@ -172,6 +237,26 @@ void Replxx::set_completion_count_cutoff( int count ) {
 	_impl->set_completion_count_cutoff( count );
 }
 
+void Replxx::set_max_displayed_completions( int count ) {
+	_impl->set_max_displayed_completions( count );
+}
+
+void Replxx::set_completion_menu_rows( int count ) {
+	_impl->set_completion_menu_rows( count );
+}
+
+void Replxx::set_incremental_completion( bool val ) {
+	_impl->set_incremental_completion( val );
+}
+
+void Replxx::set_quote_aware_brace_matching( bool val ) {
+	_impl->set_quote_aware_brace_matching( val );
+}
+
+void Replxx::set_multiline( bool val ) {
+	_impl->set_multiline( val );
+}
+
 void Replxx::set_double_tab_completion( bool val ) {
 	_impl->set_double_tab_completion( val );
 }
@@ -180,6 +265,10 @@ void Replxx::set_complete_on_empty( bool val ) {
 	_impl->set_complete_on_empty( val );
 }
 
+void Replxx::set_completion_ranking( bool val ) {
+	_impl->set_completion_ranking( val );
+}
+
 void Replxx::set_beep_on_ambiguous_completion( bool val ) {
 	_impl->set_beep_on_ambiguous_completion( val );
 }
@@ -192,6 +281,10 @@ void Replxx::set_max_history_size( int len ) {
 	_impl->set_max_history_size( len );
 }
 
+void Replxx::set_kill_ring_size( int entries, int characters ) {
+	_impl->set_kill_ring_size( entries, characters );
+}
+
 void Replxx::clear_screen( void ) {
 	_impl->clear_screen();
 }
@@ -256,6 +349,35 @@ char const* replxx_input( ::Replxx* replxx_, const char* prompt ) {
 	return ( replxx->input( prompt ) );
 }
 
+struct replxx_prompt {
+	replxx::Replxx::Prompt data;
+};
+
+replxx_prompt* replxx_prompt_init( char const* text_ ) {
+	return ( new replxx_prompt{ replxx::Replxx::Prompt( text_ ? text_ : "" ) } );
+}
+
+void replxx_prompt_end( replxx_prompt* prompt_ ) {
+	delete prompt_;
+}
+
+char const* replxx_input_prompt( ::Replxx* replxx_, replxx_prompt const* prompt_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	return ( replxx->input( prompt_->data ) );
+}
+
+int replxx_input_batch( ::Replxx* replxx_, const char* prompt, int count, ReplxxLine const** lines ) {
+	static_assert(
+		( sizeof ( ReplxxLine ) == sizeof ( replxx::Replxx::LineView ) )
+		&& ( offsetof( ReplxxLine, length ) == offsetof( replxx::Replxx::LineView, length ) ),
+		"ReplxxLine must have the layout of Replxx::LineView"
+	);
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx::Replxx::lines_t const& batch( replxx->input_batch( prompt, count ) );
+	*lines = reinterpret_cast<ReplxxLine const*>( batch.data() );
+	return ( static_cast<int>( batch.size() ) );
+}
+
 int replxx_print( ::Replxx* replxx_, char const* format_, ... ) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
 	::std::va_list ap;
@@ -270,23 +392,92 @@ int replxx_print( ::Replxx* replxx_, char const* format_, ... ) {
 }
 
 struct replxx_completions {
-	replxx::Replxx::completions_t data;
+	replxx::Replxx::CompletionSink& sink;
 };
 
 struct replxx_hints {
 	replxx::Replxx::hints_t data;
 };
 
-replxx::Replxx::completions_t completions_fwd( replxx_completion_callback_t fn, std::string const& input_, int& contextLen_, void* userData ) {
-	replxx_completions completions;
+void completions_fwd( replxx_completion_callback_t fn, std::string const& input_, int& contextLen_, replxx::Replxx::CompletionSink& sink_, void* userData ) {
+	replxx_completions completions{ sink_ };
 	fn( input_.c_str(), &completions, &contextLen_, userData );
-	return ( completions.data );
 }
 
 /* Register a callback function to be called for tab-completion. */
 void replxx_set_completion_callback(::Replxx* replxx_, replxx_completion_callback_t* fn, void* userData) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
-	replxx->set_completion_callback( std::bind( &completions_fwd, fn, _1, _2, userData ) );
+	replxx->set_streaming_completion_callback( std::bind( &completions_fwd, fn, _1, _2, _3, userData ) );
+}
+
+void replxx_add_completion_source( ::Replxx* replxx_, replxx_completion_callback_t* fn, void* userData, int priority, int deadline ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->add_completion_source( std::bind( &completions_fwd, fn, _1, _2, _3, userData ), priority, deadline );
+}
+
+void replxx_clear_completion_sources( ::Replxx* replxx_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->clear_completion_sources();
+}
+
+struct replxx_completion_dictionary {
+	replxx::Replxx::completion_dictionary_t data;
+};
+
+replxx_completion_dictionary* replxx_completion_dictionary_init( char const** words_, int const* weights_, int count_ ) {
+	return (
+		new replxx_completion_dictionary{
+			std::make_shared<replxx::CompletionDictionary>(
+				replxx::CompletionDictionary::words_t( words_, words_ + count_ ),
+				weights_ ? replxx::CompletionDictionary::weights_t( weights_, weights_ + count_ ) : replxx::CompletionDictionary::weights_t()
+			)
+		}
+	);
+}
+
+void replxx_completion_dictionary_update( replxx_completion_dictionary* dictionary_, char const** words_, int const* weights_, int count_ ) {
+	dictionary_->data->update(
+		replxx::CompletionDictionary::words_t( words_, words_ + count_ ),
+		weights_ ? replxx::CompletionDictionary::weights_t( weights_, weights_ + count_ ) : replxx::CompletionDictionary::weights_t()
+	);
+}
+
+void replxx_completion_dictionary_end( replxx_completion_dictionary* dictionary_ ) {
+	delete dictionary_;
+}
+
+void replxx_set_completion_dictionary( ::Replxx* replxx_, replxx_completion_dictionary* dictionary_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_completion_dictionary( dictionary_ ? dictionary_->data : replxx::Replxx::completion_dictionary_t() );
+}
+
+void replxx_set_dictionary_hints( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_dictionary_hints( val ? true : false );
+}
+
+ReplxxColor replxx_color_palette( int index_ ) {
+	return ( static_cast<ReplxxColor>( replxx::color::palette( index_ ) ) );
+}
+
+ReplxxColor replxx_color_rgb( int red_, int green_, int blue_ ) {
+	return ( static_cast<ReplxxColor>( replxx::color::rgb( red_, green_, blue_ ) ) );
+}
+
+ReplxxColor replxx_color_bg( ReplxxColor color_ ) {
+	return ( static_cast<ReplxxColor>( replxx::color::bg( static_cast<replxx::Replxx::Color>( color_ ) ) ) );
+}
+
+ReplxxColor replxx_color_bold( ReplxxColor color_ ) {
+	return ( static_cast<ReplxxColor>( replxx::color::bold( static_cast<replxx::Replxx::Color>( color_ ) ) ) );
+}
+
+ReplxxColor replxx_color_underline( ReplxxColor color_ ) {
+	return ( static_cast<ReplxxColor>( replxx::color::underline( static_cast<replxx::Replxx::Color>( color_ ) ) ) );
+}
+
+ReplxxColor replxx_color_combine( ReplxxColor left_, ReplxxColor right_ ) {
+	return ( static_cast<ReplxxColor>( static_cast<replxx::Replxx::Color>( left_ ) | static_cast<replxx::Replxx::Color>( right_ ) ) );
 }
 
 void highlighter_fwd( replxx_highlighter_callback_t fn, std::string const& input, replxx::Replxx::colors_t& colors, void* userData ) {
@@ -331,8 +522,59 @@ void replxx_add_hint(replxx_hints* lh, const char* str) {
 	lh->data.emplace_back(str);
 }
 
+void replxx_set_highlighter_deadline( ::Replxx* replxx_, int milliseconds ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_highlighter_deadline( milliseconds );
+}
+
+void replxx_set_hint_deadline( ::Replxx* replxx_, int milliseconds ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_hint_deadline( milliseconds );
+}
+
+int replxx_highlighter_overruns( ::Replxx* replxx_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	return ( replxx->highlighter_overruns() );
+}
+
+int replxx_hint_overruns( ::Replxx* replxx_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	return ( replxx->hint_overruns() );
+}
+
+void replxx_enable_stats( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->enable_stats( val ? true : false );
+}
+
+void replxx_get_stats( ::Replxx* replxx_, ReplxxStats* stats_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx::Replxx::Stats s( replxx->stats() );
+	stats_->keystrokes = s.keystroke.count;
+	for ( int i( 0 ); i <= replxx::Replxx::Stats::PHASE_COUNT; ++ i ) {
+		replxx::Replxx::Stats::Histogram const& h( i == 0 ? s.keystroke : s.phases[i - 1] );
+		stats_->p50[i] = h.percentile( 50 );
+		stats_->p99[i] = h.percentile( 99 );
+		stats_->max[i] = h.max;
+	}
+	stats_->bytesWritten = s.bytesWritten;
+	stats_->writeCalls = s.writeCalls;
+	stats_->highlighterOverruns = s.highlighterOverruns;
+	stats_->hintOverruns = s.hintOverruns;
+}
+
+void replxx_reset_stats( ::Replxx* replxx_ ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->reset_stats();
+}
+
+int replxx_set_trace_file( ::Replxx* replxx_, char const* filename ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	return ( replxx->set_trace_file( filename ? filename : "" ) );
+}
+
 void replxx_add_completion(replxx_completions* lc, const char* str) {
-	lc->data.emplace_back(str);
+	lc->sink.add(str);
 }
 
 void replxx_history_add( ::Replxx* replxx_, const char* line ) {
@@ -345,6 +587,11 @@ void replxx_set_max_history_size( ::Replxx* replxx_, int len ) {
 	replxx->set_max_history_size( len );
 }
 
+void replxx_set_kill_ring_size( ::Replxx* replxx_, int entries, int characters ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_kill_ring_size( entries, characters );
+}
+
 void replxx_set_max_hint_rows( ::Replxx* replxx_, int count ) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
 	replxx->set_max_hint_rows( count );
@@ -355,6 +602,31 @@ void replxx_set_completion_count_cutoff( ::Replxx* replxx_, int count ) {
 	replxx->set_completion_count_cutoff( count );
 }
 
+void replxx_set_max_displayed_completions( ::Replxx* replxx_, int count ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_max_displayed_completions( count );
+}
+
+void replxx_set_completion_menu_rows( ::Replxx* replxx_, int count ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_completion_menu_rows( count );
+}
+
+void replxx_set_incremental_completion( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_incremental_completion( val ? true : false );
+}
+
+void replxx_set_quote_aware_brace_matching( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_quote_aware_brace_matching( val ? true : false );
+}
+
+void replxx_set_multiline( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_multiline( val ? true : false );
+}
+
 void replxx_set_word_break_characters( ::Replxx* replxx_, char const* breakChars_ ) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
 	replxx->set_word_break_characters( breakChars_ );
@@ -370,6 +642,11 @@ void replxx_set_complete_on_empty( ::Replxx* replxx_, int val ) {
 	replxx->set_complete_on_empty( val ? true : false );
 }
 
+void replxx_set_completion_ranking( ::Replxx* replxx_, int val ) {
+	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
+	replxx->set_completion_ranking( val ? true : false );
+}
+
 void replxx_set_no_color( ::Replxx* replxx_, int val ) {
 	replxx::Replxx::ReplxxImpl* replxx( reinterpret_cast<replxx::Replxx::ReplxxImpl*>( replxx_ ) );
 	replxx->set_no_color( val ? true : false );
@@ -416,11 +693,12 @@ int replxx_history_size( ::Replxx* replxx_ ) {
 #ifdef __REPLXX_DEBUG__
 void replxx_debug_dump_print_codes(void) {
 	char quit[4];
+	Terminal terminal( STDIN_FILENO, 1, 2 );
 
 	printf(
 			"replxx key codes debugging mode.\n"
 			"Press keys to see scan codes. Type 'quit' at any time to exit.\n");
-	if (enableRawMode() == -1) return;
+	if (terminal.enableRawMode() == -1) return;
 	memset(quit, ' ', 4);
 	while (1) {
 		char c;
@@ -441,7 +719,7 @@ void replxx_debug_dump_print_codes(void) {
 		printf("\r"); /* Go left edge manually, we are in raw mode. */
 		fflush(stdout);
 	}
-	disableRawMode();
+	terminal.disableRawMode();
 }
 #endif // __REPLXX_DEBUG__
 
@@ -1,7 +1,9 @@
 #include <algorithm>
 #include <memory>
+#include <chrono>
+#include <unordered_set>
 #include <cerrno>
-#include <iostream>
+#include <stdexcept>
 
 #ifdef _WIN32
 
@@ -12,6 +14,7 @@
 #endif
 #define strcasecmp _stricmp
 #define write _write
+#define fileno _fileno
 #define STDIN_FILENO 0
 
 #else /* _WIN32 */
@@ -41,30 +44,17 @@ namespace replxx {
 struct PromptBase;
 void dynamicRefresh(PromptBase& pi, char32_t* buf32, int len, int pos);
 
-#ifndef _WIN32
-
-bool gotResize = false;
-
-#endif
-
 namespace {
 
 static int const REPLXX_MAX_HINT_ROWS( 4 );
+static int const REPLXX_MAX_DISPLAYED_COMPLETIONS( 1000 );
+static int const REPLXX_LATE_RESULT_POLL_INTERVAL( 10 ); // in milliseconds
 /*
  * All whitespaces and all non-alphanumerical characters from ASCII range
  * with an exception of an underscore ('_').
  */
 char const defaultBreakChars[] = " \t\v\f\a\b\r\n`~!@#$%^&*()-=+[{]}\\|;:'\",<.>/?";
 
-#ifndef _WIN32
-
-static void WindowSizeChanged(int) {
-	// do nothing here but setting this flag
-	gotResize = true;
-}
-
-#endif
-
 static const char* unsupported_term[] = {"dumb", "cons25", "emacs", NULL};
 
 static bool isUnsupportedTerm(void) {
@@ -80,66 +70,346 @@ static bool isUnsupportedTerm(void) {
 	return false;
 }
 
+/*
+ * Descriptor of the stream given to the instance, standard one if none was given.
+ */
+int descriptor( FILE* file_, int standard_ ) {
+	return ( file_ ? fileno( file_ ) : standard_ );
 }
 
-#ifndef _WIN32
-extern bool gotResize;
-#endif
+}
 
-Replxx::ReplxxImpl::ReplxxImpl( FILE*, FILE*, FILE* )
+Replxx::ReplxxImpl::ReplxxImpl( FILE* in_, FILE* out_, FILE* err_ )
 	: _utf8Buffer()
 	, _data()
 	, _charWidths()
+	, _dataUtf8()
 	, _display()
+	, _spans( 1, AttrSpan{ 0, AttrTable::RESET } )
+	, _inputSpans( 1, AttrSpan{ 0, AttrTable::RESET } )
+	, _attrs()
+	, _encoded()
+	, _generation( 0 )
+	, _renderedGeneration( -1 )
+	, _renderedBytes( 0 )
+	, _renderedPos( 0 )
+	, _renderedRows( 0 )
+	, _renderedBrace( -1 )
+	, _renderedBraceError( false )
+	, _renderedLineRows()
+	, _layout()
+	, _displayRows( 0 )
+	, _viewportTop( -1 )
+	, _viewportRows( 0 )
+	, _lines()
+	, _braceIndex()
+	, _screenCells()
+	, _renderedLines()
+	, _wantedCells()
+	, _patch()
+	, _colors()
+	, _callbackInput()
 	, _hint()
 	, _pos( 0 )
 	, _prefix( 0 )
 	, _hintSelection( -1 )
 	, _history()
 	, _killRing()
+	, _undo()
 	, _maxHintRows( REPLXX_MAX_HINT_ROWS )
 	, _breakChars( defaultBreakChars )
 	, _completionCountCutoff( 100 )
+	, _maxDisplayedCompletions( REPLXX_MAX_DISPLAYED_COMPLETIONS )
+	, _completionMenuRows( 0 )
+	, _menuItems()
+	, _menuSelection( 0 )
+	, _menuTop( 0 )
+	, _incrementalCompletion( false )
+	, _completionCache()
 	, _doubleTabCompletion( false )
 	, _completeOnEmpty( true )
 	, _beepOnAmbiguousCompletion( false )
 	, _noColor( false )
+	, _multiline( false )
+	, _completionRanking( false )
 	, _completionCallback( nullptr )
 	, _highlighterCallback( nullptr )
 	, _hintCallback( nullptr )
+	, _completionDictionary()
+	, _dictionaryHints( false )
+	, _completionSources()
+	, _threadPool()
+	, _highlighterDeadline( 0 )
+	, _hintDeadline( 0 )
+	, _highlighterCall()
+	, _hintCall()
+	, _terminal( descriptor( in_, 0 ), descriptor( out_, 1 ), descriptor( err_, 2 ) )
+	, _profiler( _terminal.counters() )
 	, _preloadedBuffer()
-	, _errorMessage() {
+	, _batchReader()
+	, _batch()
+	, _lastPrompt()
+	, _errorMessage()
+	, _previousSearchText() {
+	_history.set_word_break_characters( _breakChars );
 }
 
 void Replxx::ReplxxImpl::clear( void ) {
 	_pos = 0;
 	_prefix = 0;
+	int len( _data.length() );
 	_data.clear();
+	changed( 0, len, 0 );
 	_hintSelection = -1;
-	_hint = UnicodeString();
+	_hint.clear();
 	_display.clear();
+	reset_spans( _spans );
+	reset_spans( _inputSpans );
+	_completionCache.clear();
 }
 
-Replxx::ReplxxImpl::completions_t Replxx::ReplxxImpl::call_completer( std::string const& input, int& contextLen_ ) const {
-	Replxx::completions_t completionsIntermediary(
-		!! _completionCallback
-			? _completionCallback( input, contextLen_ )
-			: Replxx::completions_t()
-	);
-	completions_t completions;
-	completions.reserve( completionsIntermediary.size() );
-	for ( std::string const& c : completionsIntermediary ) {
-		completions.emplace_back( c.c_str() );
+/*
+ * Replace `removedLen_` characters of input at `pos_` with [first_, last_).
+ * Every edit made while editing goes through here and is journaled
+ * for undo, cursor should be moved only after the edit as undo puts
+ * it back where it was.
+ */
+template<typename iterator_t>
+void Replxx::ReplxxImpl::replace( int pos_, int removedLen_, iterator_t first_, iterator_t last_, bool typed_ ) {
+	int len( static_cast<int>( last_ - first_ ) );
+	// inserted characters go after removed ones first, journal takes both in one piece
+	_data.insert( pos_ + removedLen_, first_, last_ );
+	_undo.record( pos_, _data.get() + pos_, removedLen_, len, _pos, typed_ );
+	_data.erase( pos_, removedLen_ );
+	changed( pos_, removedLen_, len );
+}
+
+void Replxx::ReplxxImpl::erase( int pos_, int len_ ) {
+	char32_t const* none( nullptr );
+	replace( pos_, len_, none, none );
+}
+
+void Replxx::ReplxxImpl::set_input( UnicodeString const& text_ ) {
+	replace( 0, _data.length(), text_.get(), text_.get() + text_.length() );
+}
+
+/*
+ * Pass edit of the input to structures derived from it,
+ * `removedLen_` characters at `pos_` were replaced with `insertedLen_` ones.
+ */
+void Replxx::ReplxxImpl::changed( int pos_, int removedLen_, int insertedLen_ ) {
+	++ _generation;
+	_dataUtf8.changed( _data.get(), pos_, removedLen_, insertedLen_ );
+	_layout.changed( _data.get(), _data.length(), pos_, removedLen_, insertedLen_ );
+	_braceIndex.changed( pos_ );
+}
+
+/*
+ * With incremental completion enabled candidates fetched for a word
+ * are reused, and narrowed down, for as long as user only extends that word.
+ */
+void Replxx::ReplxxImpl::fetch_completions( int& contextLen_, CompletionCollector& collector_ ) {
+	if ( _incrementalCompletion && _completionCache.valid() ) {
+		UnicodeString const& anchor( _completionCache.anchor() );
+		bool extends( ( _pos >= anchor.length() ) && equal( anchor.begin(), anchor.end(), _data.begin() ) );
+		for ( int i( anchor.length() ); extends && ( i < _pos ); ++ i ) {
+			extends = ! is_word_break_character( _data[i] );
+		}
+		if ( extends ) {
+			contextLen_ = _completionCache.context_length() + _pos - anchor.length();
+			Utf8String prefix( UnicodeString( _data.get() + _pos - contextLen_, contextLen_ ) );
+			_completionCache.filter( prefix.get(), collector_ );
+			return;
+		}
+	}
+	_utf8Buffer.assign( _data, _pos );
+	if ( ! _incrementalCompletion ) {
+		call_completer( _utf8Buffer.get(), contextLen_, collector_ );
+		return;
+	}
+	CompletionCache::Recorder recorder( _completionCache, collector_ );
+	call_completer( _utf8Buffer.get(), contextLen_, recorder );
+	if ( ( collector_.count() > 0 ) && ( contextLen_ >= 0 ) && ( contextLen_ <= _pos ) ) {
+		_completionCache.commit( UnicodeString( _data.get(), _pos ), contextLen_ );
 	}
-	return ( completions );
 }
 
-Replxx::ReplxxImpl::hints_t Replxx::ReplxxImpl::call_hinter( std::string const& input, int& contextLen, Replxx::Color& color ) const {
-	Replxx::hints_t hintsIntermediary(
-		!! _hintCallback
-			? _hintCallback( input, contextLen, color )
-			: Replxx::hints_t()
-	);
+void Replxx::ReplxxImpl::call_completer( std::string const& input, int& contextLen_, Replxx::CompletionSink& completions_ ) {
+	if ( ! _completionSources.empty() ) {
+		call_completion_sources( input, contextLen_, completions_ );
+	} else if ( !! _completionCallback ) {
+		_completionCallback( input, contextLen_, completions_ );
+	} else if ( !! _completionDictionary ) {
+		Utf8String prefix( UnicodeString( _data.get() + _pos - contextLen_, contextLen_ ) );
+		_completionDictionary->snapshot()->complete(
+			prefix.get(),
+			[&completions_]( std::string const& c_ ) {
+				completions_.add( c_ );
+				return ( true );
+			}
+		);
+	}
+}
+
+/*
+ * Run all completion sources in parallel and merge their results,
+ * higher priority first, dropping duplicates.
+ * Main completion callback runs on this thread with priority 0
+ * while the sources are busy, dictionary is streamed when its turn comes.
+ * Source that misses its deadline, or is still busy with previous request,
+ * contributes nothing this time.
+ * Completions are taken only from sources which agree on context length
+ * with the highest priority source that produced any completions.
+ */
+void Replxx::ReplxxImpl::call_completion_sources( std::string const& input_, int& contextLen_, Replxx::CompletionSink& completions_ ) {
+	typedef std::chrono::steady_clock clock_t;
+	clock_t::time_point start( clock_t::now() );
+	_threadPool.ensure_size( worker_count() );
+	std::vector<std::shared_ptr<CompletionJob>> jobs;
+	for ( CompletionSource& source : _completionSources ) {
+		if ( !! source.job ) {
+			std::lock_guard<std::mutex> l( source.job->mutex );
+			if ( ! source.job->finished ) {
+				jobs.push_back( nullptr );
+				continue;
+			}
+		}
+		std::shared_ptr<CompletionJob> job( std::make_shared<CompletionJob>( contextLen_ ) );
+		source.job = job;
+		jobs.push_back( job );
+		Replxx::streaming_completion_callback_t callback( source.callback );
+		_threadPool.post(
+			[job, callback, input_]() {
+				CompletionList completions;
+				int contextLen( job->contextLen );
+				callback( input_, contextLen, completions );
+				std::lock_guard<std::mutex> l( job->mutex );
+				job->completions.swap( completions.data );
+				job->contextLen = contextLen;
+				job->finished = true;
+				job->done.notify_all();
+			}
+		);
+	}
+	CompletionJob local( contextLen_ );
+	if ( !! _completionCallback ) {
+		CompletionList completions;
+		_completionCallback( input_, local.contextLen, completions );
+		local.completions.swap( completions.data );
+	}
+	bool localMerged( false );
+	bool haveContext( false );
+	std::unordered_set<std::string> seen;
+	auto accept = [&]( int jobContextLen_ ) {
+		if ( ! haveContext ) {
+			contextLen_ = jobContextLen_;
+			haveContext = true;
+		}
+		return ( jobContextLen_ == contextLen_ );
+	};
+	auto add = [&]( std::string const& c_ ) {
+		if ( seen.insert( c_ ).second ) {
+			completions_.add( c_ );
+		}
+	};
+	auto merge = [&]( CompletionJob const& job_ ) {
+		if ( job_.completions.empty() || ! accept( job_.contextLen ) ) {
+			return;
+		}
+		for ( std::string const& c : job_.completions ) {
+			add( c );
+		}
+	};
+	auto merge_local = [&]() {
+		localMerged = true;
+		if ( ! _completionDictionary || !! _completionCallback ) {
+			merge( local );
+			return;
+		}
+		if ( haveContext && ( local.contextLen != contextLen_ ) ) {
+			return;
+		}
+		Utf8String prefix( UnicodeString( _data.get() + _pos - local.contextLen, local.contextLen ) );
+		_completionDictionary->snapshot()->complete(
+			prefix.get(),
+			[&]( std::string const& c_ ) {
+				accept( local.contextLen );
+				add( c_ );
+				return ( true );
+			}
+		);
+	};
+	for ( int i( 0 ), count( static_cast<int>( _completionSources.size() ) ); i < count; ++ i ) {
+		CompletionSource const& source( _completionSources[i] );
+		if ( ! localMerged && ( source.priority < 0 ) ) {
+			merge_local();
+		}
+		std::shared_ptr<CompletionJob> const& job( jobs[i] );
+		if ( ! job ) {
+			continue;
+		}
+		std::unique_lock<std::mutex> l( job->mutex );
+		if ( job->done.wait_until( l, start + std::chrono::milliseconds( source.deadline ), [&job]() { return ( job->finished ); } ) ) {
+			merge( *job );
+		}
+	}
+	if ( ! localMerged ) {
+		merge_local();
+	}
+}
+
+/*
+ * Each completion source and each deadline bounded callback
+ * can keep one worker busy.
+ */
+int Replxx::ReplxxImpl::worker_count( void ) const {
+	return ( static_cast<int>( _completionSources.size() ) + 2 );
+}
+
+Replxx::ReplxxImpl::hints_t Replxx::ReplxxImpl::call_hinter( std::string const& input, int& contextLen, Replxx::Color& color ) {
+	Replxx::hints_t hintsIntermediary;
+	if ( !! _hintCallback && ( _hintDeadline > 0 ) ) {
+		_threadPool.ensure_size( worker_count() );
+		Replxx::hint_callback_t callback( _hintCallback );
+		HintResult request{ input, Replxx::hints_t(), contextLen, color };
+		HintResult result;
+		bool fresh(
+			_hintCall.call(
+				_threadPool, _hintDeadline, input + '\0' + to_string( contextLen ),
+				[callback, request]() {
+					HintResult r( request );
+					r.hints = callback( r.input, r.contextLen, r.color );
+					return ( r );
+				},
+				result
+			)
+		);
+		if ( fresh ) {
+			hintsIntermediary.swap( result.hints );
+			contextLen = result.contextLen;
+			color = result.color;
+		} else if ( ( input.length() >= result.input.length() ) && ( input.compare( 0, result.input.length(), result.input ) == 0 ) ) {
+			// hints for earlier input are still valid if they match extended context
+			int staleContextLen( result.contextLen + UnicodeString( input.substr( result.input.length() ) ).length() );
+			if ( staleContextLen <= _pos ) {
+				contextLen = staleContextLen;
+				color = result.color;
+				Utf8String context( UnicodeString( _data.get() + _pos - contextLen, contextLen ) );
+				std::string prefix( context.get() );
+				for ( std::string& h : result.hints ) {
+					if ( h.compare( 0, prefix.length(), prefix ) == 0 ) {
+						hintsIntermediary.push_back( std::move( h ) );
+					}
+				}
+			}
+		}
+	} else if ( !! _hintCallback ) {
+		hintsIntermediary = _hintCallback( input, contextLen, color );
+	} else if ( _dictionaryHints && !! _completionDictionary && ( contextLen > 0 ) ) {
+		Utf8String prefix( UnicodeString( _data.get() + _pos - contextLen, contextLen ) );
+		hintsIntermediary = _completionDictionary->snapshot()->complete_weighted( prefix.get(), max( _maxHintRows, 1 ) );
+	}
+	rank( hintsIntermediary );
 	hints_t hints;
 	hints.reserve( hintsIntermediary.size() );
 	for ( std::string const& h : hintsIntermediary ) {
@@ -148,6 +418,34 @@ Replxx::ReplxxImpl::hints_t Replxx::ReplxxImpl::call_hinter( std::string const&
 	return ( hints );
 }
 
+/*
+ * Stable sort candidates by their usage in history,
+ * candidates never seen in history keep their original order.
+ */
+void Replxx::ReplxxImpl::rank( std::vector<std::string>& candidates_ ) const {
+	if ( ! _completionRanking || ( candidates_.size() < 2 ) ) {
+		return;
+	}
+	typedef std::pair<double, int> score_t;
+	std::vector<score_t> scores;
+	scores.reserve( candidates_.size() );
+	for ( int i( 0 ), count( static_cast<int>( candidates_.size() ) ); i < count; ++ i ) {
+		scores.emplace_back( _history.token_score( candidates_[i] ), i );
+	}
+	std::stable_sort(
+		scores.begin(), scores.end(),
+		[]( score_t const& l, score_t const& r ) {
+			return ( l.first > r.first );
+		}
+	);
+	std::vector<std::string> ranked;
+	ranked.reserve( candidates_.size() );
+	for ( score_t const& s : scores ) {
+		ranked.push_back( std::move( candidates_[s.second] ) );
+	}
+	candidates_.swap( ranked );
+}
+
 void Replxx::ReplxxImpl::set_preload_buffer( std::string const& preloadText ) {
 	_preloadedBuffer = preloadText;
 	// remove characters that won't display correctly
@@ -187,42 +485,78 @@ void Replxx::ReplxxImpl::set_preload_buffer( std::string const& preloadText ) {
 	}
 }
 
+/*
+ * Next line of non-interactive input, text given to set_preload_buffer() comes first.
+ */
 char const* Replxx::ReplxxImpl::read_from_stdin( void ) {
-	if ( _preloadedBuffer.empty() ) {
-		getline( cin, _preloadedBuffer );
-		if ( ! cin.good() ) {
-			return nullptr;
+	if ( ! _preloadedBuffer.empty() ) {
+		while ( ! _preloadedBuffer.empty() && ( ( _preloadedBuffer.back() == '\r' ) || ( _preloadedBuffer.back() == '\n' ) ) ) {
+			_preloadedBuffer.pop_back();
 		}
+		_utf8Buffer.assign( _preloadedBuffer );
+		_preloadedBuffer.clear();
+		return _utf8Buffer.get();
 	}
-	while ( ! _preloadedBuffer.empty() && ( ( _preloadedBuffer.back() == '\r' ) || ( _preloadedBuffer.back() == '\n' ) ) ) {
-		_preloadedBuffer.pop_back();
+	if ( read_batch( 1 ) == 0 ) {
+		return nullptr;
 	}
-	_utf8Buffer.assign( _preloadedBuffer );
-	_preloadedBuffer.clear();
+	_utf8Buffer.assign( _batch.front().data, _batch.front().length );
 	return _utf8Buffer.get();
 }
 
+int Replxx::ReplxxImpl::read_batch( int count_ ) {
+	// output of previous lines goes first, as with std::cin tied to std::cout, once per batch
+	fflush( stdout );
+	if ( ! _batchReader ) {
+		_batchReader.reset( new BatchReader( _terminal.input_fd() ) );
+	}
+	return ( _batchReader->read( _batch, count_ > 0 ? count_ : 1 ) );
+}
+
+Replxx::lines_t const& Replxx::ReplxxImpl::input_batch( std::string const& prompt, int count ) {
+	if ( _terminal.input_is_tty() || ! _preloadedBuffer.empty() ) {
+		char const* line( input( prompt ) );
+		_batch.clear();
+		if ( line ) {
+			_batch.push_back( Replxx::LineView{ line, static_cast<int>( strlen( line ) ) } );
+		}
+		return ( _batch );
+	}
+	errno = 0;
+	read_batch( count );
+	return ( _batch );
+}
+
 char const* Replxx::ReplxxImpl::input( std::string const& prompt ) {
-#ifndef _WIN32
-	gotResize = false;
-#endif
+	// prompt is parsed again only when it changes
+	if ( prompt != _lastPrompt.text() ) {
+		_lastPrompt = Replxx::Prompt( prompt );
+	}
+	return ( input( _lastPrompt ) );
+}
+
+char const* Replxx::ReplxxImpl::input( Replxx::Prompt const& prompt ) {
+	// only window size changes during this input() are of interest
+	static_cast<void>( _terminal.got_resize() );
 	try {
 		errno = 0;
-		if ( ! tty::in ) { // input not from a terminal, we should work with piped input, i.e. redirected stdin
+		if ( ! _terminal.input_is_tty() ) { // input not from a terminal, we should work with piped input, i.e. redirected stdin
 			return ( read_from_stdin() );
 		}
 		if (!_errorMessage.empty()) {
-			printf("%s", _errorMessage.c_str());
+			// output of previous lines goes first
 			fflush(stdout);
+			_terminal.write8( _errorMessage.data(), static_cast<int>( _errorMessage.size() ) );
 			_errorMessage.clear();
 		}
-		PromptInfo pi(prompt, getScreenColumns());
+		PromptInfo pi( prompt.impl(), _terminal, _terminal.screen_columns() );
+		pi.promptScreenRows = _terminal.screen_rows();
 		if ( isUnsupportedTerm() ) {
 			pi.write();
 			fflush(stdout);
 			return ( read_from_stdin() );
 		}
-		if (enableRawMode() == -1) {
+		if (_terminal.enableRawMode() == -1) {
 			return nullptr;
 		}
 		clear();
@@ -233,84 +567,174 @@ char const* Replxx::ReplxxImpl::input( std::string const& prompt ) {
 		if ( getInputLine(pi) == -1 ) {
 			return ( nullptr );
 		}
-		disableRawMode();
-		printf("\n");
+		_terminal.disableRawMode();
+		_terminal.write8( "\n", 1 );
 		_utf8Buffer.assign( _data );
 		return ( _utf8Buffer.get() );
 	} catch ( std::exception const& ) {
-		disableRawMode();
+		_terminal.disableRawMode();
 		return ( nullptr );
 	}
 }
 
 void Replxx::ReplxxImpl::clear_screen( void ) {
-	replxx::clear_screen( CLEAR_SCREEN::WHOLE );
+	_terminal.clear_screen( CLEAR_SCREEN::WHOLE );
 }
 
 int Replxx::ReplxxImpl::install_window_change_handler( void ) {
-#ifndef _WIN32
-	struct sigaction sa;
-	sigemptyset(&sa.sa_mask);
-	sa.sa_flags = 0;
-	sa.sa_handler = &WindowSizeChanged;
-
-	if (sigaction(SIGWINCH, &sa, nullptr) == -1) {
-		return errno;
-	}
-#endif
-	return 0;
+	return ( _terminal.install_window_change_handler() );
 }
 
 int Replxx::ReplxxImpl::print( char const* str_, int size_ ) {
-#ifdef _WIN32
-	int count( win_write( str_, size_ ) );
-#else
-	int count( write( 1, str_, size_ ) );
-#endif
-	return ( count );
+	try {
+		_terminal.write8( str_, size_ );
+	} catch ( std::runtime_error const& ) {
+		return ( -1 );
+	}
+	return ( size_ );
 }
 
 void Replxx::ReplxxImpl::preloadBuffer(const char* preloadText) {
+	int len( _data.length() );
 	_data.assign( preloadText );
+	changed( 0, len, _data.length() );
 	_charWidths.resize( _data.length() );
 	recomputeCharacterWidths( _data.get(), _charWidths.data(), _data.length() );
 	_prefix = _pos = _data.length();
 }
 
 void Replxx::ReplxxImpl::setColor( Replxx::Color color_ ) {
-	char const* code( ansi_color( color_ ) );
-	while ( *code ) {
-		_display.push_back( *code );
-		++ code;
-	}
+	add_span( _spans, static_cast<int>( _display.size() ), _attrs.mark( color_ ) );
+}
+
+/*
+ * Write patch text, attribute markers are sent as minimal SGR changes.
+ */
+void Replxx::ReplxxImpl::write_display( char32_t const* text_, int len_ ) {
+	_encoded.clear();
+	_attrs.encode( text_, len_, _encoded );
+	_terminal.write8( _encoded.data(), static_cast<int>( _encoded.size() ) );
+}
+
+/*
+ * Write whole `_display`, escape sequences are generated only at boundaries of its runs,
+ * input it starts with is copied from its UTF-8 mirror.
+ */
+void Replxx::ReplxxImpl::write_display( void ) {
+	_encoded.clear();
+	_attrs.encode( _display.data(), static_cast<int>( _display.size() ), _spans, _dataUtf8, _encoded );
+	_terminal.write8( _encoded.data(), static_cast<int>( _encoded.size() ) );
 }
 
 void Replxx::ReplxxImpl::highlight( int highlightIdx, bool error_ ) {
-	Replxx::colors_t colors( _data.length(), Replxx::Color::DEFAULT );
-	_utf8Buffer.assign( _data );
-	if ( !! _highlighterCallback ) {
-		_highlighterCallback( _utf8Buffer.get(), colors );
+	Profiler::Scope scope( _profiler, Replxx::Stats::PHASE::HIGHLIGHT );
+	Replxx::colors_t& colors( _colors );
+	colors.assign( _data.length(), Replxx::Color::DEFAULT );
+	if ( !! _highlighterCallback && ( _highlighterDeadline > 0 ) ) {
+		_threadPool.ensure_size( worker_count() );
+		Replxx::highlighter_callback_t callback( _highlighterCallback );
+		std::string input( _dataUtf8.data(), _dataUtf8.size() );
+		int len( _data.length() );
+		_highlighterCall.call(
+			_threadPool, _highlighterDeadline, input,
+			[callback, input, len]() {
+				Replxx::colors_t c( len, Replxx::Color::DEFAULT );
+				callback( input, c );
+				return ( c );
+			},
+			colors
+		);
+		// colors computed for different input are reused as they are
+		colors.resize( _data.length(), Replxx::Color::DEFAULT );
+	} else if ( !! _highlighterCallback ) {
+		_callbackInput.assign( _dataUtf8.data(), _dataUtf8.size() );
+		_highlighterCallback( _callbackInput, colors );
 	}
-	if ( highlightIdx != -1 ) {
-		colors[highlightIdx] = error_ ? Replxx::Color::ERROR : Replxx::Color::BRIGHTRED;
+	if ( _attrs.size() >= AttrTable::MAX_SIZE ) {
+		// runs on screen refer to attributes being dropped
+		_attrs.clear();
+		_renderedGeneration = -1;
 	}
-	_display.clear();
+	reset_spans( _inputSpans );
 	Replxx::Color c( Replxx::Color::DEFAULT );
-	for ( int i( 0 ); i < _data.length(); ++ i ) {
+	for ( int i( 0 ), len( _data.length() ); i < len; ++ i ) {
 		if ( colors[i] != c ) {
 			c = colors[i];
-			setColor( c );
+			add_span( _inputSpans, i, _attrs.mark( c ) );
+		}
+	}
+	add_span( _inputSpans, _data.length(), AttrTable::RESET );
+	render_display( highlightIdx, error_ );
+}
+
+/*
+ * Build `_display` from input and runs of last highlight(),
+ * brace at `highlightIdx` is laid over them in its own color.
+ */
+void Replxx::ReplxxImpl::render_display( int highlightIdx, bool error_ ) {
+	_display.assign( _data.get(), _data.get() + _data.length() );
+	_displayRows = 0;
+	if ( highlightIdx < 0 ) {
+		_spans = _inputSpans;
+		return;
+	}
+	reset_spans( _spans );
+	int i( 0 );
+	int count( static_cast<int>( _inputSpans.size() ) );
+	for ( ; ( i < count ) && ( _inputSpans[i].start <= highlightIdx ); ++ i ) {
+		add_span( _spans, _inputSpans[i].start, _inputSpans[i].attr );
+	}
+	add_span( _spans, highlightIdx, _attrs.mark( error_ ? Replxx::Color::ERROR : Replxx::Color::BRIGHTRED ) );
+	add_span( _spans, highlightIdx + 1, _inputSpans[span_at( _inputSpans, highlightIdx + 1 )].attr );
+	for ( ; i < count; ++ i ) {
+		if ( _inputSpans[i].start > ( highlightIdx + 1 ) ) {
+			add_span( _spans, _inputSpans[i].start, _inputSpans[i].attr );
+		}
+	}
+}
+
+/*
+ * Read next keystroke, time until following read_keystroke()
+ * is attributed to it in latency statistics.
+ */
+char32_t Replxx::ReplxxImpl::read_keystroke( void ) {
+	_profiler.end_keystroke();
+	if ( _profiler.enabled() ) {
+		// keystroke latency is measured from arrival of its first byte
+		_terminal.wait_for_input( -1 );
+	}
+	_profiler.begin_keystroke();
+	char32_t c( _terminal.read_char() );
+	_profiler.end_read( static_cast<int>( c ) );
+	return ( c );
+}
+
+/*
+ * Repaint as soon as late highlighter or hint results arrive,
+ * return when user input is available.
+ */
+void Replxx::ReplxxImpl::repaint_on_late_results( PromptBase& pi ) {
+	while ( true ) {
+		bool highlighterBusy( _highlighterCall.in_flight() );
+		bool hintBusy( _hintCall.in_flight() );
+		if ( ! highlighterBusy && ! hintBusy ) {
+			break;
+		}
+		if ( _terminal.wait_for_input( REPLXX_LATE_RESULT_POLL_INTERVAL ) ) {
+			break;
+		}
+		if ( ( highlighterBusy && ! _highlighterCall.in_flight() ) || ( hintBusy && ! _hintCall.in_flight() ) ) {
+			refreshLine( pi, HINT_ACTION::REPAINT );
 		}
-		_display.push_back( _data[i] );
 	}
-	setColor( Replxx::Color::DEFAULT );
 }
 
 int Replxx::ReplxxImpl::handle_hints( PromptBase& pi, HINT_ACTION hintAction_ ) {
+	Profiler::Scope scope( _profiler, Replxx::Stats::PHASE::HINT );
 	if ( _noColor ) {
 		return ( 0 );
 	}
-	if ( ! _hintCallback ) {
+	if ( ! has_hinter() ) {
 		return ( 0 );
 	}
 	if ( hintAction_ == HINT_ACTION::SKIP ) {
@@ -319,15 +743,16 @@ int Replxx::ReplxxImpl::handle_hints( PromptBase& pi, HINT_ACTION hintAction_ )
 	if ( _pos != _data.length() ) {
 		return ( 0 );
 	}
-	_hint = UnicodeString();
+	_hint.clear();
 	int len( 0 );
 	if ( hintAction_ == HINT_ACTION::REGENERATE ) {
 		_hintSelection = -1;
 	}
 	Replxx::Color c( Replxx::Color::GRAY );
-	_utf8Buffer.assign( _data, _pos );
 	int contextLen( context_length() );
-	Replxx::ReplxxImpl::hints_t hints( call_hinter( _utf8Buffer.get(), contextLen, c ) );
+	// input is mirrored by highlight() preceding hints
+	_callbackInput.assign( _dataUtf8.data(), _dataUtf8.offset( _pos ) );
+	Replxx::ReplxxImpl::hints_t hints( call_hinter( _callbackInput, contextLen, c ) );
 	int hintCount( hints.size() );
 	if ( hintCount == 1 ) {
 		setColor( c );
@@ -357,6 +782,7 @@ int Replxx::ReplxxImpl::handle_hints( PromptBase& pi, HINT_ACTION hintAction_ )
 			}
 		}
 		setColor( Replxx::Color::DEFAULT );
+		_displayRows += min( hintCount, _maxHintRows );
 		for ( int hintRow( 0 ); hintRow < min( hintCount, _maxHintRows ); ++ hintRow ) {
 #ifdef _WIN32
 			_display.push_back( '\r' );
@@ -397,140 +823,870 @@ void Replxx::ReplxxImpl::refreshLine(PromptBase& pi, HINT_ACTION hintAction_) {
 	int highlightIdx = -1;
 	bool indicateError = false;
 	if (_pos < _data.length()) {
-		/* this scans for a brace matching _data[_pos] to highlight */
-		unsigned char part1, part2;
-		int scanDirection = 0;
-		if (strchr("}])", _data[_pos])) {
-			scanDirection = -1; /* backwards */
-			if (_data[_pos] == '}') {
-				part1 = '}'; part2 = '{';
-			} else if (_data[_pos] == ']') {
-				part1 = ']'; part2 = '[';
-			} else {
-				part1 = ')'; part2 = '(';
+		_braceIndex.update( _data.get(), _data.length() );
+		highlightIdx = _braceIndex.match( _pos, indicateError );
+	}
+
+	highlight( highlightIdx, indicateError );
+	int hintLen( handle_hints( pi, hintAction_ ) );
+	if ( ! _menuItems.empty() ) {
+		render_menu( pi );
+	}
+	paint( pi, hintLen );
+#ifndef _WIN32
+	_renderedBrace = highlightIdx;
+	_renderedBraceError = indicateError;
+#endif
+}
+
+/*
+ * Start or end of logical line containing the cursor,
+ * whole input is a single line unless multi-line editing is enabled.
+ */
+int Replxx::ReplxxImpl::line_boundary( PromptBase& pi, bool end_ ) {
+	if ( ! _multiline ) {
+		return ( end_ ? _data.length() : 0 );
+	}
+	_layout.update( _data.get(), _data.length(), pi.promptIndentation, pi.promptScreenColumns );
+	int line( _layout.line_of( _pos ) );
+	return ( end_ ? _layout.line_end( line ) : _layout.line_start( line ) );
+}
+
+/*
+ * Move cursor to previous or next logical line keeping its column,
+ * false if there is no such line.
+ */
+bool Replxx::ReplxxImpl::move_line( PromptBase& pi, bool up_ ) {
+	_layout.update( _data.get(), _data.length(), pi.promptIndentation, pi.promptScreenColumns );
+	int line( _layout.line_of( _pos ) + ( up_ ? -1 : 1 ) );
+	if ( ( line < 0 ) || ( line >= _layout.line_count() ) ) {
+		return ( false );
+	}
+	_pos = _layout.pos_at( line, _layout.column( _pos ) );
+	refresh_cursor( pi );
+	return ( true );
+}
+
+/*
+ * Show the cursor at `_pos` after it moved over unchanged input.
+ */
+void Replxx::ReplxxImpl::refresh_cursor( PromptBase& pi ) {
+#ifndef _WIN32
+	if ( move_cursor( pi ) ) {
+		return;
+	}
+#endif
+	refreshLine( pi );
+}
+
+/*
+ * Put prepared `_display` on screen replacing previous input line.
+ */
+void Replxx::ReplxxImpl::paint( PromptBase& pi, int hintLen ) {
+	Profiler::Scope layoutScope( _profiler, Replxx::Stats::PHASE::LAYOUT );
+	_layout.update( _data.get(), _data.length(), pi.promptIndentation, pi.promptScreenColumns );
+	// calculate the position of the end of the input line
+	int xEndOfInput( 0 ), yEndOfInput( 0 );
+	_layout.position( _data.length(), xEndOfInput, yEndOfInput, hintLen );
+	yEndOfInput += _displayRows;
+
+	// calculate the desired position of the cursor
+	int xCursorPos( 0 ), yCursorPos( 0 );
+	_layout.position( _pos, xCursorPos, yCursorPos );
+	layoutScope.stop();
+
+#ifdef _WIN32
+	// position at the end of the prompt, clear to end of previous input
+	CONSOLE_SCREEN_BUFFER_INFO inf;
+	GetConsoleScreenBufferInfo(_terminal.console_out(), &inf);
+	inf.dwCursorPosition.X = pi.promptIndentation; // 0-based on Win32
+	inf.dwCursorPosition.Y -= pi.promptCursorRowOffset - pi.promptExtraLines;
+	SetConsoleCursorPosition(_terminal.console_out(), inf.dwCursorPosition);
+	_terminal.clear_screen( CLEAR_SCREEN::TO_END );
+	pi.promptPreviousInputLen = _data.length();
+
+	// display the input line
+	if ( !_noColor ) {
+		write_display();
+	} else {
+		_terminal.write8( _dataUtf8.data(), _dataUtf8.size() );
+	}
+
+	// position the cursor
+	GetConsoleScreenBufferInfo(_terminal.console_out(), &inf);
+	inf.dwCursorPosition.X = xCursorPos; // 0-based on Win32
+	inf.dwCursorPosition.Y -= ( yEndOfInput - yCursorPos );
+	SetConsoleCursorPosition(_terminal.console_out(), inf.dwCursorPosition);
+#else // _WIN32
+	if ( ( _viewportTop >= 0 ) && ( _renderedBytes != _terminal.screen_bytes() ) ) {
+		// screen was written over, rows of the viewport are gone
+		_viewportTop = -1;
+	}
+	if ( ( pi.promptScreenRows > 2 ) && ( yEndOfInput >= pi.promptScreenRows ) ) {
+		paint_viewport( pi, xCursorPos, yCursorPos );
+	} else {
+		if ( _viewportTop >= 0 ) {
+			leave_viewport( pi );
+		}
+		if ( _layout.line_count() > 1 ) {
+			paint_lines( pi, hintLen, yEndOfInput, xCursorPos, yCursorPos );
+		} else {
+			char seq[64];
+			int cursorRowMovement = pi.promptCursorRowOffset - pi.promptExtraLines;
+			if (cursorRowMovement > 0) { // move the cursor up as required
+				snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
+				_terminal.write8( seq, strlen(seq) );
+			}
+			// position at the end of the prompt, clear to end of screen
+			snprintf(
+				seq, sizeof seq, "\x1b[%dG\x1b[%c",
+				pi.promptIndentation + 1, /* 1-based on VT100 */
+				'J'
+			);
+			_terminal.write8( seq, strlen(seq) );
+
+			if ( !_noColor ) {
+				write_display();
+			} else { // highlightIdx the matching brace/bracket/parenthesis
+				_terminal.write8( _dataUtf8.data(), _dataUtf8.size() );
+			}
+
+			// we have to generate our own newline on line wrap
+			if (xEndOfInput == 0 && yEndOfInput > 0) {
+				_terminal.write8( "\n", 1 );
+			}
+
+			// position the cursor
+			cursorRowMovement = yEndOfInput - yCursorPos;
+			if (cursorRowMovement > 0) { // move the cursor up as required
+				snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
+				_terminal.write8( seq, strlen(seq) );
+			}
+			// position the cursor within the line
+			snprintf(seq, sizeof seq, "\x1b[%dG", xCursorPos + 1); // 1-based on VT100
+			_terminal.write8( seq, strlen(seq) );
+		}
+	}
+
+	// remember what is on screen so that next keystroke can patch it
+	remember_screen();
+	_renderedGeneration = _generation;
+	_renderedBytes = _terminal.screen_bytes();
+	_renderedPos = _pos;
+	_renderedRows = yEndOfInput;
+	_renderedBrace = -1;
+	_renderedBraceError = false;
+	_renderedLineRows.resize( _layout.line_count() );
+	for ( int i( 0 ), count( _layout.line_count() ); i < count; ++ i ) {
+		_renderedLineRows[i] = _layout.line_row( i );
+	}
+#endif
+
+	pi.promptCursorRowOffset = pi.promptExtraLines + viewport_row( yCursorPos ); // remember row for next pass
+}
+
+/*
+ * Screen row, relative to the row of the prompt end, showing input row `y`.
+ */
+int Replxx::ReplxxImpl::viewport_row( int y ) const {
+	if ( _viewportTop < 0 ) {
+		return ( y );
+	}
+	// first row shows scroll indicator unless viewport starts at the prompt
+	return ( y - _viewportTop + ( _viewportTop > 0 ? 1 : 0 ) );
+}
+
+#ifndef _WIN32
+namespace {
+
+/*
+ * Split display into cells, fails on control characters.
+ */
+bool to_cells( Replxx::ReplxxImpl::display_t const& display_, attr_spans_t const& spans_, Replxx::ReplxxImpl::cells_t& cells_ ) {
+	cells_.clear();
+	int len( static_cast<int>( display_.size() ) );
+	int spanCount( static_cast<int>( spans_.size() ) );
+	for ( int s( 0 ); s < spanCount; ++ s ) {
+		int end( ( s + 1 ) < spanCount ? min( spans_[s + 1].start, len ) : len );
+		for ( int i( spans_[s].start ); i < end; ++ i ) {
+			char32_t c( display_[i] );
+			if ( ( c < ' ' ) || ( c == 127 ) ) {
+				return ( false );
+			}
+			cells_.push_back( Replxx::ReplxxImpl::Cell{ c, spans_[s].attr } );
+		}
+	}
+	return ( true );
+}
+
+/*
+ * Append text from `from_` to `to_` to a patch, attributes of `spans_`
+ * become markers at boundaries of its runs, none if `spans_` is null.
+ */
+void append_text( Replxx::ReplxxImpl::display_t& out_, char32_t const* text_, attr_spans_t const* spans_, int from_, int to_ ) {
+	if ( ! spans_ ) {
+		out_.insert( out_.end(), text_ + from_, text_ + to_ );
+		return;
+	}
+	int s( span_at( *spans_, from_ ) );
+	int spanCount( static_cast<int>( spans_->size() ) );
+	while ( from_ < to_ ) {
+		int end( ( s + 1 ) < spanCount ? min( ( *spans_ )[s + 1].start, to_ ) : to_ );
+		out_.push_back( ( *spans_ )[s].attr );
+		out_.insert( out_.end(), text_ + from_, text_ + end );
+		from_ = end;
+		++ s;
+	}
+}
+
+/*
+ * Tell if text from `from_` to `to_` with attributes of `spans_`,
+ * none if `spans_` is null, is what `cells_` show.
+ */
+bool same_cells( char32_t const* text_, attr_spans_t const* spans_, int from_, int to_, Replxx::ReplxxImpl::Cell const* cells_ ) {
+	int s( spans_ ? span_at( *spans_, from_ ) : 0 );
+	int spanCount( spans_ ? static_cast<int>( spans_->size() ) : 0 );
+	for ( int i( from_ ); i < to_; ++ i, ++ cells_ ) {
+		while ( ( ( s + 1 ) < spanCount ) && ( ( *spans_ )[s + 1].start <= i ) ) {
+			++ s;
+		}
+		char32_t attr( spans_ ? ( *spans_ )[s].attr : AttrTable::RESET );
+		if ( ( cells_->ch != text_[i] ) || ( cells_->attr != attr ) ) {
+			return ( false );
+		}
+	}
+	return ( true );
+}
+
+}
+
+/*
+ * Character `c` was appended to the input line which is still as last painted,
+ * echo it right away, then compute highlighting and hints and send only cells
+ * that differ from what is on screen.
+ */
+bool Replxx::ReplxxImpl::echo_and_patch( PromptBase& pi, char32_t c ) {
+	if (
+		// the only edit since last paint appended `c`
+		( _renderedGeneration != ( _generation - 1 ) )
+		|| _renderedLines.empty()
+		|| ( _renderedBytes != _terminal.screen_bytes() )
+		|| _noColor
+		|| ! _menuItems.empty()
+		|| ( _renderedRows != 0 )
+		|| ( _pos != _data.length() )
+		|| ( _renderedPos != ( _data.length() - 1 ) )
+		|| ( calculateColumnPosition( &c, 1 ) != 1 )
+		|| ( pi.promptIndentation + _data.length() >= pi.promptScreenColumns )
+	) {
+		return ( false );
+	}
+	_terminal.write32( &c, 1 );
+	cells_t& screen( _screenCells );
+	cells_t& wanted( _wantedCells );
+	for ( Cell const& cell : screen ) {
+		if ( ( cell.ch < ' ' ) || ( cell.ch == 127 ) ) {
+			_renderedGeneration = -1;
+			refreshLine( pi );
+			return ( true );
+		}
+	}
+	Cell echoed{ c, AttrTable::RESET };
+	int echoIdx( _data.length() - 1 );
+	if ( echoIdx < static_cast<int>( screen.size() ) ) {
+		screen[echoIdx] = echoed;
+	} else {
+		screen.push_back( echoed );
+	}
+	highlight( -1, false );
+	int hintLen( handle_hints( pi, HINT_ACTION::REGENERATE ) );
+	Profiler::Scope layoutScope( _profiler, Replxx::Stats::PHASE::LAYOUT );
+	bool narrow( ( _renderedGeneration >= 0 ) && to_cells( _display, _spans, wanted ) );
+	for ( int i( 0 ), count( static_cast<int>( wanted.size() ) ); narrow && ( i < count ); ++ i ) {
+		narrow = calculateColumnPosition( &wanted[i].ch, 1 ) == 1;
+	}
+	if ( ! narrow || ( pi.promptIndentation + static_cast<int>( wanted.size() ) >= pi.promptScreenColumns ) ) {
+		// multi row hints or wide characters, fall back to full repaint
+		layoutScope.stop();
+		paint( pi, hintLen );
+		return ( true );
+	}
+	int first( 0 );
+	int common( static_cast<int>( min( screen.size(), wanted.size() ) ) );
+	while ( ( first < common ) && ( screen[first] == wanted[first] ) ) {
+		++ first;
+	}
+	if ( ( first < static_cast<int>( wanted.size() ) ) || ( screen.size() > wanted.size() ) ) {
+		display_t& patch( _patch );
+		patch.clear();
+		char seq[32];
+		auto append = [&patch]( char const* s ) {
+			while ( *s ) {
+				patch.push_back( static_cast<char32_t>( *s ) );
+				++ s;
+			}
+		};
+		snprintf( seq, sizeof seq, "\x1b[%dG", pi.promptIndentation + first + 1 );
+		append( seq );
+		char32_t attr( AttrTable::RESET );
+		for ( int i( first ), count( static_cast<int>( wanted.size() ) ); i < count; ++ i ) {
+			Cell const& cell( wanted[i] );
+			if ( cell.attr != attr ) {
+				attr = cell.attr;
+				patch.push_back( attr );
+			}
+			patch.push_back( cell.ch );
+		}
+		if ( attr != AttrTable::RESET ) {
+			patch.push_back( AttrTable::RESET );
+		}
+		if ( screen.size() > wanted.size() ) {
+			append( "\x1b[K" );
+		}
+		snprintf( seq, sizeof seq, "\x1b[%dG", pi.promptIndentation + _pos + 1 );
+		append( seq );
+		layoutScope.stop();
+		write_display( patch.data(), static_cast<int>( patch.size() ) );
+	}
+	screen.assign( wanted.begin(), wanted.end() );
+	_renderedLines.assign( 1, DisplayLine{ 0, static_cast<int>( screen.size() ) } );
+	_renderedGeneration = _generation;
+	_renderedBytes = _terminal.screen_bytes();
+	_renderedPos = _pos;
+	return ( true );
+}
+
+namespace {
+
+void append_sequence( Replxx::ReplxxImpl::display_t& out_, char const* seq_ ) {
+	while ( *seq_ ) {
+		out_.push_back( static_cast<char32_t>( *seq_ ) );
+		++ seq_;
+	}
+}
+
+/*
+ * Relative cursor movement, column is set absolutely
+ * when terminal may be waiting to wrap after last column.
+ */
+void append_move( Replxx::ReplxxImpl::display_t& out_, int fromX_, int fromY_, int toX_, int toY_, bool columnKnown_ ) {
+	char seq[32];
+	auto move = [&out_, &seq]( int count_, char code_ ) {
+		if ( count_ > 1 ) {
+			snprintf( seq, sizeof seq, "\x1b[%d%c", count_, code_ );
+		} else {
+			snprintf( seq, sizeof seq, "\x1b[%c", code_ );
+		}
+		append_sequence( out_, seq );
+	};
+	if ( toY_ < fromY_ ) {
+		move( fromY_ - toY_, 'A' );
+	} else if ( toY_ > fromY_ ) {
+		move( toY_ - fromY_, 'B' );
+	}
+	if ( ! columnKnown_ ) {
+		snprintf( seq, sizeof seq, "\x1b[%dG", toX_ + 1 );
+		append_sequence( out_, seq );
+	} else if ( toX_ > fromX_ ) {
+		move( toX_ - fromX_, 'C' );
+	} else if ( toX_ < fromX_ ) {
+		move( fromX_ - toX_, 'D' );
+	}
+}
+
+}
+
+/*
+ * Cursor moved over input which is still as last painted, emit only cursor
+ * movement, and repaint the highlighted matching brace if it changed.
+ * Highlighter callback is not called, its colors from last paint are reused.
+ */
+bool Replxx::ReplxxImpl::move_cursor( PromptBase& pi ) {
+	int len( _data.length() );
+	if (
+		( _renderedGeneration != _generation )
+		|| ( _renderedBytes != _terminal.screen_bytes() )
+		|| ! _menuItems.empty()
+		// hints are shown only with cursor at the end of input
+		|| ( ( ( _pos == len ) || ( _renderedPos == len ) ) && ! _noColor && has_hinter() )
+	) {
+		return ( false );
+	}
+	int braceIdx( -1 );
+	bool braceError( false );
+	if ( _pos < len ) {
+		_braceIndex.update( _data.get(), len );
+		braceIdx = _braceIndex.match( _pos, braceError );
+	}
+	Profiler::Scope layoutScope( _profiler, Replxx::Stats::PHASE::LAYOUT );
+	_layout.update( _data.get(), len, pi.promptIndentation, pi.promptScreenColumns );
+	int xCursorPos( 0 ), yCursorPos( 0 );
+	_layout.position( _pos, xCursorPos, yCursorPos );
+	auto visible = [this]( int y_ ) {
+		return ( ( _viewportTop < 0 ) || ( ( y_ >= _viewportTop ) && ( y_ < ( _viewportTop + _viewportRows ) ) ) );
+	};
+	if ( ! visible( yCursorPos ) ) {
+		// viewport has to scroll
+		return ( false );
+	}
+	display_t& patch( _patch );
+	patch.clear();
+	int x( 0 ), y( 0 );
+	_layout.position( _renderedPos, x, y );
+	bool columnKnown( true );
+	if ( ! _noColor && ( ( braceIdx != _renderedBrace ) || ( braceError != _renderedBraceError ) ) ) {
+		render_display( braceIdx, braceError );
+		int const cells[] = { _renderedBrace != braceIdx ? _renderedBrace : -1, braceIdx };
+		for ( int idx : cells ) {
+			if ( idx < 0 ) {
+				continue;
+			}
+			int cellX( 0 ), cellY( 0 );
+			_layout.position( idx, cellX, cellY );
+			if ( ! visible( cellY ) ) {
+				continue;
+			}
+			append_move( patch, x, y, cellX, cellY, columnKnown );
+			Replxx::Color color( _colors[idx] );
+			if ( idx == braceIdx ) {
+				color = braceError ? Replxx::Color::ERROR : Replxx::Color::BRIGHTRED;
+			}
+			patch.push_back( _attrs.mark( color ) );
+			patch.push_back( _data[idx] );
+			patch.push_back( AttrTable::RESET );
+			x = cellX;
+			y = cellY;
+			columnKnown = false;
+		}
+		for ( int idx : cells ) {
+			if ( ( idx >= 0 ) && ( idx < static_cast<int>( _screenCells.size() ) ) ) {
+				_screenCells[idx] = Cell{ _display[idx], _spans[span_at( _spans, idx )].attr };
+			}
+		}
+	}
+	append_move( patch, x, y, xCursorPos, yCursorPos, columnKnown );
+	layoutScope.stop();
+	if ( ! patch.empty() ) {
+		write_display( patch.data(), static_cast<int>( patch.size() ) );
+	}
+	_renderedBytes = _terminal.screen_bytes();
+	_renderedPos = _pos;
+	_renderedBrace = braceIdx;
+	_renderedBraceError = braceError;
+	pi.promptCursorRowOffset = pi.promptExtraLines + viewport_row( yCursorPos );
+	return ( true );
+}
+
+namespace {
+
+/*
+ * Split text into parts between newlines.
+ */
+void split_lines( char32_t const* text_, int len_, Replxx::ReplxxImpl::display_lines_t& lines_ ) {
+	lines_.clear();
+	int start( 0 );
+	for ( int i( 0 ); i < len_; ++ i ) {
+		if ( text_[i] == '\n' ) {
+			lines_.push_back( Replxx::ReplxxImpl::DisplayLine{ start, i } );
+			start = i + 1;
+		}
+	}
+	lines_.push_back( Replxx::ReplxxImpl::DisplayLine{ start, len_ } );
+}
+
+}
+
+/*
+ * Paint input spanning several logical lines. When screen still shows
+ * previous paint only logical lines that differ from it are written:
+ * in place if rows of all lines stay where they were, otherwise
+ * everything from the first line that differs is written again.
+ * Last logical line is compared together with hints and menu following it.
+ */
+void Replxx::ReplxxImpl::paint_lines( PromptBase& pi, int hintLen, int yEndOfInput, int xCursorPos, int yCursorPos ) {
+	int screenColumns( pi.promptScreenColumns );
+	char32_t const* text( _noColor ? _data.get() : _display.data() );
+	int len( _noColor ? _data.length() : static_cast<int>( _display.size() ) );
+	Cell const* old( _screenCells.data() );
+	int oldLen( static_cast<int>( _screenCells.size() ) );
+	attr_spans_t const* spans( _noColor ? nullptr : &_spans );
+	int lineCount( _layout.line_count() );
+	int oldLineCount( static_cast<int>( _renderedLineRows.size() ) );
+	bool incremental(
+		( _renderedGeneration >= 0 )
+		&& ( _renderedBytes == _terminal.screen_bytes() )
+		&& ( oldLineCount > 1 )
+		&& ( static_cast<int>( _renderedLines.size() ) >= oldLineCount )
+	);
+	split_lines( text, len, _lines );
+	auto same = [&]( int line_ ) {
+		if ( ( line_ >= oldLineCount ) || ( _layout.line_row( line_ ) != _renderedLineRows[line_] ) ) {
+			return ( false );
+		}
+		bool last( line_ == ( lineCount - 1 ) );
+		if ( last != ( line_ == ( oldLineCount - 1 ) ) ) {
+			return ( false );
+		}
+		DisplayLine const& l( _lines[line_] );
+		DisplayLine const& o( _renderedLines[line_] );
+		int end( last ? len : l.end );
+		int oldEnd( last ? oldLen : o.end );
+		return (
+			( ( end - l.start ) == ( oldEnd - o.start ) )
+			&& same_cells( text, spans, l.start, end, old + o.start )
+		);
+	};
+	auto wraps_exactly = [&]( int column_ ) {
+		return ( ( column_ > 0 ) && ( ( column_ % screenColumns ) == 0 ) );
+	};
+	int first( 0 );
+	while ( incremental && ( first < lineCount ) && same( first ) ) {
+		++ first;
+	}
+	bool sameRows( incremental && ( lineCount == oldLineCount ) && ( yEndOfInput == _renderedRows ) );
+	for ( int i( first ); sameRows && ( i < lineCount ); ++ i ) {
+		sameRows = _layout.line_row( i ) == _renderedLineRows[i];
+	}
+	display_t& patch( _patch );
+	patch.clear();
+	int y( pi.promptCursorRowOffset - pi.promptExtraLines );
+	auto start_line = [&]( int line_, bool clear_ ) {
+		int row( _layout.line_row( line_ ) );
+		append_move( patch, 0, y, line_ > 0 ? 0 : pi.promptIndentation, row, false );
+		y = row;
+		if ( clear_ ) {
+			append_sequence( patch, "\x1b[J" );
+		}
+	};
+	int run( first );
+	if ( sameRows ) {
+		for ( int i( first ); i < ( lineCount - 1 ); ++ i ) {
+			if ( same( i ) ) {
+				continue;
+			}
+			start_line( i, false );
+			append_text( patch, text, spans, _lines[i].start, _lines[i].end );
+			if ( spans ) {
+				// color in effect at the end of the line
+				patch.push_back( AttrTable::RESET );
 			}
-		} else if (strchr("{[(", _data[_pos])) {
-			scanDirection = 1; /* forwards */
-			if (_data[_pos] == '{') {
-				//part1 = '{'; part2 = '}';
-				part1 = '}'; part2 = '{';
-			} else if (_data[_pos] == '[') {
-				//part1 = '['; part2 = ']';
-				part1 = ']'; part2 = '[';
-			} else {
-				//part1 = '('; part2 = ')';
-				part1 = ')'; part2 = '(';
+			int endColumn( _layout.column( _layout.line_end( i ) ) );
+			y += endColumn / screenColumns;
+			if ( wraps_exactly( endColumn ) ) {
+				// terminal waits to wrap, erasing now would remove last character
+				patch.push_back( '\n' );
 			}
+			append_sequence( patch, "\x1b[K" );
 		}
-
-		if (scanDirection) {
-			int unmatched = scanDirection;
-			int unmatchedOther = 0;
-			for (int i = _pos + scanDirection; i >= 0 && i < _data.length(); i += scanDirection) {
-				/* TODO: the right thing when inside a string */
-				if (strchr("}])", _data[i])) {
-					if (_data[i] == part1) {
-						--unmatched;
-					} else {
-						--unmatchedOther;
-					}
-				} else if (strchr("{[(", _data[i])) {
-					if (_data[i] == part2) {
-						++unmatched;
-					} else {
-						++unmatchedOther;
-					}
-				}
-
-				if (unmatched == 0) {
-					highlightIdx = i;
-					indicateError = (unmatchedOther != 0);
-					break;
-				}
+		run = same( lineCount - 1 ) ? lineCount : lineCount - 1;
+	}
+	if ( run < lineCount ) {
+		start_line( run, true );
+		for ( int i( run ); i < ( lineCount - 1 ); ++ i ) {
+			append_text( patch, text, spans, _lines[i].start, _lines[i].end + 1 );
+			if ( wraps_exactly( _layout.column( _layout.line_end( i ) ) ) ) {
+				patch.push_back( '\n' );
 			}
 		}
+		append_text( patch, text, spans, _lines[lineCount - 1].start, len );
+		if ( spans ) {
+			patch.push_back( AttrTable::RESET );
+		}
+		// we have to generate our own newline on line wrap
+		if ( wraps_exactly( _layout.column( _data.length() ) + ( hintLen > 0 ? hintLen : 0 ) ) ) {
+			patch.push_back( '\n' );
+		}
+		y = yEndOfInput;
 	}
+	append_move( patch, 0, y, xCursorPos, yCursorPos, false );
+	write_display( patch.data(), static_cast<int>( patch.size() ) );
+}
 
-	highlight( highlightIdx, indicateError );
-	int hintLen( handle_hints( pi, hintAction_ ) );
-	// calculate the position of the end of the input line
-	int xEndOfInput( 0 ), yEndOfInput( 0 );
-	calculateScreenPosition(
-		pi.promptIndentation, 0, pi.promptScreenColumns,
-		calculateColumnPosition( _data.get(), _data.length() ) + hintLen,
-		xEndOfInput, yEndOfInput
-	);
-	yEndOfInput += count( _display.begin(), _display.end(), '\n' );
-
-	// calculate the desired position of the cursor
-	int xCursorPos( 0 ), yCursorPos( 0 );
-	calculateScreenPosition(
-		pi.promptIndentation, 0, pi.promptScreenColumns,
-		calculateColumnPosition(_data.get(), _pos),
-		xCursorPos,
-		yCursorPos
-	);
-
-#ifdef _WIN32
-	// position at the end of the prompt, clear to end of previous input
-	CONSOLE_SCREEN_BUFFER_INFO inf;
-	GetConsoleScreenBufferInfo(console_out, &inf);
-	inf.dwCursorPosition.X = pi.promptIndentation; // 0-based on Win32
-	inf.dwCursorPosition.Y -= pi.promptCursorRowOffset - pi.promptExtraLines;
-	SetConsoleCursorPosition(console_out, inf.dwCursorPosition);
-	replxx::clear_screen( CLEAR_SCREEN::TO_END );
-	pi.promptPreviousInputLen = _data.length();
-
-	// display the input line
-	if ( !_noColor ) {
-		write32( _display.data(), _display.size() );
+/*
+ * Paint only input rows around the cursor that fit on screen, cost
+ * of the paint depends on screen size and not on input size.
+ * Viewport is scrolled only as far as needed to keep the cursor visible.
+ * First screen row tells how many rows are hidden above the viewport,
+ * unless it starts at the prompt, last screen row how many are hidden
+ * below it, unless it reaches the end of input.
+ */
+void Replxx::ReplxxImpl::paint_viewport( PromptBase& pi, int xCursorPos, int yCursorPos ) {
+	int screenRows( pi.promptScreenRows );
+	int screenColumns( pi.promptScreenColumns );
+	int inputRows( _layout.row_count() );
+	int rows( inputRows + _displayRows );
+	auto capacity = [&]( int top_ ) {
+		int n( screenRows - ( top_ > 0 ? 1 : 0 ) );
+		return ( ( top_ + n ) < rows ? n - 1 : n );
+	};
+	int top( max( _viewportTop, 0 ) );
+	if ( yCursorPos < top ) {
+		top = yCursorPos;
+	} else if ( yCursorPos >= ( top + capacity( top ) ) ) {
+		top = yCursorPos - screenRows + 3;
+	}
+	// do not leave screen rows past the end of input empty
+	while ( ( top > 0 ) && ( ( top - 1 + capacity( top - 1 ) ) >= rows ) ) {
+		-- top;
+	}
+	_viewportTop = top;
+	_viewportRows = capacity( top );
+	int bottom( top + _viewportRows );
+
+	char32_t const* text( _noColor ? _data.get() : _display.data() );
+	int len( _noColor ? _data.length() : static_cast<int>( _display.size() ) );
+	int dataLen( _data.length() );
+	display_t& patch( _patch );
+	patch.clear();
+	append_move( patch, 0, pi.promptCursorRowOffset - pi.promptExtraLines, 0, 0, false );
+	append_sequence( patch, "\x1b[J" );
+	auto indicator = [&]( int count_, char const* where_ ) {
+		char buf[64];
+		snprintf( buf, sizeof buf, "-- %d row%s %s --", count_, count_ != 1 ? "s" : "", where_ );
+		if ( ! _noColor ) {
+			patch.push_back( _attrs.mark( Replxx::Color::GRAY ) );
+		}
+		for ( int i( 0 ); buf[i] && ( i < ( screenColumns - 1 ) ); ++ i ) {
+			patch.push_back( static_cast<char32_t>( buf[i] ) );
+		}
+		if ( ! _noColor ) {
+			patch.push_back( AttrTable::RESET );
+		}
+	};
+	int y( 0 );
+	if ( top > 0 ) {
+		indicator( top, "above" );
+		patch.push_back( '\n' );
+		++ y;
 	} else {
-		write32( _data.get(), _data.length() );
+		pi.last_line( patch );
 	}
 
-	// position the cursor
-	GetConsoleScreenBufferInfo(console_out, &inf);
-	inf.dwCursorPosition.X = xCursorPos; // 0-based on Win32
-	inf.dwCursorPosition.Y -= ( yEndOfInput - yCursorPos );
-	SetConsoleCursorPosition(console_out, inf.dwCursorPosition);
-#else // _WIN32
-	char seq[64];
-	int cursorRowMovement = pi.promptCursorRowOffset - pi.promptExtraLines;
-	if (cursorRowMovement > 0) { // move the cursor up as required
-		snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
-		write8( seq, strlen(seq) );
+	// input characters keep their positions in display, rows are copied with runs in effect at their start
+	attr_spans_t const* spans( _noColor ? nullptr : &_spans );
+	int i( _layout.row_start( top ) );
+	for ( int row( top ); row < bottom; ++ row ) {
+		if ( row > top ) {
+			patch.push_back( '\n' );
+			++ y;
+		}
+		if ( row < inputRows ) {
+			int rowEnd( ( row + 1 ) < inputRows ? _layout.row_start( row + 1 ) : dataLen );
+			// rows are separated above, input newlines are not written
+			int end( ( rowEnd > i ) && ( text[rowEnd - 1] == '\n' ) ? rowEnd - 1 : rowEnd );
+			append_text( patch, text, spans, i, end );
+			i = rowEnd;
+			if ( row < ( inputRows - 1 ) ) {
+				continue;
+			}
+			// hint following input is cut at the end of its row
+			int room( screenColumns - _layout.column( dataLen ) % screenColumns );
+			int hintEnd( i );
+			while ( ( hintEnd < len ) && ( text[hintEnd] != '\n' ) ) {
+				++ hintEnd;
+			}
+			append_text( patch, text, spans, i, min( hintEnd, i + room ) );
+			i = hintEnd;
+		} else {
+			// rows of hints and menu, each starts with newline
+			++ i;
+			int end( i );
+			while ( ( end < len ) && ( text[end] != '\n' ) ) {
+				++ end;
+			}
+			append_text( patch, text, spans, i, end );
+			i = end;
+		}
 	}
-	// position at the end of the prompt, clear to end of screen
-	snprintf(
-		seq, sizeof seq, "\x1b[%dG\x1b[%c",
-		pi.promptIndentation + 1, /* 1-based on VT100 */
-		'J'
-	);
-	write8( seq, strlen(seq) );
-
-	if ( !_noColor ) {
-		write32( _display.data(), _display.size() );
-	} else { // highlightIdx the matching brace/bracket/parenthesis
-		write32( _data.get(), _data.length() );
+	if ( bottom < rows ) {
+		if ( ! _noColor ) {
+			// display was cut before its closing reset
+			patch.push_back( AttrTable::RESET );
+		}
+		patch.push_back( '\n' );
+		++ y;
+		indicator( rows - bottom, "below" );
 	}
+	append_move( patch, 0, y, xCursorPos, viewport_row( yCursorPos ), false );
+	write_display( patch.data(), static_cast<int>( patch.size() ) );
+}
 
-	// we have to generate our own newline on line wrap
-	if (xEndOfInput == 0 && yEndOfInput > 0) {
-		write8( "\n", 1 );
+/*
+ * Input fits on screen again, viewport was showing scroll indicator
+ * or input in place of the prompt, show the prompt again at screen top.
+ */
+void Replxx::ReplxxImpl::leave_viewport( PromptBase& pi ) {
+	display_t& patch( _patch );
+	patch.clear();
+	append_move( patch, 0, pi.promptCursorRowOffset - pi.promptExtraLines, 0, 0, false );
+	append_sequence( patch, "\x1b[J" );
+	pi.last_line( patch );
+	write_display( patch.data(), static_cast<int>( patch.size() ) );
+	pi.promptCursorRowOffset = pi.promptExtraLines;
+	_viewportTop = -1;
+	// nothing of the input is on screen
+	_renderedGeneration = -1;
+}
+
+/*
+ * Keep cells of painted display so that following paints can patch it,
+ * only when all of it is on screen, so their number is bounded by screen size.
+ */
+void Replxx::ReplxxImpl::remember_screen( void ) {
+	_screenCells.clear();
+	_renderedLines.clear();
+	if ( _viewportTop >= 0 ) {
+		return;
+	}
+	char32_t const* text( _noColor ? _data.get() : _display.data() );
+	int len( _noColor ? _data.length() : static_cast<int>( _display.size() ) );
+	int spanCount( _noColor ? 0 : static_cast<int>( _spans.size() ) );
+	int s( 0 );
+	int start( 0 );
+	for ( int i( 0 ); i < len; ++ i ) {
+		while ( ( ( s + 1 ) < spanCount ) && ( _spans[s + 1].start <= i ) ) {
+			++ s;
+		}
+		_screenCells.push_back( Cell{ text[i], spanCount > 0 ? _spans[s].attr : AttrTable::RESET } );
+		if ( text[i] == '\n' ) {
+			_renderedLines.push_back( DisplayLine{ start, i } );
+			start = i + 1;
+		}
 	}
+	_renderedLines.push_back( DisplayLine{ start, len } );
+}
+#endif
 
-	// position the cursor
-	cursorRowMovement = yEndOfInput - yCursorPos;
-	if (cursorRowMovement > 0) { // move the cursor up as required
-		snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
-		write8( seq, strlen(seq) );
+/*
+ * Append visible part of completion menu below the input line.
+ */
+void Replxx::ReplxxImpl::render_menu( PromptBase& pi ) {
+	int count( static_cast<int>( _menuItems.size() ) );
+	int maxCol( pi.promptScreenColumns );
+#ifdef _WIN32
+	-- maxCol;
+#endif
+	int startCol( pi.promptIndentation + calculateColumnPosition( _data.get(), _pos - context_length() ) );
+	if ( startCol >= maxCol ) {
+		startCol = 0;
 	}
-	// position the cursor within the line
-	snprintf(seq, sizeof seq, "\x1b[%dG", xCursorPos + 1); // 1-based on VT100
-	write8( seq, strlen(seq) );
+	for ( int i( _menuTop ); ( i < count ) && ( i < _menuTop + _completionMenuRows ); ++ i ) {
+#ifdef _WIN32
+		_display.push_back( '\r' );
 #endif
+		_display.push_back( '\n' );
+		++ _displayRows;
+		int col( 0 );
+		for ( ; col < startCol; ++ col ) {
+			_display.push_back( ' ' );
+		}
+		if ( i == _menuSelection ) {
+			setColor( Replxx::Color::BRIGHTMAGENTA );
+		}
+		// items are cut at screen edge so that wide characters never wrap
+		UnicodeString const& item( _menuItems[i] );
+		for ( int j( 0 ); j < item.length(); ++ j ) {
+			char32_t c( item[j] );
+			int width( calculateColumnPosition( &c, 1 ) );
+			if ( ( col + width ) > maxCol ) {
+				break;
+			}
+			_display.push_back( c );
+			col += width;
+		}
+		if ( i == _menuSelection ) {
+			setColor( Replxx::Color::DEFAULT );
+		}
+	}
+}
 
-	pi.promptCursorRowOffset = pi.promptExtraLines + yCursorPos; // remember row for next pass
+/*
+ * Let user pick one of completions from in-place menu.
+ * Typing characters of a word refines the menu,
+ * any other key closes the menu and is passed to the main loop.
+ */
+int Replxx::ReplxxImpl::completion_menu( PromptBase& pi, completions_t& completions_, int contextLen_ ) {
+	_menuItems.swap( completions_ );
+	_menuSelection = 0;
+	_menuTop = 0;
+	char32_t c( 0 );
+	bool done( false );
+	while ( ! done ) {
+		int count( static_cast<int>( _menuItems.size() ) );
+		if ( _menuSelection < _menuTop ) {
+			_menuTop = _menuSelection;
+		} else if ( _menuSelection >= ( _menuTop + _completionMenuRows ) ) {
+			_menuTop = _menuSelection - _completionMenuRows + 1;
+		}
+		refreshLine( pi, HINT_ACTION::SKIP );
+		do {
+			c = read_keystroke();
+			c = cleanupCtrl( c );
+		} while ( c == static_cast<char32_t>( -1 ) );
+		switch ( c ) {
+			case ctrlChar('I'):
+			case ctrlChar('N'):
+			case DOWN_ARROW_KEY:
+				_menuSelection = ( _menuSelection + 1 ) % count;
+				break;
+			case ctrlChar('P'):
+			case UP_ARROW_KEY:
+				_menuSelection = ( _menuSelection + count - 1 ) % count;
+				break;
+			case PAGE_DOWN_KEY:
+				_menuSelection = min( _menuSelection + _completionMenuRows, count - 1 );
+				break;
+			case PAGE_UP_KEY:
+				_menuSelection = max( _menuSelection - _completionMenuRows, 0 );
+				break;
+			case ctrlChar('J'):
+			case ctrlChar('M'): {
+				UnicodeString const& item( _menuItems[_menuSelection] );
+				int len( max( item.length() - contextLen_, 0 ) );
+				replace( _pos, 0, item.get() + contextLen_, item.get() + contextLen_ + len );
+				_prefix = _pos = _pos + len;
+				c = 0;
+				done = true;
+			} break;
+			case ctrlChar('C'):
+			case ctrlChar('G'):
+				c = 0;
+				done = true;
+				break;
+			default: {
+				bool refine( false );
+				if ( c == ctrlChar('H') ) {
+					if ( contextLen_ > 0 ) {
+						erase( _pos - 1, 1 );
+						-- _pos;
+						refine = true;
+					}
+				} else if ( ( c >= ' ' ) && ( c <= 0x10ffff ) && ! is_word_break_character( c ) && ( _data.length() < REPLXX_MAX_LINE ) ) {
+					replace( _pos, 0, &c, &c + 1 );
+					++ _pos;
+					refine = true;
+				}
+				if ( ! refine ) {
+					done = true;
+					break;
+				}
+				c = 0;
+				contextLen_ = context_length();
+				CompletionCollector collector( _maxDisplayedCompletions, _completionRanking ? &_history : nullptr );
+				fetch_completions( contextLen_, collector );
+				if ( collector.count() == 0 ) {
+					done = true;
+					break;
+				}
+				_menuItems = collector.data();
+				_menuSelection = 0;
+				_menuTop = 0;
+			}
+		}
+	}
+	_menuItems.clear();
+	refreshLine( pi );
+	return ( c );
 }
 
 int Replxx::ReplxxImpl::context_length() {
@@ -544,34 +1700,6 @@ int Replxx::ReplxxImpl::context_length() {
 	return ( _pos - prefixLength );
 }
 
-namespace {
-int longest_common_prefix( Replxx::ReplxxImpl::completions_t const& completions ) {
-	int completionsCount( completions.size() );
-	if ( completionsCount < 1 ) {
-		return ( 0 );
-	}
-	int longestCommonPrefix( 0 );
-	UnicodeString const& sample( completions.front() );
-	while ( true ) {
-		if ( longestCommonPrefix >= sample.length() ) {
-			return ( longestCommonPrefix );
-		}
-		char32_t sc( sample[longestCommonPrefix] );
-		for ( int i( 1 ); i < completionsCount; ++ i ) {
-			UnicodeString const& candidate( completions[i] );
-			if ( longestCommonPrefix >= candidate.length() ) {
-				return ( longestCommonPrefix );
-			}
-			char32_t cc( candidate[longestCommonPrefix] );
-			if ( cc != sc ) {
-				return ( longestCommonPrefix );
-			}
-		}
-		++ longestCommonPrefix;
-	}
-}
-}
-
 /**
  * Handle command completion, using a completionCallback() routine to provide
  * possible substitutions
@@ -589,37 +1717,40 @@ int Replxx::ReplxxImpl::completeLine(PromptBase& pi) {
 	// extract a copy to parse.	we also handle the case where tab is hit while
 	// not at end-of-line.
 
-	_utf8Buffer.assign( _data, _pos );
 	// get a list of completions
 	int contextLen( context_length() );
-	Replxx::ReplxxImpl::completions_t completions( call_completer( _utf8Buffer.get(), contextLen ) );
+	CompletionCollector collector( _maxDisplayedCompletions, _completionRanking ? &_history : nullptr );
+	fetch_completions( contextLen, collector );
+	int totalCount( collector.count() );
+	Replxx::ReplxxImpl::completions_t completions( collector.data() );
 
 	// if no completions, we are done
-	if (completions.size() == 0) {
-		beep();
+	if ( totalCount == 0 ) {
+		_terminal.beep();
 		return 0;
 	}
 
 	// at least one completion
 	int longestCommonPrefix = 0;
-	int completionsCount( completions.size() );
+	int completionsCount( totalCount );
 	int selectedCompletion( 0 );
-	if ( _hintSelection != -1 ) {
+	if ( ( _hintSelection != -1 ) && ( _hintSelection < static_cast<int>( completions.size() ) ) ) {
 		selectedCompletion = _hintSelection;
 		completionsCount = 1;
 	}
 	if ( completionsCount == 1 ) {
 		longestCommonPrefix = static_cast<int>(completions[selectedCompletion].length());
 	} else {
-		longestCommonPrefix = longest_common_prefix( completions );
+		longestCommonPrefix = collector.common_prefix_length();
 	}
 	if ( _beepOnAmbiguousCompletion && ( completionsCount != 1 ) ) { // beep if ambiguous
-		beep();
+		_terminal.beep();
 	}
 
 	// if we can extend the item, extend it and return to main loop
 	if ( ( longestCommonPrefix > contextLen ) || ( completionsCount == 1 ) ) {
-		_data.insert( _pos, completions[selectedCompletion], contextLen, longestCommonPrefix - contextLen );
+		UnicodeString const& completion( completions[selectedCompletion] );
+		replace( _pos, 0, completion.get() + contextLen, completion.get() + longestCommonPrefix );
 		_prefix = _pos = _pos + longestCommonPrefix - contextLen;
 		refreshLine(pi);
 		return 0;
@@ -628,7 +1759,7 @@ int Replxx::ReplxxImpl::completeLine(PromptBase& pi) {
 	if ( _doubleTabCompletion ) {
 		// we can't complete any further, wait for second tab
 		do {
-			c = read_char();
+			c = read_keystroke();
 			c = cleanupCtrl(c);
 		} while (c == static_cast<char32_t>(-1));
 
@@ -638,21 +1769,31 @@ int Replxx::ReplxxImpl::completeLine(PromptBase& pi) {
 		}
 	}
 
+	if ( ( _completionMenuRows > 0 ) && ! _noColor ) {
+		return ( completion_menu( pi, completions, contextLen ) );
+	}
+
 	// we got a second tab, maybe show list of possible completions
 	bool showCompletions = true;
 	bool onNewLine = false;
-	if ( static_cast<int>( completions.size() ) > _completionCountCutoff ) {
+	if ( totalCount > _completionCountCutoff ) {
 		int savePos = _pos; // move cursor to EOL to avoid overwriting the command line
 		_pos = _data.length();
 		refreshLine(pi);
 		_pos = savePos;
-		printf("\nDisplay all %u possibilities? (y or n)",
-					 static_cast<unsigned int>(completions.size()));
-		fflush(stdout);
+		char question[64];
+		if ( static_cast<int>( completions.size() ) < totalCount ) {
+			snprintf(question, sizeof question, "\nDisplay %u of %u possibilities? (y or n)",
+						 static_cast<unsigned int>(completions.size()), static_cast<unsigned int>(totalCount));
+		} else {
+			snprintf(question, sizeof question, "\nDisplay all %u possibilities? (y or n)",
+						 static_cast<unsigned int>(totalCount));
+		}
+		_terminal.write8( question, static_cast<int>( strlen( question ) ) );
 		onNewLine = true;
 		while (c != 'y' && c != 'Y' && c != 'n' && c != 'N' && c != ctrlChar('C')) {
 			do {
-				c = read_char();
+				c = read_keystroke();
 				c = cleanupCtrl(c);
 			} while (c == static_cast<char32_t>(-1));
 		}
@@ -664,7 +1805,7 @@ int Replxx::ReplxxImpl::completeLine(PromptBase& pi) {
 			case ctrlChar('C'):
 				showCompletions = false;
 				// Display the ^C we got
-				write8( "^C", 2 );
+				_terminal.write8( "^C", 2 );
 				c = 0;
 				break;
 		}
@@ -691,25 +1832,25 @@ int Replxx::ReplxxImpl::completeLine(PromptBase& pi) {
 			refreshLine( pi, HINT_ACTION::SKIP );
 			_pos = savePos;
 		} else {
-			replxx::clear_screen( CLEAR_SCREEN::TO_END );
+			_terminal.clear_screen( CLEAR_SCREEN::TO_END );
 		}
-		size_t pauseRow = getScreenRows() - 1;
+		std::string const padding( longestCompletion, ' ' );
+		size_t pauseRow = _terminal.screen_rows() - 1;
 		size_t rowCount = (completions.size() + columnCount - 1) / columnCount;
 		for (size_t row = 0; row < rowCount; ++row) {
 			if (row == pauseRow) {
-				printf("\n--More--");
-				fflush(stdout);
+				_terminal.write8( "\n--More--", 9 );
 				c = 0;
 				bool doBeep = false;
 				while (c != ' ' && c != '\r' && c != '\n' && c != 'y' && c != 'Y' &&
 							 c != 'n' && c != 'N' && c != 'q' && c != 'Q' &&
 							 c != ctrlChar('C')) {
 					if (doBeep) {
-						beep();
+						_terminal.beep();
 					}
 					doBeep = true;
 					do {
-						c = read_char();
+						c = read_keystroke();
 						c = cleanupCtrl(c);
 					} while (c == static_cast<char32_t>(-1));
 				}
@@ -717,29 +1858,29 @@ int Replxx::ReplxxImpl::completeLine(PromptBase& pi) {
 					case ' ':
 					case 'y':
 					case 'Y':
-						printf("\r				\r");
-						pauseRow += getScreenRows() - 1;
+						_terminal.write8( "\r				\r", 6 );
+						pauseRow += _terminal.screen_rows() - 1;
 						break;
 					case '\r':
 					case '\n':
-						printf("\r				\r");
+						_terminal.write8( "\r				\r", 6 );
 						++pauseRow;
 						break;
 					case 'n':
 					case 'N':
 					case 'q':
 					case 'Q':
-						printf("\r				\r");
+						_terminal.write8( "\r				\r", 6 );
 						stopList = true;
 						break;
 					case ctrlChar('C'):
 						// Display the ^C we got
-						write8( "^C", 2 );
+						_terminal.write8( "^C", 2 );
 						stopList = true;
 						break;
 				}
 			} else {
-				printf("\n");
+				_terminal.write8( "\n", 1 );
 			}
 			if (stopList) {
 				break;
@@ -748,42 +1889,32 @@ int Replxx::ReplxxImpl::completeLine(PromptBase& pi) {
 				size_t index = (column * rowCount) + row;
 				if (index < completions.size()) {
 					int itemLength = static_cast<int>(completions[index].length());
-					fflush(stdout);
 
 					static UnicodeString const col( ansi_color( Replxx::Color::BRIGHTMAGENTA ) );
 					if ( !_noColor ) {
-						write32( col.get(), col.length() );
+						_terminal.write32( col.get(), col.length() );
 					}
-					write32( &_data[_pos - contextLen], longestCommonPrefix );
+					_terminal.write32( &_data[_pos - contextLen], longestCommonPrefix );
 					static UnicodeString const res( ansi_color( Replxx::Color::DEFAULT ) );
 					if ( !_noColor ) {
-						write32( res.get(), res.length() );
+						_terminal.write32( res.get(), res.length() );
 					}
 
-					write32( completions[index].get() + longestCommonPrefix, itemLength - longestCommonPrefix );
+					_terminal.write32( completions[index].get() + longestCommonPrefix, itemLength - longestCommonPrefix );
 
 					if (((column + 1) * rowCount) + row < completions.size()) {
-						for ( int k( itemLength ); k < longestCompletion; ++k ) {
-							printf( " " );
-						}
+						_terminal.write8( padding.data(), longestCompletion - itemLength );
 					}
 				}
 			}
 		}
-		fflush(stdout);
 	}
 
 	// display the prompt on a new line, then redisplay the input buffer
 	if (!stopList || c == ctrlChar('C')) {
-		write8( "\n", 1 );
+		_terminal.write8( "\n", 1 );
 	}
 	pi.write();
-#ifndef _WIN32
-	// we have to generate our own newline on line wrap on Linux
-	if (pi.promptIndentation == 0 && pi.promptExtraLines > 0) {
-		write8( "\n", 1 );
-	}
-#endif
 	pi.promptCursorRowOffset = pi.promptExtraLines;
 	refreshLine(pi);
 	return 0;
@@ -793,28 +1924,24 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 	// The latest history entry is always our current buffer
 	if ( _data.length() > 0 ) {
 		_utf8Buffer.assign( _data );
-		history_add( _utf8Buffer.get() );
+		_history.add( _utf8Buffer.get(), true );
 	} else {
-		history_add( "" );
+		_history.add( "", true );
 	}
 	_history.reset_pos();
 
 	// display the prompt
 	pi.write();
 
-#ifndef _WIN32
-	// we have to generate our own newline on line wrap on Linux
-	if (pi.promptIndentation == 0 && pi.promptExtraLines > 0) {
-		write8( "\n", 1 );
-	}
-#endif
-
 	// the cursor starts out at the end of the prompt
 	pi.promptCursorRowOffset = pi.promptExtraLines;
 
 	// kill and yank start in "other" mode
 	_killRing.lastAction = KillRing::actionOther;
 
+	// edits of previous input cannot be undone
+	_undo.reset();
+
 	// when history search returns control to us, we execute its terminating
 	// keystroke
 	int terminatingKeystroke = -1;
@@ -828,15 +1955,17 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 	NEXT next( NEXT::CONTINUE );
 	while ( next == NEXT::CONTINUE ) {
 		int c;
+		_profiler.end_keystroke();
 		if (terminatingKeystroke == -1) {
-			c = read_char(); // get a new keystroke
+			repaint_on_late_results( pi );
+			c = read_keystroke(); // get a new keystroke
 
 #ifndef _WIN32
-			if (c == 0 && gotResize) {
+			if (c == 0 && _terminal.got_resize()) {
 				// caught a window resize event
 				// now redraw the prompt and line
-				gotResize = false;
-				pi.promptScreenColumns = getScreenColumns();
+				pi.promptScreenColumns = _terminal.screen_columns();
+				pi.promptScreenRows = _terminal.screen_rows();
 				// redraw the original prompt with current input
 				dynamicRefresh( pi, _data.get(), _data.length(), _pos );
 				continue;
@@ -850,6 +1979,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 		c = cleanupCtrl(c); // convert CTRL + <char> into normal ctrl
 
 		if (c == 0) {
+			_profiler.end_keystroke();
 			return _data.length();
 		}
 
@@ -869,8 +1999,8 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 			case ctrlChar('A'): // ctrl-A, move cursor to start of line
 			case HOME_KEY:
 				_killRing.lastAction = KillRing::actionOther;
-				_pos = 0;
-				refreshLine(pi);
+				_pos = line_boundary( pi, false );
+				refresh_cursor(pi);
 				break;
 
 			case ctrlChar('B'): // ctrl-B, move cursor left by one character
@@ -878,7 +2008,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if (_pos > 0) {
 					--_pos;
-					refreshLine(pi);
+					refresh_cursor(pi);
 				}
 				break;
 
@@ -894,7 +2024,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 					while (_pos > 0 && !is_word_break_character( _data[_pos - 1] ) ) {
 						--_pos;
 					}
-					refreshLine(pi);
+					refresh_cursor(pi);
 				}
 				break;
 
@@ -907,7 +2037,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				// so we don't display the next prompt over the previous input line
 				_pos = _data.length(); // pass _data.length() as _pos for EOL
 				refreshLine(pi, HINT_ACTION::SKIP);
-				write8( "^C\r\n", 4 );
+				_terminal.write8( "^C\r\n", 4 );
 				next = NEXT::BAIL;
 				break;
 
@@ -916,21 +2046,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				_history.reset_recall_most_recent();
 				if (_pos < _data.length()) {
-					while ( _pos < _data.length() && is_word_break_character( _data[_pos] ) ) {
-						++_pos;
-					}
-					if (_pos < _data.length() && !is_word_break_character( _data[_pos] ) ) {
-						if ( _data[_pos] >= 'a' && _data[_pos] <= 'z' ) {
-							_data[_pos] += 'A' - 'a';
-						}
-						++_pos;
-					}
-					while (_pos < _data.length() && !is_word_break_character( _data[_pos] ) ) {
-						if ( _data[_pos] >= 'A' && _data[_pos] <= 'Z' ) {
-							_data[_pos] += 'a' - 'A';
-						}
-						++_pos;
-					}
+					change_case( CASE::CAPITALIZE );
 					refreshLine(pi);
 				}
 				break;
@@ -941,7 +2057,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if ( ( _data.length() > 0 ) && ( _pos < _data.length() ) ) {
 					_history.reset_recall_most_recent();
-					_data.erase( _pos );
+					erase( _pos, 1 );
 					refreshLine(pi);
 				} else if (_data.length() == 0) {
 					_history.drop_last();
@@ -961,7 +2077,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 						++ endingPos;
 					}
 					_killRing.kill( _data.get() + _pos, endingPos - _pos, true );
-					_data.erase( _pos, endingPos - _pos );
+					erase( _pos, endingPos - _pos );
 					refreshLine(pi);
 				}
 				_killRing.lastAction = KillRing::actionKill;
@@ -970,8 +2086,8 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 			case ctrlChar('E'): // ctrl-E, move cursor to end of line
 			case END_KEY:
 				_killRing.lastAction = KillRing::actionOther;
-				_pos = _data.length();
-				refreshLine(pi);
+				_pos = line_boundary( pi, true );
+				refresh_cursor(pi);
 				break;
 
 			case ctrlChar('F'): // ctrl-F, move cursor right by one character
@@ -979,7 +2095,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if (_pos < _data.length()) {
 					++_pos;
-					refreshLine(pi);
+					refresh_cursor(pi);
 				}
 				break;
 
@@ -995,7 +2111,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 					while ( _pos < _data.length() && !is_word_break_character( _data[_pos] ) ) {
 						++_pos;
 					}
-					refreshLine(pi);
+					refresh_cursor(pi);
 				}
 				break;
 
@@ -1003,8 +2119,8 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if ( _pos > 0 ) {
 					_history.reset_recall_most_recent();
+					erase( _pos - 1, 1 );
 					-- _pos;
-					_data.erase( _pos );
 					refreshLine(pi);
 				}
 				break;
@@ -1014,20 +2130,21 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				if ( _pos > 0 ) {
 					_history.reset_recall_most_recent();
 					int startingPos = _pos;
-					while ( _pos > 0 && is_word_break_character( _data[_pos - 1] ) ) {
-						-- _pos;
+					while ( startingPos > 0 && is_word_break_character( _data[startingPos - 1] ) ) {
+						-- startingPos;
 					}
-					while ( _pos > 0 && !is_word_break_character( _data[_pos - 1] ) ) {
-						-- _pos;
+					while ( startingPos > 0 && !is_word_break_character( _data[startingPos - 1] ) ) {
+						-- startingPos;
 					}
-					_killRing.kill( _data.get() + _pos, startingPos - _pos, false);
-					_data.erase( _pos, startingPos - _pos );
+					_killRing.kill( _data.get() + startingPos, _pos - startingPos, false);
+					erase( startingPos, _pos - startingPos );
+					_pos = startingPos;
 					refreshLine(pi);
 				}
 				_killRing.lastAction = KillRing::actionKill;
 				break;
 			case ( ctrlChar('I') ): {
-				if ( !! _completionCallback && ( _completeOnEmpty || ( _pos > 0 ) ) ) {
+				if ( has_completer() && ( _completeOnEmpty || ( _pos > 0 ) ) ) {
 					_killRing.lastAction = KillRing::actionOther;
 					_history.reset_recall_most_recent();
 
@@ -1044,6 +2161,22 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				}
 			} break;
 
+			case META + ctrlChar('J'): // meta-Enter, insert newline in multi-line mode
+			case META + ctrlChar('M'):
+				if ( ! _multiline ) {
+					next = insert_character( pi, c );
+					break;
+				}
+				_killRing.lastAction = KillRing::actionOther;
+				_history.reset_recall_most_recent();
+				{
+					char32_t const newline( '\n' );
+					replace( _pos, 0, &newline, &newline + 1 );
+				}
+				++ _pos;
+				refreshLine(pi);
+				break;
+
 			case ctrlChar('J'): // ctrl-J/linefeed/newline, accept line
 			case ctrlChar('M'): // ctrl-M/return/enter
 				_killRing.lastAction = KillRing::actionOther;
@@ -1058,7 +2191,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 
 			case ctrlChar('K'): // ctrl-K, kill from cursor to end of line
 				_killRing.kill( _data.get() + _pos, _data.length() - _pos, true );
-				_data.erase( _pos, _data.length() - _pos );
+				erase( _pos, _data.length() - _pos );
 				refreshLine(pi);
 				_killRing.lastAction = KillRing::actionKill;
 				_history.reset_recall_most_recent();
@@ -1073,15 +2206,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if (_pos < _data.length()) {
 					_history.reset_recall_most_recent();
-					while ( _pos < _data.length() && is_word_break_character( _data[_pos] ) ) {
-						++ _pos;
-					}
-					while (_pos < _data.length() && !is_word_break_character( _data[_pos] ) ) {
-						if ( _data[_pos] >= 'A' && _data[_pos] <= 'Z' ) {
-							_data[_pos] += 'a' - 'A';
-						}
-						++ _pos;
-					}
+					change_case( CASE::LOWER );
 					refreshLine(pi);
 				}
 				break;
@@ -1091,6 +2216,9 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 			case DOWN_ARROW_KEY:
 			case UP_ARROW_KEY:
 				_killRing.lastAction = KillRing::actionOther;
+				if ( _multiline && move_line( pi, ( c == UP_ARROW_KEY ) || ( c == ctrlChar('P') ) ) ) {
+					break;
+				}
 				// if not already recalling, add the current line to the history list so
 				// we don't
 				// have to special case it
@@ -1105,7 +2233,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 					if ( ! _history.move( c == ctrlChar('P') ) ) {
 						break;
 					}
-					_data.assign( _history.current() );
+					set_input( UnicodeString( _history.current() ) );
 					_pos = _data.length();
 					refreshLine(pi);
 				}
@@ -1141,10 +2269,9 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if ( _pos > 0 && _data.length() > 1 ) {
 					_history.reset_recall_most_recent();
-					size_t leftCharPos = ( _pos == _data.length() ) ? _pos - 2 : _pos - 1;
-					char32_t aux = _data[leftCharPos];
-					_data[leftCharPos] = _data[leftCharPos + 1];
-					_data[leftCharPos + 1] = aux;
+					int leftCharPos = ( _pos == _data.length() ) ? _pos - 2 : _pos - 1;
+					char32_t const transposed[] = { _data[leftCharPos + 1], _data[leftCharPos] };
+					replace( leftCharPos, 2, transposed, transposed + 2 );
 					if ( _pos != _data.length() ) {
 						++_pos;
 					}
@@ -1156,7 +2283,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				if (_pos > 0) {
 					_history.reset_recall_most_recent();
 					_killRing.kill( _data.get(), _pos, false );
-					_data.erase( 0, _pos );
+					erase( 0, _pos );
 					_pos = 0;
 					refreshLine(pi);
 				}
@@ -1168,15 +2295,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if (_pos < _data.length()) {
 					_history.reset_recall_most_recent();
-					while ( _pos < _data.length() && is_word_break_character( _data[_pos] ) ) {
-						++ _pos;
-					}
-					while ( _pos < _data.length() && !is_word_break_character( _data[_pos] ) ) {
-						if ( _data[_pos] >= 'a' && _data[_pos] <= 'z') {
-							_data[_pos] += 'A' - 'a';
-						}
-						++ _pos;
-					}
+					change_case( CASE::UPPER );
 					refreshLine(pi);
 				}
 				break;
@@ -1186,14 +2305,15 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				if ( _pos > 0 ) {
 					_history.reset_recall_most_recent();
 					int startingPos = _pos;
-					while ( _pos > 0 && _data[_pos - 1] == ' ' ) {
-						--_pos;
+					while ( startingPos > 0 && _data[startingPos - 1] == ' ' ) {
+						-- startingPos;
 					}
-					while ( _pos > 0 && _data[_pos - 1] != ' ' ) {
-						-- _pos;
+					while ( startingPos > 0 && _data[startingPos - 1] != ' ' ) {
+						-- startingPos;
 					}
-					_killRing.kill( _data.get() + _pos, startingPos - _pos, false );
-					_data.erase( _pos, startingPos - _pos );
+					_killRing.kill( _data.get() + startingPos, _pos - startingPos, false );
+					erase( startingPos, _pos - startingPos );
+					_pos = startingPos;
 					refreshLine(pi);
 				}
 				_killRing.lastAction = KillRing::actionKill;
@@ -1202,15 +2322,17 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 			case ctrlChar('Y'): // ctrl-Y, yank killed text
 				_history.reset_recall_most_recent();
 				{
-					UnicodeString* restoredText = _killRing.yank();
+					KillRing::entry_t const* restoredText = _killRing.yank();
 					if (restoredText) {
-						_data.insert( _pos, *restoredText, 0, restoredText->length() );
-						_pos += restoredText->length();
+						// inserted straight from the ring, large kills are not copied in between
+						int restoredLen( static_cast<int>( restoredText->size() ) );
+						replace( _pos, 0, restoredText->begin(), restoredText->end() );
+						_pos += restoredLen;
 						refreshLine(pi);
 						_killRing.lastAction = KillRing::actionYank;
-						_killRing.lastYankSize = restoredText->length();
+						_killRing.lastYankSize = restoredLen;
 					} else {
-						beep();
+						_terminal.beep();
 					}
 				}
 				break;
@@ -1219,25 +2341,24 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 			case META + 'Y':
 				if (_killRing.lastAction == KillRing::actionYank) {
 					_history.reset_recall_most_recent();
-					UnicodeString* restoredText = _killRing.yankPop();
+					KillRing::entry_t const* restoredText = _killRing.yankPop();
 					if (restoredText) {
-						_pos -= _killRing.lastYankSize;
-						_data.erase( _pos, _killRing.lastYankSize );
-						_data.insert( _pos, *restoredText, 0, restoredText->length() );
-						_pos += restoredText->length();
-						_killRing.lastYankSize = restoredText->length();
+						int restoredLen( static_cast<int>( restoredText->size() ) );
+						replace( _pos - _killRing.lastYankSize, _killRing.lastYankSize, restoredText->begin(), restoredText->end() );
+						_pos += restoredLen - _killRing.lastYankSize;
+						_killRing.lastYankSize = restoredLen;
 						refreshLine(pi);
 						break;
 					}
 				}
-				beep();
+				_terminal.beep();
 				break;
 
 #ifndef _WIN32
 			case ctrlChar('Z'): // ctrl-Z, job control
-				disableRawMode(); // Returning to Linux (whatever) shell, leave raw mode
+				_terminal.disableRawMode(); // Returning to Linux (whatever) shell, leave raw mode
 				raise(SIGSTOP);   // Break out in mid-line
-				enableRawMode();  // Back from Linux shell, re-enter raw mode
+				_terminal.enableRawMode();  // Back from Linux shell, re-enter raw mode
 				// Redraw prompt
 				pi.write();
 				refreshLine(pi);  // Refresh the line
@@ -1250,7 +2371,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				_killRing.lastAction = KillRing::actionOther;
 				if (_data.length() > 0 && _pos < _data.length()) {
 					_history.reset_recall_most_recent();
-					_data.erase( _pos );
+					erase( _pos, 1 );
 					refreshLine(pi);
 				}
 				break;
@@ -1269,12 +2390,28 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 				}
 				if ( ! _history.is_empty() ) {
 					_history.jump( (c == META + '<' || c == PAGE_UP_KEY) );
-					_data.assign( _history.current().c_str() );
+					set_input( UnicodeString( _history.current() ) );
 					_pos = _data.length();
 					refreshLine(pi);
 				}
 				break;
 
+			case ctrlChar('_'): // ctrl-_, undo last edit
+			case META + '_': {  // meta-_, redo last undone edit
+				_killRing.lastAction = KillRing::actionOther;
+				_history.reset_recall_most_recent();
+				UndoJournal::Change change;
+				if ( c == ctrlChar('_') ? _undo.undo( change ) : _undo.redo( change ) ) {
+					_data.erase( change.pos, change.removedLen );
+					_data.insert( change.pos, change.text, change.text + change.len );
+					changed( change.pos, change.removedLen, change.len );
+					_pos = change.cursor;
+					refreshLine(pi);
+				} else {
+					_terminal.beep();
+				}
+			} break;
+
 			// not one of our special characters, maybe insert it in the buffer
 			default: {
 				next = insert_character( pi, c );
@@ -1285,6 +2422,7 @@ int Replxx::ReplxxImpl::getInputLine(PromptBase& pi) {
 			_prefix = _pos;
 		}
 	}
+	_profiler.end_keystroke();
 	return ( next == NEXT::RETURN ? _data.length() : -1 );
 }
 
@@ -1296,23 +2434,31 @@ Replxx::ReplxxImpl::NEXT Replxx::ReplxxImpl::insert_character( PromptBase& pi, i
 	 * don't insert control characters
 	 */
 	if ( ( c & (META | CTRL ) ) || isControlChar( c ) ) {
-		beep();
+		_terminal.beep();
 		return ( NEXT::CONTINUE );
 	}
-	_data.insert( _pos, c );
+	char32_t typed( static_cast<char32_t>( c ) );
+	replace( _pos, 0, &typed, &typed + 1, true );
 	++ _pos;
-	int inputLen = calculateColumnPosition( _data.get(), _data.length() );
-	if ( _noColor
-		|| ( ! ( !! _highlighterCallback || !! _hintCallback )
+	// layout follows edits, width and line count of the input are known without measuring it
+	_layout.update( _data.get(), _data.length(), pi.promptIndentation, pi.promptScreenColumns );
+	bool singleLine( _layout.line_count() == 1 );
+	int inputLen( _layout.line_width( 0 ) );
+	if ( singleLine && ( _noColor
+		|| ( ! ( !! _highlighterCallback || has_hinter() )
 			&& ( pi.promptIndentation + inputLen < pi.promptScreenColumns )
 		)
-	) {
+	) ) {
 		/* Avoid a full assign of the line in the
 		 * trivial case. */
 		if (inputLen > pi.promptPreviousInputLen) {
 			pi.promptPreviousInputLen = inputLen;
 		}
-		write32(reinterpret_cast<char32_t*>(&c), 1);
+		_terminal.write32(reinterpret_cast<char32_t*>(&c), 1);
+#ifndef _WIN32
+	} else if ( echo_and_patch( pi, static_cast<char32_t>( c ) ) ) {
+		/* Character is already on screen, highlighting and hints were patched. */
+#endif
 	} else {
 		refreshLine(pi);
 	}
@@ -1328,7 +2474,7 @@ void Replxx::ReplxxImpl::commonPrefixSearch(PromptBase& pi, int startChar) {
 			_utf8Buffer.get(), prefixSize, ( startChar == ( META + 'p' ) ) || ( startChar == ( META + 'P' ) )
 		)
 	) {
-		_data.assign( _history.current() );
+		set_input( UnicodeString( _history.current() ) );
 		_pos = _data.length();
 		refreshLine(pi);
 	}
@@ -1354,8 +2500,10 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 	int historyLinePosition( _pos );
 	UnicodeString empty;
 	_data.swap( empty );
+	changed( 0, empty.length(), 0 );
 	refreshLine(pi); // erase the old input first
 	_data.swap( empty );
+	changed( 0, 0, _data.length() );
 
 	DynamicPrompt dp(pi, (startChar == ctrlChar('R')) ? -1 : 1);
 
@@ -1371,7 +2519,7 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 	bool searchAgain = false;
 	UnicodeString activeHistoryLine;
 	while ( keepLooping ) {
-		c = read_char();
+		c = read_keystroke();
 		c = cleanupCtrl(c); // convert CTRL + <char> into normal ctrl
 
 		switch (c) {
@@ -1432,8 +2580,8 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 			case ctrlChar('S'):
 			case ctrlChar('R'):
 				if ( dp.searchText.length() == 0 ) { // if no current search text, recall previous text
-					if ( previousSearchText.length() > 0 ) {
-						dp.searchText = previousSearchText;
+					if ( _previousSearchText.length() > 0 ) {
+						dp.searchText = _previousSearchText;
 					}
 				}
 				if ((dp.direction == 1 && c == ctrlChar('R')) ||
@@ -1448,9 +2596,9 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 // job control is its own thing
 #ifndef _WIN32
 			case ctrlChar('Z'): { // ctrl-Z, job control
-				disableRawMode(); // Returning to Linux (whatever) shell, leave raw mode
+				_terminal.disableRawMode(); // Returning to Linux (whatever) shell, leave raw mode
 				raise(SIGSTOP);   // Break out in mid-line
-				enableRawMode();  // Back from Linux shell, re-enter raw mode
+				_terminal.enableRawMode();  // Back from Linux shell, re-enter raw mode
 				dynamicRefresh(dp, activeHistoryLine.get(), activeHistoryLine.length(), historyLinePosition);
 				continue;
 			} break;
@@ -1464,7 +2612,7 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 					dp.updateSearchPrompt();
 					_history.reset_pos( dp.direction == -1 ? _history.size() - 1 : 0 );
 				} else {
-					beep();
+					_terminal.beep();
 				}
 				break;
 
@@ -1476,7 +2624,7 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 					dp.searchText.insert( dp.searchText.length(), c );
 					dp.updateSearchPrompt();
 				} else {
-					beep();
+					_terminal.beep();
 				}
 			}
 		} // switch
@@ -1511,7 +2659,7 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 					activeHistoryLine.assign( _history[historySearchIndex] );
 					lineSearchPos = ( dp.direction > 0 ) ? 0 : ( activeHistoryLine.length() - dp.searchText.length() );
 				} else {
-					beep();
+					_terminal.beep();
 					break;
 				}
 			} // while
@@ -1522,11 +2670,12 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 
 	// leaving history search, restore previous prompt, maybe make searched line
 	// current
-	PromptBase pb( pi.promptScreenColumns );
+	PromptBase pb( _terminal, pi.promptScreenColumns );
+	std::vector<char32_t> lastLine;
+	pi.last_line( lastLine );
 	pb.promptChars = pi.promptIndentation;
-	pb.promptBytes = pi.promptBytes;
-	UnicodeString tempUnicode( &pi.promptText[pi.promptLastLinePosition], pb.promptBytes - pi.promptLastLinePosition );
-	pb.promptText = tempUnicode;
+	pb.promptBytes = static_cast<int>( lastLine.size() );
+	pb.promptText = UnicodeString( lastLine.data(), pb.promptBytes );
 	pb.promptExtraLines = 0;
 	pb.promptIndentation = pi.promptIndentation;
 	pb.promptLastLinePosition = 0;
@@ -1536,29 +2685,52 @@ int Replxx::ReplxxImpl::incrementalHistorySearch(PromptBase& pi, int startChar)
 	pb.promptPreviousLen = dp.promptChars;
 	if ( useSearchedLine && ( activeHistoryLine.length() > 0 ) ) {
 		_history.set_recall_most_recent();
-		_data.assign( activeHistoryLine );
+		set_input( activeHistoryLine );
 		_prefix = _pos = historyLinePosition;
 	}
 	dynamicRefresh(pb, _data.get(), _data.length(), _pos); // redraw the original prompt with current input
 	pi.promptPreviousInputLen = _data.length();
 	pi.promptCursorRowOffset = pi.promptExtraLines + pb.promptCursorRowOffset;
-	previousSearchText = dp.searchText; // save search text for possible reuse on ctrl-R ctrl-R
+	_previousSearchText = dp.searchText; // save search text for possible reuse on ctrl-R ctrl-R
 	return c; // pass a character or -1 back to main loop
 }
 
 void Replxx::ReplxxImpl::clearScreen(PromptBase& pi) {
 	clear_screen();
 	pi.write();
-#ifndef _WIN32
-	// we have to generate our own newline on line wrap on Linux
-	if (pi.promptIndentation == 0 && pi.promptExtraLines > 0) {
-		write8( "\n", 1 );
-	}
-#endif
 	pi.promptCursorRowOffset = pi.promptExtraLines;
 	refreshLine(pi);
 }
 
+/*
+ * Change case of the word at or after the cursor, cursor is moved past it.
+ */
+void Replxx::ReplxxImpl::change_case( CASE case_ ) {
+	int len( _data.length() );
+	int start( _pos );
+	while ( ( start < len ) && is_word_break_character( _data[start] ) ) {
+		++ start;
+	}
+	int end( start );
+	while ( ( end < len ) && ! is_word_break_character( _data[end] ) ) {
+		++ end;
+	}
+	UnicodeString word( _data.get() + start, end - start );
+	for ( int i( 0 ); i < word.length(); ++ i ) {
+		char32_t& c( word[i] );
+		bool upper( ( case_ == CASE::UPPER ) || ( ( case_ == CASE::CAPITALIZE ) && ( i == 0 ) ) );
+		if ( upper && ( c >= 'a' ) && ( c <= 'z' ) ) {
+			c += 'A' - 'a';
+		} else if ( ! upper && ( c >= 'A' ) && ( c <= 'Z' ) ) {
+			c += 'a' - 'A';
+		}
+	}
+	if ( ! std::equal( word.get(), word.get() + word.length(), _data.get() + start ) ) {
+		replace( start, end - start, word.get(), word.get() + word.length() );
+	}
+	_pos = end;
+}
+
 bool Replxx::ReplxxImpl::is_word_break_character( char32_t char_ ) const {
 	bool wbc( false );
 	if ( char_ < 128 ) {
@@ -1567,6 +2739,14 @@ bool Replxx::ReplxxImpl::is_word_break_character( char32_t char_ ) const {
 	return ( wbc );
 }
 
+bool Replxx::ReplxxImpl::has_completer( void ) const {
+	return ( !! _completionCallback || !! _completionDictionary || ! _completionSources.empty() );
+}
+
+bool Replxx::ReplxxImpl::has_hinter( void ) const {
+	return ( !! _hintCallback || ( _dictionaryHints && !! _completionDictionary ) );
+}
+
 void Replxx::ReplxxImpl::history_add( std::string const& line ) {
 	_history.add( line );
 }
@@ -1588,31 +2768,139 @@ std::string const& Replxx::ReplxxImpl::history_line( int index ) {
 }
 
 void Replxx::ReplxxImpl::set_completion_callback( Replxx::completion_callback_t const& fn ) {
+	_completionCache.clear();
+	if ( ! fn ) {
+		_completionCallback = nullptr;
+		return;
+	}
+	_completionCallback = [fn]( std::string const& input_, int& contextLen_, Replxx::CompletionSink& sink_ ) {
+		for ( std::string const& c : fn( input_, contextLen_ ) ) {
+			sink_.add( c );
+		}
+	};
+}
+
+void Replxx::ReplxxImpl::set_streaming_completion_callback( Replxx::streaming_completion_callback_t const& fn ) {
+	_completionCache.clear();
 	_completionCallback = fn;
 }
 
+void Replxx::ReplxxImpl::add_completion_source( Replxx::streaming_completion_callback_t const& fn, int priority_, int deadline_ ) {
+	completion_sources_t::iterator it(
+		upper_bound(
+			_completionSources.begin(), _completionSources.end(), priority_,
+			[]( int priority, CompletionSource const& source ) {
+				return ( priority > source.priority );
+			}
+		)
+	);
+	_completionSources.insert( it, CompletionSource{ fn, priority_, deadline_, nullptr } );
+	_completionCache.clear();
+}
+
+void Replxx::ReplxxImpl::clear_completion_sources( void ) {
+	_completionSources.clear();
+	_completionCache.clear();
+}
+
+void Replxx::ReplxxImpl::set_completion_dictionary( Replxx::completion_dictionary_t const& dictionary_ ) {
+	_completionDictionary = dictionary_;
+	_completionCache.clear();
+}
+
+void Replxx::ReplxxImpl::set_dictionary_hints( bool val ) {
+	_dictionaryHints = val;
+}
+
 void Replxx::ReplxxImpl::set_highlighter_callback( Replxx::highlighter_callback_t const& fn ) {
 	_highlighterCallback = fn;
+	_highlighterCall.reset();
 }
 
 void Replxx::ReplxxImpl::set_hint_callback( Replxx::hint_callback_t const& fn ) {
 	_hintCallback = fn;
+	_hintCall.reset();
+}
+
+void Replxx::ReplxxImpl::set_highlighter_deadline( int milliseconds_ ) {
+	_highlighterDeadline = milliseconds_;
+}
+
+void Replxx::ReplxxImpl::set_hint_deadline( int milliseconds_ ) {
+	_hintDeadline = milliseconds_;
+}
+
+int Replxx::ReplxxImpl::highlighter_overruns( void ) const {
+	return ( _highlighterCall.overruns() );
+}
+
+int Replxx::ReplxxImpl::hint_overruns( void ) const {
+	return ( _hintCall.overruns() );
+}
+
+void Replxx::ReplxxImpl::enable_stats( bool val_ ) {
+	_profiler.enable( val_ );
+}
+
+Replxx::Stats Replxx::ReplxxImpl::stats( void ) const {
+	Replxx::Stats s( _profiler.stats() );
+	s.highlighterOverruns = _highlighterCall.overruns();
+	s.hintOverruns = _hintCall.overruns();
+	return ( s );
+}
+
+void Replxx::ReplxxImpl::reset_stats( void ) {
+	_profiler.reset();
+}
+
+int Replxx::ReplxxImpl::set_trace_file( std::string const& filename_ ) {
+	return ( _profiler.set_trace_file( filename_ ) );
 }
 
 void Replxx::ReplxxImpl::set_max_history_size( int len ) {
 	_history.set_max_size( len );
 }
 
+void Replxx::ReplxxImpl::set_kill_ring_size( int entries, int characters ) {
+	_killRing.set_limits( entries, characters );
+}
+
 void Replxx::ReplxxImpl::set_completion_count_cutoff( int count ) {
 	_completionCountCutoff = count;
 }
 
+void Replxx::ReplxxImpl::set_max_displayed_completions( int count ) {
+	_maxDisplayedCompletions = count;
+}
+
+void Replxx::ReplxxImpl::set_completion_menu_rows( int count ) {
+	_completionMenuRows = count;
+}
+
+void Replxx::ReplxxImpl::set_incremental_completion( bool val ) {
+	_incrementalCompletion = val;
+	_completionCache.clear();
+}
+
+void Replxx::ReplxxImpl::set_quote_aware_brace_matching( bool val ) {
+	_braceIndex.set_quote_aware( val );
+}
+
+void Replxx::ReplxxImpl::set_multiline( bool val ) {
+	_multiline = val;
+}
+
 void Replxx::ReplxxImpl::set_max_hint_rows( int count ) {
 	_maxHintRows = count;
 }
 
 void Replxx::ReplxxImpl::set_word_break_characters( char const* wordBreakers ) {
 	_breakChars = wordBreakers;
+	_history.set_word_break_characters( wordBreakers );
+}
+
+void Replxx::ReplxxImpl::set_completion_ranking( bool val ) {
+	_completionRanking = val;
 }
 
 void Replxx::ReplxxImpl::set_double_tab_completion( bool val ) {
@@ -1662,13 +2950,13 @@ void dynamicRefresh(PromptBase& pi, char32_t* buf32, int len, int pos) {
 #ifdef _WIN32
 	// position at the start of the prompt, clear to end of previous input
 	CONSOLE_SCREEN_BUFFER_INFO inf;
-	GetConsoleScreenBufferInfo(console_out, &inf);
+	GetConsoleScreenBufferInfo(pi.terminal.console_out(), &inf);
 	inf.dwCursorPosition.X = 0;
 	inf.dwCursorPosition.Y -= pi.promptCursorRowOffset /*- pi.promptExtraLines*/;
-	SetConsoleCursorPosition(console_out, inf.dwCursorPosition);
+	SetConsoleCursorPosition(pi.terminal.console_out(), inf.dwCursorPosition);
 	DWORD count;
 	FillConsoleOutputCharacterA(
-		console_out, ' ',
+		pi.terminal.console_out(), ' ',
 		pi.promptPreviousLen + pi.promptPreviousInputLen,
 		inf.dwCursorPosition, &count
 	);
@@ -1679,44 +2967,44 @@ void dynamicRefresh(PromptBase& pi, char32_t* buf32, int len, int pos) {
 	pi.write();
 
 	// display the input line
-	write32( buf32, len );
+	pi.terminal.write32( buf32, len );
 
 	// position the cursor
-	GetConsoleScreenBufferInfo(console_out, &inf);
+	GetConsoleScreenBufferInfo(pi.terminal.console_out(), &inf);
 	inf.dwCursorPosition.X = xCursorPos; // 0-based on Win32
 	inf.dwCursorPosition.Y -= yEndOfInput - yCursorPos;
-	SetConsoleCursorPosition(console_out, inf.dwCursorPosition);
+	SetConsoleCursorPosition(pi.terminal.console_out(), inf.dwCursorPosition);
 #else // _WIN32
 	char seq[64];
 	int cursorRowMovement = pi.promptCursorRowOffset - pi.promptExtraLines;
 	if (cursorRowMovement > 0) { // move the cursor up as required
 		snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
-		write8( seq, strlen( seq ) );
+		pi.terminal.write8( seq, strlen( seq ) );
 	}
 	// position at the start of the prompt, clear to end of screen
 	snprintf(seq, sizeof seq, "\x1b[1G\x1b[J"); // 1-based on VT100
-	write8( seq, strlen( seq ) );
+	pi.terminal.write8( seq, strlen( seq ) );
 
 	// display the prompt
 	pi.write();
 
 	// display the input line
-	write32( buf32, len );
+	pi.terminal.write32( buf32, len );
 
 	// we have to generate our own newline on line wrap
 	if (xEndOfInput == 0 && yEndOfInput > 0) {
-		write8( "\n", 1 );
+		pi.terminal.write8( "\n", 1 );
 	}
 
 	// position the cursor
 	cursorRowMovement = yEndOfInput - yCursorPos;
 	if (cursorRowMovement > 0) { // move the cursor up as required
 		snprintf(seq, sizeof seq, "\x1b[%dA", cursorRowMovement);
-		write8( seq, strlen( seq ) );
+		pi.terminal.write8( seq, strlen( seq ) );
 	}
 	// position the cursor within the line
 	snprintf(seq, sizeof seq, "\x1b[%dG", xCursorPos + 1); // 1-based on VT100
-	write8( seq, strlen( seq ) );
+	pi.terminal.write8( seq, strlen( seq ) );
 #endif
 
 	pi.promptCursorRowOffset = pi.promptExtraLines + yCursorPos; // remember row for next pass
@@ -32,12 +32,23 @@
 #define HAVE_REPLXX_REPLXX_IMPL_HXX_INCLUDED 1
 
 #include <vector>
+#include <algorithm>
 #include <memory>
 #include <string>
 
 #include "replxx.hxx"
 #include "history.hxx"
+#include "completions.hxx"
+#include "threadpool.hxx"
+#include "deadline.hxx"
+#include "profiler.hxx"
 #include "killring.hxx"
+#include "undo.hxx"
+#include "braces.hxx"
+#include "batch.hxx"
+#include "layout.hxx"
+#include "attributes.hxx"
+#include "utf8mirror.hxx"
 #include "utf8string.hxx"
 
 namespace replxx {
@@ -52,6 +63,26 @@ public:
 	typedef std::unique_ptr<char32_t[]> input_buffer_t;
 	typedef std::vector<char> char_widths_t;
 	typedef std::vector<char32_t> display_t;
+	/*
+	 * Single screen cell of an input line, `attr` is attribute marker
+	 * in effect for the character.
+	 */
+	struct Cell {
+		char32_t ch;
+		char32_t attr;
+		bool operator == ( Cell const& other_ ) const {
+			return ( ( ch == other_.ch ) && ( attr == other_.attr ) );
+		}
+	};
+	typedef std::vector<Cell> cells_t;
+	/*
+	 * Part of display between newlines.
+	 */
+	struct DisplayLine {
+		int start;
+		int end;
+	};
+	typedef std::vector<DisplayLine> display_lines_t;
 	enum class HINT_ACTION {
 		REGENERATE,
 		REPAINT,
@@ -62,36 +93,118 @@ public:
 		RETURN,
 		BAIL
 	};
+	enum class CASE {
+		UPPER,
+		LOWER,
+		CAPITALIZE
+	};
 	static int const REPLXX_MAX_LINE = 4096;
 private:
+	struct CompletionSource {
+		Replxx::streaming_completion_callback_t callback;
+		int priority;
+		int deadline; // in milliseconds
+		std::shared_ptr<CompletionJob> job; // most recent run, may still be in progress
+	};
+	typedef std::vector<CompletionSource> completion_sources_t;
+	struct HintResult {
+		std::string input; // input hints were generated for
+		Replxx::hints_t hints;
+		int contextLen;
+		Replxx::Color color;
+	};
 	Utf8String     _utf8Buffer;
 	UnicodeString  _data;
 	char_widths_t  _charWidths; // character widths from mk_wcwidth()
-	display_t      _display;
+	Utf8Mirror     _dataUtf8;        // UTF-8 copy of _data, kept in sync by changed()
+	display_t      _display;         // input followed by hints and menu, text only
+	attr_spans_t   _spans;           // attribute runs of _display
+	attr_spans_t   _inputSpans;      // attribute runs of input from last highlight(), without brace
+	AttrTable      _attrs;           // attributes referenced by runs and by markers in patches
+	std::string    _encoded;         // scratch buffer reused by write_display()
+	long long      _generation;      // edits of _data so far, counted by changed()
+	long long      _renderedGeneration; // _generation of input on screen, -1 if screen content is unknown
+	long long      _renderedBytes;   // terminal output counter right after painting
+	int            _renderedPos;     // input position of terminal cursor
+	int            _renderedRows;    // rows below the first one taken by last painted display
+	int            _renderedBrace;   // position of highlighted matching brace, -1 if none
+	bool           _renderedBraceError;
+	std::vector<int> _renderedLineRows; // first row of each logical line of painted input
+	Layout         _layout;          // screen layout of _data, kept in sync by changed()
+	int            _displayRows;     // rows of hints and menu following input in _display
+	int            _viewportTop;     // first input row on screen when input does not fit on it, -1 if all rows are shown
+	int            _viewportRows;    // input rows shown between scroll indicators
+	display_lines_t _lines;          // scratch buffer reused by paint_lines()
+	BraceIndex     _braceIndex;      // brace matching in _data, notified by changed()
+	cells_t        _screenCells;     // last painted display, kept only when all of it is on screen
+	display_lines_t _renderedLines;  // parts of _screenCells between newlines, empty if _screenCells is unknown
+	cells_t        _wantedCells;     // scratch buffer reused by echo_and_patch()
+	display_t      _patch;
+	Replxx::colors_t _colors;        // scratch buffer reused by highlight()
+	std::string    _callbackInput;   // input passed to highlighter and hint callbacks
 	UnicodeString  _hint;
 	int _pos;    // character position in buffer ( 0 <= _pos <= _len )
 	int _prefix; // prefix length used in common prefix search
 	int _hintSelection; // Currently selected hint.
 	History _history;
 	KillRing _killRing;
+	UndoJournal _undo;
 	int _maxHintRows;
 	char const* _breakChars;
 	int _completionCountCutoff;
+	int _maxDisplayedCompletions;
+	int _completionMenuRows; // 0 means completions are listed with a pager
+	completions_t _menuItems; // completions shown in the menu, empty if menu is closed
+	int _menuSelection;
+	int _menuTop; // first visible menu item
+	bool _incrementalCompletion;
+	CompletionCache _completionCache;
 	bool _doubleTabCompletion;
 	bool _completeOnEmpty;
 	bool _beepOnAmbiguousCompletion;
 	bool _noColor;
-	Replxx::completion_callback_t _completionCallback;
+	bool _multiline;
+	bool _completionRanking;
+	Replxx::streaming_completion_callback_t _completionCallback;
 	Replxx::highlighter_callback_t _highlighterCallback;
 	Replxx::hint_callback_t _hintCallback;
+	Replxx::completion_dictionary_t _completionDictionary;
+	bool _dictionaryHints; // dictionary is used as hint source
+	completion_sources_t _completionSources; // ordered by priority
+	ThreadPool _threadPool;
+	int _highlighterDeadline; // in milliseconds, 0 means no deadline
+	int _hintDeadline;
+	DeadlineCall<Replxx::colors_t> _highlighterCall;
+	DeadlineCall<HintResult> _hintCall;
+	Terminal _terminal;
+	Profiler _profiler;
 	std::string _preloadedBuffer; // used with set_preload_buffer
+	std::unique_ptr<BatchReader> _batchReader; // non-interactive input, created on first use
+	Replxx::lines_t _batch;       // lines returned by last input_batch()
+	Replxx::Prompt _lastPrompt;   // parsed prompt of last input( std::string )
 	std::string _errorMessage;
+	UnicodeString _previousSearchText; // remembered across invocations of input()
 public:
 	ReplxxImpl( FILE*, FILE*, FILE* );
 	void set_completion_callback( Replxx::completion_callback_t const& fn );
+	void set_streaming_completion_callback( Replxx::streaming_completion_callback_t const& fn );
+	void add_completion_source( Replxx::streaming_completion_callback_t const& fn, int priority, int deadline );
+	void clear_completion_sources( void );
+	void set_highlighter_deadline( int milliseconds );
+	void set_hint_deadline( int milliseconds );
+	int highlighter_overruns( void ) const;
+	int hint_overruns( void ) const;
+	void enable_stats( bool );
+	Replxx::Stats stats( void ) const;
+	void reset_stats( void );
+	int set_trace_file( std::string const& );
+	void set_completion_dictionary( Replxx::completion_dictionary_t const& dictionary );
+	void set_dictionary_hints( bool val );
 	void set_highlighter_callback( Replxx::highlighter_callback_t const& fn );
 	void set_hint_callback( Replxx::hint_callback_t const& fn );
 	char const* input( std::string const& prompt );
+	char const* input( Replxx::Prompt const& prompt );
+	Replxx::lines_t const& input_batch( std::string const& prompt, int count );
 	void history_add( std::string const& line );
 	int history_save( std::string const& filename );
 	int history_load( std::string const& filename );
@@ -101,15 +214,24 @@ public:
 	void set_word_break_characters( char const* wordBreakers );
 	void set_max_hint_rows( int count );
 	void set_double_tab_completion( bool val );
+	void set_completion_ranking( bool val );
 	void set_complete_on_empty( bool val );
 	void set_beep_on_ambiguous_completion( bool val );
 	void set_no_color( bool val );
 	void set_max_history_size( int len );
+	void set_kill_ring_size( int entries, int characters );
 	void set_completion_count_cutoff( int len );
+	void set_max_displayed_completions( int count );
+	void set_completion_menu_rows( int count );
+	void set_incremental_completion( bool val );
+	void set_quote_aware_brace_matching( bool val );
+	void set_multiline( bool val );
 	void clear_screen( void );
 	int install_window_change_handler( void );
-	completions_t call_completer( std::string const& input, int& ) const;
-	hints_t call_hinter( std::string const& input, int&, Replxx::Color& color ) const;
+	void call_completer( std::string const& input, int&, Replxx::CompletionSink& );
+	void call_completion_sources( std::string const& input, int&, Replxx::CompletionSink& );
+	hints_t call_hinter( std::string const& input, int&, Replxx::Color& color );
+	void rank( std::vector<std::string>& ) const;
 	int print( char const* , int );
 private:
 	ReplxxImpl( ReplxxImpl const& ) = delete;
@@ -119,17 +241,48 @@ private:
 	int getInputLine( PromptBase& pi );
 	NEXT insert_character( PromptBase&, int );
 	char const* read_from_stdin( void );
+	int read_batch( int );
 	void clearScreen(PromptBase& pi);
 	int incrementalHistorySearch(PromptBase& pi, int startChar);
 	void commonPrefixSearch(PromptBase& pi, int startChar);
 	int completeLine(PromptBase& pi);
+	int completion_menu( PromptBase&, completions_t&, int );
+	void fetch_completions( int&, CompletionCollector& );
+	void render_menu( PromptBase& );
 	void refreshLine(PromptBase& pi, HINT_ACTION = HINT_ACTION::REGENERATE);
+	void paint( PromptBase&, int );
+#ifndef _WIN32
+	void paint_lines( PromptBase&, int, int, int, int );
+	bool echo_and_patch( PromptBase&, char32_t );
+	bool move_cursor( PromptBase& );
+	void paint_viewport( PromptBase&, int, int );
+	void leave_viewport( PromptBase& );
+	void remember_screen( void );
+#endif
+	int viewport_row( int ) const;
+	void refresh_cursor( PromptBase& );
+	int line_boundary( PromptBase&, bool );
+	bool move_line( PromptBase&, bool );
 	void highlight( int, bool );
+	void render_display( int, bool );
+	char32_t read_keystroke( void );
+	void repaint_on_late_results( PromptBase& );
+	int worker_count( void ) const;
 	int handle_hints( PromptBase&, HINT_ACTION );
 	void setColor( Replxx::Color );
+	void write_display( char32_t const*, int );
+	void write_display( void );
 	int context_length( void );
 	void clear();
+	template<typename iterator_t>
+	void replace( int, int, iterator_t, iterator_t, bool = false );
+	void erase( int, int );
+	void set_input( UnicodeString const& );
+	void changed( int, int, int );
+	void change_case( CASE );
 	bool is_word_break_character( char32_t ) const;
+	bool has_completer( void ) const;
+	bool has_hinter( void ) const;
 };
 
 }
@@ -0,0 +1,60 @@
+#include <thread>
+
+#include "threadpool.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+ThreadPool::ThreadPool( void )
+	: _state( make_shared<State>() )
+	, _workers() {
+	_state->stop = false;
+}
+
+ThreadPool::~ThreadPool( void ) {
+	{
+		lock_guard<mutex> l( _state->mutex );
+		_state->stop = true;
+		_state->tasks.clear();
+		_state->wakeup.notify_all();
+	}
+	for ( thread& worker : _workers ) {
+		worker.join();
+	}
+}
+
+/*
+ * Threads are started lazily so applications not using
+ * asynchronous features do not pay for them.
+ */
+void ThreadPool::ensure_size( int size_ ) {
+	while ( size() < size_ ) {
+		_workers.emplace_back( &ThreadPool::work, _state );
+	}
+}
+
+void ThreadPool::post( task_t const& task_ ) {
+	lock_guard<mutex> l( _state->mutex );
+	_state->tasks.push_back( task_ );
+	_state->wakeup.notify_one();
+}
+
+void ThreadPool::work( state_t state_ ) {
+	while ( true ) {
+		task_t task;
+		{
+			unique_lock<mutex> l( state_->mutex );
+			state_->wakeup.wait( l, [&state_]() { return ( state_->stop || ! state_->tasks.empty() ); } );
+			if ( state_->stop ) {
+				return;
+			}
+			task = std::move( state_->tasks.front() );
+			state_->tasks.pop_front();
+		}
+		task();
+	}
+}
+
+}
+
@@ -0,0 +1,50 @@
+#ifndef REPLXX_THREADPOOL_HXX_INCLUDED
+#define REPLXX_THREADPOOL_HXX_INCLUDED 1
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+namespace replxx {
+
+/*
+ * Fixed set of worker threads executing posted tasks.
+ *
+ * Tasks still waiting in the queue are dropped on destruction
+ * and workers are joined, so destruction waits for tasks that are
+ * already running and no task outlives the callbacks it calls.
+ */
+class ThreadPool {
+public:
+	typedef std::function<void ( void )> task_t;
+private:
+	struct State {
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		std::deque<task_t> tasks;
+		bool stop;
+	};
+	typedef std::shared_ptr<State> state_t;
+	state_t _state;
+	std::vector<std::thread> _workers;
+public:
+	ThreadPool( void );
+	~ThreadPool( void );
+	void post( task_t const& task );
+	void ensure_size( int size );
+	int size( void ) const {
+		return ( static_cast<int>( _workers.size() ) );
+	}
+private:
+	static void work( state_t );
+	ThreadPool( ThreadPool const& ) = delete;
+	ThreadPool& operator = ( ThreadPool const& ) = delete;
+};
+
+}
+
+#endif
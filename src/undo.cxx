@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "undo.hxx"
+
+using namespace std;
+
+namespace replxx {
+
+int const UndoJournal::DEFAULT_MAX_CHARS;
+
+UndoJournal::UndoJournal( void )
+	: _entries()
+	, _pool()
+	, _current( 0 )
+	, _maxChars( DEFAULT_MAX_CHARS ) {
+}
+
+/*
+ * Start journal of new input, nothing can be undone.
+ */
+void UndoJournal::reset( void ) {
+	_entries.clear();
+	_pool.clear();
+	_current = 0;
+}
+
+/*
+ * Journal replacement of `removedLen_` characters at `pos_` with
+ * `insertedLen_` characters, `text_` holds removed characters followed
+ * by inserted ones. `cursor_` is where undo puts the cursor back,
+ * `typed_` tells that the edit is a typed character.
+ */
+void UndoJournal::record( int pos_, char32_t const* text_, int removedLen_, int insertedLen_, int cursor_, bool typed_ ) {
+	if ( ( removedLen_ == 0 ) && ( insertedLen_ == 0 ) ) {
+		return;
+	}
+	// undone entries cannot be redone after new edit
+	if ( _current < static_cast<int>( _entries.size() ) ) {
+		_entries.resize( _current );
+		_pool.resize( _current > 0 ? _entries.back().offset + _entries.back().removedLen + _entries.back().insertedLen : 0 );
+	}
+	bool typed( typed_ && ( removedLen_ == 0 ) && ( insertedLen_ == 1 ) );
+	Entry* last( ! _entries.empty() ? &_entries.back() : nullptr );
+	if (
+		typed && last && last->typed
+		&& ( pos_ == ( last->pos + last->insertedLen ) )
+		&& ! ( ( text_[0] == ' ' ) && ( _pool.back() != ' ' ) )
+	) {
+		_pool.push_back( text_[0] );
+		++ last->insertedLen;
+	} else {
+		_entries.push_back( Entry{ pos_, removedLen_, insertedLen_, static_cast<int>( _pool.size() ), cursor_, typed } );
+		_pool.insert( _pool.end(), text_, text_ + removedLen_ + insertedLen_ );
+	}
+	_current = static_cast<int>( _entries.size() );
+	trim();
+}
+
+/*
+ * Drop oldest entries when the pool is over its limit, to 3/4 of it
+ * so that the pool is not shifted on every following edit.
+ */
+void UndoJournal::trim( void ) {
+	int count( static_cast<int>( _entries.size() ) );
+	int poolSize( static_cast<int>( _pool.size() ) );
+	if ( ( _maxChars <= 0 ) || ( poolSize <= _maxChars ) || ( count < 2 ) ) {
+		return;
+	}
+	int target( _maxChars - _maxChars / 4 );
+	int dropped( 1 );
+	while ( ( dropped < ( count - 1 ) ) && ( ( poolSize - _entries[dropped].offset ) > target ) ) {
+		++ dropped;
+	}
+	int base( _entries[dropped].offset );
+	_pool.erase( _pool.begin(), _pool.begin() + base );
+	_entries.erase( _entries.begin(), _entries.begin() + dropped );
+	for ( Entry& e : _entries ) {
+		e.offset -= base;
+	}
+	_current = max( _current - dropped, 0 );
+}
+
+bool UndoJournal::undo( Change& change_ ) {
+	if ( _current == 0 ) {
+		return ( false );
+	}
+	-- _current;
+	Entry const& e( _entries[_current] );
+	change_ = Change{ e.pos, e.insertedLen, _pool.data() + e.offset, e.removedLen, e.cursor };
+	return ( true );
+}
+
+bool UndoJournal::redo( Change& change_ ) {
+	if ( _current == static_cast<int>( _entries.size() ) ) {
+		return ( false );
+	}
+	Entry const& e( _entries[_current] );
+	++ _current;
+	change_ = Change{ e.pos, e.removedLen, _pool.data() + e.offset + e.removedLen, e.insertedLen, e.pos + e.insertedLen };
+	return ( true );
+}
+
+}
+
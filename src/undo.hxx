@@ -0,0 +1,63 @@
+#ifndef REPLXX_UNDO_HXX_INCLUDED
+#define REPLXX_UNDO_HXX_INCLUDED 1
+
+#include <vector>
+
+namespace replxx {
+
+/*
+ * Journal of edits of the input for undo and redo.
+ *
+ * Each entry replaces a range of the input and keeps only characters
+ * it removed and inserted, so undoing or redoing it costs the size
+ * of the edit. Texts of all entries are kept back to back in a single
+ * pool that is reused between input lines.
+ *
+ * Edits are passed to record() where they are made, every kind
+ * of edit - typing, kills, yanks, completions and history recalls -
+ * is journaled the same way, cursor movement is not journaled.
+ * Typed characters inserted one after another coalesce into single
+ * entry, a run ends when a space follows other character.
+ * Oldest entries are dropped when the pool grows past `maxChars`.
+ */
+class UndoJournal {
+	struct Entry {
+		int pos;          // start of replaced range
+		int removedLen;
+		int insertedLen;
+		int offset;       // in _pool, removed characters followed by inserted ones
+		int cursor;       // before the edit, cursor after it is at the end of inserted characters
+		bool typed;       // run of typed characters, may be extended
+	};
+	std::vector<Entry> _entries;
+	std::vector<char32_t> _pool;
+	int _current;                // entries before it are applied, following ones are undone
+	int _maxChars;
+public:
+	/*
+	 * Edit to apply for undo() or redo(): `removedLen` characters at `pos`
+	 * are replaced with `len` characters of `text`, cursor goes to `cursor`.
+	 */
+	struct Change {
+		int pos;
+		int removedLen;
+		char32_t const* text;
+		int len;
+		int cursor;
+	};
+	static int const DEFAULT_MAX_CHARS = 1024 * 1024;
+	UndoJournal( void );
+	void reset( void );
+	void record( int, char32_t const*, int, int, int, bool );
+	bool undo( Change& );
+	bool redo( Change& );
+private:
+	void trim( void );
+	UndoJournal( UndoJournal const& ) = delete;
+	UndoJournal& operator = ( UndoJournal const& ) = delete;
+};
+
+}
+
+#endif
+
@@ -93,6 +93,12 @@ public:
 		return *this;
 	}
 
+	template<typename iterator_t>
+	UnicodeString& insert( int pos_, iterator_t first_, iterator_t last_ ) {
+		_data.insert( _data.begin() + pos_, first_, last_ );
+		return *this;
+	}
+
 	UnicodeString& insert( int pos_, char32_t c_ ) {
 		_data.insert( _data.begin() + pos_, c_ );
 		return *this;
@@ -0,0 +1,58 @@
+#include "utf8mirror.hxx"
+#include "conversion.hxx"
+
+namespace replxx {
+
+Utf8Mirror::Utf8Mirror( void )
+	: _bytes()
+	, _sizes()
+	, _offsets( 1, 0 )
+	, _changed() {
+}
+
+void Utf8Mirror::clear( void ) {
+	_bytes.clear();
+	_sizes.clear();
+	_offsets.assign( 1, 0 );
+}
+
+/*
+ * Byte offset of character at `pos_`, `pos_` may be equal to length().
+ */
+int Utf8Mirror::offset( int pos_ ) const {
+	int known( static_cast<int>( _offsets.size() ) - 1 );
+	while ( known < pos_ ) {
+		_offsets.push_back( _offsets.back() + _sizes[known] );
+		++ known;
+	}
+	return ( _offsets[pos_] );
+}
+
+/*
+ * `removedLen_` characters at `pos_` were replaced with `insertedLen_`
+ * characters, `text_` is the whole text after the edit.
+ */
+void Utf8Mirror::changed( char32_t const* text_, int pos_, int removedLen_, int insertedLen_ ) {
+	int byteStart( offset( pos_ ) );
+	int oldByteEnd( offset( pos_ + removedLen_ ) );
+	_offsets.resize( pos_ + 1 );
+	_sizes.erase( _sizes.begin() + pos_, _sizes.begin() + pos_ + removedLen_ );
+	_sizes.insert( _sizes.begin() + pos_, insertedLen_, 0 );
+
+	/*
+	 * Characters are encoded one by one so that size of each is known.
+	 */
+	_changed.clear();
+	for ( int i( 0 ); i < insertedLen_; ++ i ) {
+		char buf[8];
+		int count( 0 );
+		copyString32to8( buf, static_cast<int>( sizeof ( buf ) ), text_ + pos_ + i, 1, &count );
+		_changed.append( buf, count );
+		_sizes[pos_ + i] = static_cast<char unsigned>( count );
+		_offsets.push_back( byteStart + static_cast<int>( _changed.size() ) );
+	}
+	_bytes.replace( byteStart, oldByteEnd - byteStart, _changed );
+}
+
+}
+
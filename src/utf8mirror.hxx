@@ -0,0 +1,45 @@
+#ifndef REPLXX_UTF8MIRROR_HXX_INCLUDED
+#define REPLXX_UTF8MIRROR_HXX_INCLUDED 1
+
+#include <vector>
+#include <string>
+
+namespace replxx {
+
+/*
+ * UTF-8 copy of text kept in sync with it together with byte size
+ * of each character. Every edit of the text is passed to changed()
+ * which encodes only inserted characters, so bytes of any range
+ * of characters are available without transcoding.
+ * Byte offsets of characters are summed up on demand, an edit
+ * drops only offsets of characters following it.
+ */
+class Utf8Mirror {
+	std::string _bytes;
+	std::vector<char unsigned> _sizes;  // _sizes[i] - bytes of i-th character
+	mutable std::vector<int> _offsets; // byte offsets of leading characters, at least one element
+	std::string _changed;              // scratch buffer reused by changed()
+public:
+	Utf8Mirror( void );
+	void changed( char32_t const*, int, int, int );
+	int length( void ) const {
+		return ( static_cast<int>( _sizes.size() ) );
+	}
+	char const* data( void ) const {
+		return ( _bytes.data() );
+	}
+	int size( void ) const {
+		return ( static_cast<int>( _bytes.size() ) );
+	}
+	int offset( int ) const;
+	void append( std::string& out_, int from_, int to_ ) const {
+		int from( offset( from_ ) );
+		out_.append( _bytes, from, offset( to_ ) - from );
+	}
+	void clear( void );
+};
+
+}
+
+#endif
+
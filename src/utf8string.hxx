@@ -44,6 +44,11 @@ public:
 		strncpy( _data.get(), str_.c_str(), str_.length() );
 	}
 
+	void assign( char const* str_, int len_ ) {
+		realloc( len_ );
+		memcpy( _data.get(), str_, len_ );
+	}
+
 	char const* get() const {
 		return _data.get();
 	}
@@ -17,7 +17,7 @@ namespace replxx {
 WinAttributes WIN_ATTR;
 
 template<typename T>
-T* HandleEsc(T* p, T* end) {
+T* HandleEsc(HANDLE handle, T* p, T* end) {
 	if (*p == '[') {
 		int code = 0;
 
@@ -93,7 +93,6 @@ T* HandleEsc(T* p, T* end) {
 		++p;
 	}
 
-	auto handle = GetStdHandle(STD_OUTPUT_HANDLE);
 	SetConsoleTextAttribute(
 		handle,
 		WIN_ATTR._consoleAttribute | WIN_ATTR._consoleColor
@@ -102,11 +101,11 @@ T* HandleEsc(T* p, T* end) {
 	return p;
 }
 
-int win_write( char const* str_, int size_ ) {
+int win_write( int fd_, bool tty_, char const* str_, int size_ ) {
 	int count( 0 );
 	DWORD currentMode( 0 );
-	HANDLE consoleOut( GetStdHandle( STD_OUTPUT_HANDLE ) );
-	if ( tty::out && GetConsoleMode( consoleOut, &currentMode ) ) {
+	HANDLE consoleOut( reinterpret_cast<HANDLE>( _get_osfhandle( fd_ ) ) );
+	if ( tty_ && GetConsoleMode( consoleOut, &currentMode ) ) {
 		UINT inputCodePage( GetConsoleCP() );
 		UINT outputCodePage( GetConsoleOutputCP() );
 		SetConsoleCP( 65001 );
@@ -130,7 +129,7 @@ int win_write( char const* str_, int size_ ) {
 							break;
 						}
 					}
-					str_ = s = HandleEsc( str_ + 1, e );
+					str_ = s = HandleEsc( consoleOut, str_ + 1, e );
 				} else {
 					++ str_;
 				}
@@ -144,7 +143,7 @@ int win_write( char const* str_, int size_ ) {
 		SetConsoleCP( inputCodePage );
 		SetConsoleOutputCP( outputCodePage );
 	} else {
-		count = _write( 1, str_, size_ );
+		count = _write( fd_, str_, size_ );
 	}
 	return ( count );
 }
@@ -4,6 +4,7 @@ import pexpect
 import unittest
 import re
 import os
+import json
 import subprocess
 import signal
 import time
@@ -53,6 +54,7 @@ keytab = {
 	"<c-w>": "",
 	"<c-y>": "",
 	"<c-z>": "",
+	"<c-_>": "",
 	"<m-b>": "\033b",
 	"<m-c>": "\033c",
 	"<m-d>": "\033d",
@@ -62,7 +64,9 @@ keytab = {
 	"<m-p>": "\033p",
 	"<m-u>": "\033u",
 	"<m-y>": "\033y",
+	"<m-_>": "\033_",
 	"<m-backspace>": "\033\177",
+	"<m-enter>": "\033\r",
 	"<f1>": "\033OP",
 	"<f2>": "\033OQ"
 }
@@ -89,7 +93,23 @@ termseq = {
 	"\x1b[0;1;35m": "<brightmagenta>",
 	"\x1b[0;1;36m": "<brightcyan>",
 	"\x1b[0;1;37m": "<white>",
+	"\x1b[30m": "<black>",
+	"\x1b[31m": "<red>",
+	"\x1b[32m": "<green>",
+	"\x1b[33m": "<brown>",
+	"\x1b[34m": "<blue>",
+	"\x1b[35m": "<magenta>",
+	"\x1b[36m": "<cyan>",
+	"\x1b[37m": "<lightgray>",
+	"\x1b[1;30m": "<gray>",
+	"\x1b[1;31m": "<brightred>",
 	"\x1b[1;32m": "<brightgreen>",
+	"\x1b[1;33m": "<yellow>",
+	"\x1b[1;34m": "<brightblue>",
+	"\x1b[1;35m": "<brightmagenta>",
+	"\x1b[1;36m": "<brightcyan>",
+	"\x1b[1;37m": "<white>",
+	"\x1b[1;33;101m": "<err>",
 	"\x1b[101;1;33m": "<err>",
 	"\x07": "<bell>"
 }
@@ -174,22 +194,22 @@ class ReplxxTests( unittest.TestCase ):
 	def test_unicode( self_ ):
 		self_.check_scenario(
 			"<up><cr><c-d>",
-			"<c9><ceos>aóą Ϩ 𓢀  󃔀  <rst><gray><rst><c21>"
-			"<c9><ceos>aóą Ϩ 𓢀  󃔀  <rst><c21>\r\n"
+			"<c9><ceos>aóą Ϩ 𓢀  󃔀  <c21><c9><ceos>aóą Ϩ 𓢀  󃔀  <c21>\r\n"
 			"aóą Ϩ 𓢀  󃔀  \r\n",
 			"aóą Ϩ 𓢀  󃔀  \n"
 		)
 		self_.check_scenario(
 			"aóą Ϩ 𓢀  󃔀  <cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>aó<rst><gray><rst><c11><c9><ceos>aóą<rst><gray><rst><c12><c9><ceos>aóą "
-			"<rst><gray><rst><c13><c9><ceos>aóą Ϩ<rst><gray><rst><c14><c9><ceos>aóą Ϩ "
-			"<rst><gray><rst><c15><c9><ceos>aóą Ϩ 𓢀<rst><gray><rst><c16><c9><ceos>aóą Ϩ 𓢀 "
-			"<rst><gray><rst><c17><c9><ceos>aóą Ϩ 𓢀  "
-			"<rst><gray><rst><c18><c9><ceos>aóą Ϩ 𓢀  󃔀<rst><gray><rst><c19><c9><ceos>aóą Ϩ 𓢀  󃔀 "
-			"<rst><gray><rst><c20><c9><ceos>aóą Ϩ 𓢀  󃔀  "
-			"<rst><gray><rst><c21><c9><ceos>aóą Ϩ 𓢀  󃔀  <rst><c21>\r\n"
+			"<c9><ceos>a<c10>óą Ϩ 𓢀  󃔀  <c9><ceos>aóą Ϩ 𓢀  󃔀  <c21>\r\n"
 			"aóą Ϩ 𓢀  󃔀  \r\n"
 		)
+		self_.check_scenario(
+			"<up><home><right><right>ę<left><backspace><end>ź<cr><c-d>",
+			"<c9><ceos>aóą Ϩ 𓢀  󃔀  <c21><c9><ceos>aóą Ϩ 𓢀  󃔀  <c9>\x1b[C\x1b[C<c9><ceos>aóęą Ϩ 𓢀  󃔀  <c12>\x1b[D<c9><ceos>aęą Ϩ 𓢀  󃔀  <c10>"
+			"<c9><ceos>aęą Ϩ 𓢀  󃔀  <c21>ź<c9><ceos>aęą Ϩ 𓢀  󃔀  ź<c22>\r\n"
+			"aęą Ϩ 𓢀  󃔀  ź\r\n",
+			"aóą Ϩ 𓢀  󃔀  \n"
+		)
 	@unittest.skipIf( skip( "8bit_encoding" ), "broken platform" )
 	def test_8bit_encoding( self_ ):
 		LC_CTYPE = "LC_CTYPE"
@@ -200,7 +220,7 @@ class ReplxxTests( unittest.TestCase ):
 		os.environ[LC_CTYPE] = "pl_PL.ISO-8859-2"
 		self_.check_scenario(
 			"<aup><cr><c-d>",
-			"<c9><ceos>text ~ó~<rst><gray><rst><c17><c9><ceos>text ~ó~<rst><c17>\r\ntext ~ó~\r\n",
+			"<c9><ceos>text ~ó~<c17><c9><ceos>text ~ó~<c17>\r\ntext ~ó~\r\n",
 			"text ~ó~\n",
 			encoding = "iso-8859-2"
 		)
@@ -217,130 +237,103 @@ class ReplxxTests( unittest.TestCase ):
 	def test_ctrl_c( self_ ):
 		self_.check_scenario(
 			"abc<c-c><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>abc<rst><gray><rst><c12><c9><ceos>abc<rst><c12>^C\r"
-			"\r\n"
+			"<c9><ceos>a<c10>bc<c9><ceos>abc<c12>^C\r\r\n"
 		)
 	def test_ctrl_z( self_ ):
 		self_.check_scenario(
 			"<up><c-z><cr><c-d>",
-			"<c9><ceos>three<rst><gray><rst><c14><brightgreen>replxx<rst>> "
-			"<c9><ceos>three<rst><gray><rst><c14><c9><ceos>three<rst><c14>\r\n"
+			"<c9><ceos>three<c14><brightgreen>replxx<rst>> <c9><ceos>three<c14><c9><ceos>three<c14>\r\n"
 			"three\r\n"
 		)
 		self_.check_scenario(
 			"<c-r>w<c-z><cr><c-d>",
-			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(reverse-i-search)`': "
-			"<c23><c1><ceos>(reverse-i-search)`w': "
-			"two<c25><c1><ceos>(reverse-i-search)`w': "
-			"two<c25><c1><ceos><brightgreen>replxx<rst>> "
-			"two<c10><c9><ceos>two<rst><c12>\r\n"
+			"<c9><ceos><c9><c1><ceos>(reverse-i-search)`': <c23><c1><ceos>(reverse-i-search)`w': two<c25><c1><ceos>(reverse-i-search)`w': two<c25><c1><ceos><brightgreen>replxx<rst>> two<c10>"
+			"<c9><ceos>two<c12>\r\n"
 			"two\r\n"
 		)
 	def test_ctrl_l( self_ ):
 		self_.check_scenario(
 			"<cr><cr><cr><c-l><c-d>",
-			"<c9><ceos><rst><c9>\r\n"
-			"<brightgreen>replxx<rst>> <c9><ceos><rst><c9>\r\n"
-			"<brightgreen>replxx<rst>> <c9><ceos><rst><c9>\r\n"
-			"<brightgreen>replxx<rst>> <RIS><mvhm><clr><rst><brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9>",
+			"<c9><ceos><c9>\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos><c9>\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos><c9>\r\n"
+			"<brightgreen>replxx<rst>> <RIS><mvhm><clr><rst><brightgreen>replxx<rst>> <c9><ceos><c9>",
 			end = "\r\nExiting Replxx\r\n"
 		)
 		self_.check_scenario(
 			"<cr><up><c-left><c-l><cr><c-d>",
-			"<c9><ceos><rst><c9>\r\n"
-			"<brightgreen>replxx<rst>> <c9><ceos>first "
-			"second<rst><gray><rst><c21><c9><ceos>first "
-			"second<rst><c15><RIS><mvhm><clr><rst><brightgreen>replxx<rst>> "
-			"<c9><ceos>first second<rst><c15><c9><ceos>first second<rst><c21>\r\n"
+			"<c9><ceos><c9>\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>first second<c21>"
+			"<c9><ceos>first second<c15><RIS><mvhm><clr><rst><brightgreen>replxx<rst>> <c9><ceos>first second<c15>"
+			"<c9><ceos>first second<c21>\r\n"
 			"first second\r\n",
 			"first second\n"
 		)
 	def test_backspace( self_ ):
 		self_.check_scenario(
 			"<up><c-a><m-f><c-right><backspace><backspace><backspace><backspace><cr><c-d>",
-			"<c9><ceos>one two three<rst><gray><rst><c22><c9><ceos>one two "
-			"three<rst><c9><c9><ceos>one two three<rst><c12><c9><ceos>one two "
-			"three<rst><c16><c9><ceos>one tw three<rst><c15><c9><ceos>one t "
-			"three<rst><c14><c9><ceos>one  three<rst><c13><c9><ceos>one "
-			"three<rst><c12><c9><ceos>one three<rst><c18>\r\n"
+			"<c9><ceos>one two three<c22><c9><ceos>one two three<c9>\x1b[3C\x1b[4C<c9><ceos>one tw three<c15><c9><ceos>one t three<c14>"
+			"<c9><ceos>one  three<c13><c9><ceos>one three<c12><c9><ceos>one three<c18>\r\n"
 			"one three\r\n",
 			"one two three\n"
 		)
 	def test_delete( self_ ):
 		self_.check_scenario(
 			"<up><m-b><c-left><del><c-d><del><c-d><cr><c-d>",
-			"<c9><ceos>one two three<rst><gray><rst><c22><c9><ceos>one two "
-			"three<rst><c17><c9><ceos>one two three<rst><c13><c9><ceos>one wo "
-			"three<rst><c13><c9><ceos>one o three<rst><c13><c9><ceos>one  "
-			"three<rst><c13><c9><ceos>one three<rst><c13><c9><ceos>one three<rst><c18>\r\n"
+			"<c9><ceos>one two three<c22><c9><ceos>one two three<c17>\x1b[4D<c9><ceos>one wo three<c13><c9><ceos>one o three<c13>"
+			"<c9><ceos>one  three<c13><c9><ceos>one three<c13><c9><ceos>one three<c18>\r\n"
 			"one three\r\n",
 			"one two three\n"
 		)
 	def test_home_key( self_ ):
 		self_.check_scenario(
 			"abc<home>z<cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>abc<rst><gray><rst><c12><c9><ceos>abc<rst><c9><c9><ceos>zabc<rst><c10><c9><ceos>zabc<rst><c13>\r\n"
+			"<c9><ceos>a<c10>bc<c9><ceos>abc<c9><c9><ceos>zabc<c10><c9><ceos>zabc<c13>\r\n"
 			"zabc\r\n"
 		)
 	def test_end_key( self_ ):
 		self_.check_scenario(
 			"abc<home>z<end>q<cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>abc<rst><gray><rst><c12><c9><ceos>abc<rst><c9><c9><ceos>zabc<rst><c10><c9><ceos>zabc<rst><gray><rst><c13><c9><ceos>zabcq<rst><gray><rst><c14><c9><ceos>zabcq<rst><c14>\r\n"
+			"<c9><ceos>a<c10>bc<c9><ceos>abc<c9><c9><ceos>zabc<c10><c9><ceos>zabc<c13>q<c9><ceos>zabcq<c14>\r\n"
 			"zabcq\r\n"
 		)
 	def test_left_key( self_ ):
 		self_.check_scenario(
 			"abc<left>x<aleft><left>y<cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>abc<rst><gray><rst><c12><c9><ceos>abc<rst><c11><c9><ceos>abxc<rst><c12><c9><ceos>abxc<rst><c11><c9><ceos>abxc<rst><c10><c9><ceos>aybxc<rst><c11><c9><ceos>aybxc<rst><c14>\r\n"
+			"<c9><ceos>a<c10>bc<c9><ceos>abc<c11><c9><ceos>abxc<c12>\x1b[D\x1b[D<c9><ceos>aybxc<c11><c9><ceos>aybxc<c14>\r\n"
 			"aybxc\r\n"
 		)
 	def test_right_key( self_ ):
 		self_.check_scenario(
 			"abc<home><right>x<aright>y<cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>abc<rst><gray><rst><c12><c9><ceos>abc<rst><c9><c9><ceos>abc<rst><c10><c9><ceos>axbc<rst><c11><c9><ceos>axbc<rst><c12><c9><ceos>axbyc<rst><c13><c9><ceos>axbyc<rst><c14>\r\n"
+			"<c9><ceos>a<c10>bc<c9><ceos>abc<c9>\x1b[C<c9><ceos>axbc<c11>\x1b[C<c9><ceos>axbyc<c13><c9><ceos>axbyc<c14>\r\n"
 			"axbyc\r\n"
 		)
 	def test_prev_word_key( self_ ):
 		self_.check_scenario(
 			"abc def ghi<c-left><m-left>x<cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>abc<rst><gray><rst><c12><c9><ceos>abc "
-			"<rst><gray><rst><c13><c9><ceos>abc d<rst><gray><rst><c14><c9><ceos>abc "
-			"de<rst><gray><rst><c15><c9><ceos>abc def<rst><gray><rst><c16><c9><ceos>abc "
-			"def <rst><gray><rst><c17><c9><ceos>abc def "
-			"g<rst><gray><rst><c18><c9><ceos>abc def gh<rst><gray><rst><c19><c9><ceos>abc "
-			"def ghi<rst><gray><rst><c20><c9><ceos>abc def ghi<rst><c17><c9><ceos>abc def "
-			"ghi<rst><c13><c9><ceos>abc xdef ghi<rst><c14><c9><ceos>abc xdef "
-			"ghi<rst><c21>\r\n"
+			"<c9><ceos>a<c10>bc def ghi<c9><ceos>abc def ghi<c17>\x1b[4D<c9><ceos>abc xdef ghi<c14><c9><ceos>abc xdef ghi<c21>\r\n"
 			"abc xdef ghi\r\n"
 		)
 	def test_next_word_key( self_ ):
 		self_.check_scenario(
 			"abc def ghi<home><c-right><m-right>x<cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>abc<rst><gray><rst><c12><c9><ceos>abc "
-			"<rst><gray><rst><c13><c9><ceos>abc d<rst><gray><rst><c14><c9><ceos>abc "
-			"de<rst><gray><rst><c15><c9><ceos>abc def<rst><gray><rst><c16><c9><ceos>abc "
-			"def <rst><gray><rst><c17><c9><ceos>abc def "
-			"g<rst><gray><rst><c18><c9><ceos>abc def gh<rst><gray><rst><c19><c9><ceos>abc "
-			"def ghi<rst><gray><rst><c20><c9><ceos>abc def ghi<rst><c9><c9><ceos>abc def "
-			"ghi<rst><c12><c9><ceos>abc def ghi<rst><c16><c9><ceos>abc defx "
-			"ghi<rst><c17><c9><ceos>abc defx ghi<rst><c21>\r\n"
+			"<c9><ceos>a<c10>bc def ghi<c9><ceos>abc def ghi<c9>\x1b[3C\x1b[4C<c9><ceos>abc defx ghi<c17><c9><ceos>abc defx ghi<c21>\r\n"
 			"abc defx ghi\r\n"
 		)
 	def test_hint_show( self_ ):
 		self_.check_scenario(
 			"co\r<c-d>",
-			"<c9><ceos>c<rst><gray><rst><c10><c9><ceos>co<rst><gray><rst>\r\n"
+			"<c9><ceos>c<c10>o<c9><ceos>co\r\n"
 			"        <gray>color_black<rst>\r\n"
 			"        <gray>color_red<rst>\r\n"
-			"        <gray>color_green<rst><u3><c11><c9><ceos>co<rst><c11>\r\n"
+			"        <gray>color_green<rst><u3><c11><c9><ceos>co<c11>\r\n"
 			"co\r\n"
 		)
 		self_.check_scenario(
 			"<up><cr><c-d>",
-			"<c9><ceos>zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz "
-			"<brightgreen>color_brightgreen<rst><green><rst><c15><u3><c9><ceos>zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz "
-			"<brightgreen>color_brightgreen<rst><c15>\r\n"
+			"<c9><ceos>zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz <brightgreen>color_brightgreen<rst><c15><u3>"
+			"<c9><ceos>zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz <brightgreen>color_brightgreen<rst><c15>\r\n"
 			"zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz color_brightgreen\r\n",
 			"zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz color_brightgreen\n",
 			dimensions = ( 64, 16 )
@@ -348,43 +341,38 @@ class ReplxxTests( unittest.TestCase ):
 	def test_hint_scroll_down( self_ ):
 		self_.check_scenario(
 			"co<c-down><c-down><tab><cr><c-d>",
-			"<c9><ceos>c<rst><gray><rst><c10><c9><ceos>co<rst><gray><rst>\r\n"
+			"<c9><ceos>c<c10>o<c9><ceos>co\r\n"
 			"        <gray>color_black<rst>\r\n"
 			"        <gray>color_red<rst>\r\n"
-			"        "
-			"<gray>color_green<rst><u3><c11><c9><ceos>co<rst><gray>lor_black<rst>\r\n"
+			"        <gray>color_green<rst><u3><c11><c9><ceos>co<gray>lor_black<rst>\r\n"
 			"        <gray>color_red<rst>\r\n"
 			"        <gray>color_green<rst>\r\n"
-			"        "
-			"<gray>color_brown<rst><u3><c11><c9><ceos>co<rst><gray>lor_red<rst>\r\n"
+			"        <gray>color_brown<rst><u3><c11><c9><ceos>co<gray>lor_red<rst>\r\n"
 			"        <gray>color_green<rst>\r\n"
 			"        <gray>color_brown<rst>\r\n"
-			"        "
-			"<gray>color_blue<rst><u3><c11><c9><ceos><red>color_red<rst><green><rst><c18><c9><ceos><red>color_red<rst><c18>\r\n"
-			"color_red\r\n"
+			"        <gray>color_blue<rst><u3><c11><c9><ceos><blue>color_blue<rst><c19><c9><ceos><blue>color_blue<rst><c19>\r\n"
+			"color_blue\r\n"
 		)
 	def test_hint_scroll_up( self_ ):
 		self_.check_scenario(
 			"co<c-up><c-up><tab><cr><c-d>",
-			"<c9><ceos>c<rst><gray><rst><c10><c9><ceos>co<rst><gray><rst>\r\n"
+			"<c9><ceos>c<c10>o<c9><ceos>co\r\n"
 			"        <gray>color_black<rst>\r\n"
 			"        <gray>color_red<rst>\r\n"
-			"        "
-			"<gray>color_green<rst><u3><c11><c9><ceos>co<rst><gray>lor_normal<rst>\r\n"
+			"        <gray>color_green<rst><u3><c11><c9><ceos>co<gray>lor_normal<rst>\r\n"
 			"        <gray>co\r\n"
-			"        <gray>color_black<rst>\r\n"
-			"        "
-			"<gray>color_red<rst><u3><c11><c9><ceos>co<rst><gray>lor_white<rst>\r\n"
+			"        color_black<rst>\r\n"
+			"        <gray>color_red<rst><u3><c11><c9><ceos>co<gray>lor_white<rst>\r\n"
 			"        <gray>color_normal<rst>\r\n"
 			"        <gray>co\r\n"
-			"        "
-			"<gray>color_black<rst><u3><c11><c9><ceos><white>color_white<rst><green><rst><c20><c9><ceos><white>color_white<rst><c20>\r\n"
+			"        color_black<rst><u3><c11><c9><ceos><white>color_white<rst><c20><c9><ceos><white>color_white<rst><c20>\r\n"
 			"color_white\r\n"
 		)
 	def test_history( self_ ):
 		self_.check_scenario(
 			"<up><up><up><up><down><down><down><down>four<cr><c-d>",
-			"<c9><ceos>three<rst><gray><rst><c14><c9><ceos>two<rst><gray><rst><c12><c9><ceos>one<rst><gray><rst><c12><c9><ceos>two<rst><gray><rst><c12><c9><ceos>three<rst><gray><rst><c14><c9><ceos><rst><gray><rst><c9><c9><ceos>f<rst><gray><rst><c10><c9><ceos>fo<rst><gray><rst><c11><c9><ceos>fou<rst><gray><rst><c12><c9><ceos>four<rst><gray><rst><c13><c9><ceos>four<rst><c13>\r\n"
+			"<c9><ceos>three<c14><c9><ceos>two<c12><c9><ceos>one<c12><c9><ceos>two<c12><c9><ceos>three<c14><c9><ceos><c9>four"
+			"<c9><ceos>four<c13>\r\n"
 			"four\r\n"
 		)
 		with open( "replxx_history.txt", "rb" ) as f:
@@ -392,95 +380,381 @@ class ReplxxTests( unittest.TestCase ):
 	def test_paren_matching( self_ ):
 		self_.check_scenario(
 			"ab(cd)ef<left><left><left><left><left><left><left><cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>ab<rst><gray><rst><c11><c9><ceos>ab<brightmagenta>(<rst><gray><rst><c12><c9><ceos>ab<brightmagenta>(<rst>c<rst><gray><rst><c13><c9><ceos>ab<brightmagenta>(<rst>cd<rst><gray><rst><c14><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst><gray><rst><c15><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>e<rst><gray><rst><c16><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<rst><gray><rst><c17><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<rst><c16><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<rst><c15><c9><ceos>ab<brightred>(<rst>cd<brightmagenta>)<rst>ef<rst><c14><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<rst><c13><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<rst><c12><c9><ceos>ab<brightmagenta>(<rst>cd<brightred>)<rst>ef<rst><c11><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<rst><c10><c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<rst><c17>\r\n"
+			"<c9><ceos>a<c10>b(<c11><brightmagenta>(<rst><c12>cd)<c14><brightmagenta>)<rst><c15>ef"
+			"<c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<c16>\x1b[D\x1b[4D<brightred>(<rst><c14>\x1b[3D<brightmagenta>(<rst><c13>\x1b[D\x1b[2C<brightred>)<rst><c11>\x1b[3C<brightmagenta>)<rst><c10>"
+			"<c9><ceos>ab<brightmagenta>(<rst>cd<brightmagenta>)<rst>ef<c17>\r\n"
 			"ab(cd)ef\r\n"
 		)
 	def test_paren_not_matched( self_ ):
 		self_.check_scenario(
 			"a(b[c)d<left><left><left><left><left><left><left><cr><c-d>",
-			"<c9><ceos>a<rst><gray><rst><c10><c9><ceos>a<brightmagenta>(<rst><gray><rst><c11><c9><ceos>a<brightmagenta>(<rst>b<rst><gray><rst><c12><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst><gray><rst><c13><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<rst><gray><rst><c14><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst><gray><rst><c15><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><gray><rst><c16><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><c15><c9><ceos>a<err>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><c14><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><c13><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><c12><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><c11><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<err>)<rst>d<rst><c10><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><c9><c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<rst><c16>\r\n"
+			"<c9><ceos>a<c10>(<c10><brightmagenta>(<rst><c11>b[<c12><brightmagenta>[<rst><c13>c)<c14><brightmagenta>)<rst><c15>d"
+			"<c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<c15>\x1b[5D<err>(<rst><c14>\x1b[4D<brightmagenta>(<rst><c13>\x1b[D\x1b[D\x1b[3C<err>)<rst><c10>\x1b[4C<brightmagenta>)<rst><c9>"
+			"<c9><ceos>a<brightmagenta>(<rst>b<brightmagenta>[<rst>c<brightmagenta>)<rst>d<c16>\r\n"
 			"a(b[c)d\r\n"
 		)
 	def test_tab_completion( self_ ):
 		self_.check_scenario(
 			"co<tab><tab>bri<tab>b<tab><cr><c-d>",
-			"<c9><ceos>c<rst><gray><rst><c10><c9><ceos>co<rst><gray><rst>\r\n"
+			"<c9><ceos>c<c10>o<c9><ceos>co\r\n"
 			"        <gray>color_black<rst>\r\n"
 			"        <gray>color_red<rst>\r\n"
-			"        <gray>color_green<rst><u3><c11><c9><ceos>color_<rst><gray><rst>\r\n"
+			"        <gray>color_green<rst><u3><c11><c9><ceos>color_\r\n"
 			"        <gray>color_black<rst>\r\n"
 			"        <gray>color_red<rst>\r\n"
-			"        <gray>color_green<rst><u3><c15><c9><ceos>color_<rst><c15>\r\n"
-			"<brightmagenta>color_<rst>black          "
-			"<brightmagenta>color_<rst>cyan           "
-			"<brightmagenta>color_<rst>brightblue\r\n"
-			"<brightmagenta>color_<rst>red            "
-			"<brightmagenta>color_<rst>lightgray      "
-			"<brightmagenta>color_<rst>brightmagenta\r\n"
-			"<brightmagenta>color_<rst>green          "
-			"<brightmagenta>color_<rst>gray           "
-			"<brightmagenta>color_<rst>brightcyan\r\n"
-			"<brightmagenta>color_<rst>brown          "
-			"<brightmagenta>color_<rst>brightred      <brightmagenta>color_<rst>white\r\n"
-			"<brightmagenta>color_<rst>blue           "
-			"<brightmagenta>color_<rst>brightgreen    <brightmagenta>color_<rst>normal\r\n"
-			"<brightmagenta>color_<rst>magenta        <brightmagenta>color_<rst>yellow\r\n"
-			"<brightgreen>replxx<rst>> <c9><ceos>color_<rst><gray><rst>\r\n"
+			"        <gray>color_green<rst><u3><c15><c9><ceos>color_<c15>\r\n"
+			"<brightmagenta>color_<rst>black          <brightmagenta>color_<rst>brightred      <brightmagenta>color_<rst>magenta\r\n"
+			"<brightmagenta>color_<rst>blue           <brightmagenta>color_<rst>brown          <brightmagenta>color_<rst>normal\r\n"
+			"<brightmagenta>color_<rst>brightblue     <brightmagenta>color_<rst>cyan           <brightmagenta>color_<rst>red\r\n"
+			"<brightmagenta>color_<rst>brightcyan     <brightmagenta>color_<rst>gray           <brightmagenta>color_<rst>white\r\n"
+			"<brightmagenta>color_<rst>brightgreen    <brightmagenta>color_<rst>green          <brightmagenta>color_<rst>yellow\r\n"
+			"<brightmagenta>color_<rst>brightmagenta  <brightmagenta>color_<rst>lightgray\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>color_\r\n"
 			"        <gray>color_black<rst>\r\n"
 			"        <gray>color_red<rst>\r\n"
-			"        <gray>color_green<rst><u3><c15><c9><ceos>color_b<rst><gray><rst>\r\n"
+			"        <gray>color_green<rst><u3><c15><c9><ceos>color_b\r\n"
 			"        <gray>color_black<rst>\r\n"
 			"        <gray>color_brown<rst>\r\n"
-			"        <gray>color_blue<rst><u3><c16><c9><ceos>color_br<rst><gray><rst>\r\n"
+			"        <gray>color_blue<rst><u3><c16><c9><ceos>color_br\r\n"
 			"        <gray>color_brown<rst>\r\n"
 			"        <gray>color_brightred<rst>\r\n"
-			"        "
-			"<gray>color_brightgreen<rst><u3><c17><c9><ceos>color_bri<rst><gray><rst>\r\n"
+			"        <gray>color_brightgreen<rst><u3><c17><c9><ceos>color_bri\r\n"
 			"        <gray>color_brightred<rst>\r\n"
 			"        <gray>color_brightgreen<rst>\r\n"
-			"        "
-			"<gray>color_brightblue<rst><u3><c18><c9><ceos>color_bright<rst><gray><rst>\r\n"
+			"        <gray>color_brightblue<rst><u3><c18><c9><ceos>color_bright\r\n"
 			"        <gray>color_brightred<rst>\r\n"
 			"        <gray>color_brightgreen<rst>\r\n"
-			"        "
-			"<gray>color_brightblue<rst><u3><c21><c9><ceos>color_brightb<rst><green>lue<rst><c22><c9><ceos><brightblue>color_brightblue<rst><green><rst><c25><c9><ceos><brightblue>color_brightblue<rst><c25>\r\n"
+			"        <gray>color_brightblue<rst><u3><c21><c9><ceos>color_brightb<green>lue<rst><c22>"
+			"<c9><ceos><brightblue>color_brightblue<rst><c25><c9><ceos><brightblue>color_brightblue<rst><c25>\r\n"
 			"color_brightblue\r\n"
 		)
 		self_.check_scenario(
 			"<tab><tab>n<cr><c-d>",
-			"<bell><bell><c9><ceos>n<rst><gray><rst><c10><c9><ceos>n<rst><c10>\r\nn\r\n",
+			"<bell><bell><c9><ceos>n<c10><c9><ceos>n<c10>\r\n"
+			"n\r\n",
 			dimensions = ( 4, 32 ),
 			command = ReplxxTests._cSample_ + " q1 e0"
 		)
 		self_.check_scenario(
 			"<tab><tab>n<cr><c-d>",
-			"<c9><ceos><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"<brightmagenta><rst>db\r\n"
 			"<brightmagenta><rst>hello\r\n"
 			"<brightmagenta><rst>hallo\r\n"
-			"--More--<bell>\r"
-			"\t\t\t\t\r"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"--More--<bell>\r\t\t\t\t\r<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			dimensions = ( 4, 24 ),
 			command = ReplxxTests._cSample_ + " q1 e1"
 		)
 		self_.check_scenario(
 			"<up><home>co<tab><cr><c-d>",
-			"<c9><ceos>abcd<brightmagenta>()<rst><gray><rst><c15>"
-			"<c9><ceos>abcd<brightmagenta>()<rst><c9>"
-			"<c9><ceos>cabcd<brightmagenta>()<rst><c10>"
-			"<c9><ceos>coabcd<brightmagenta>()<rst><c11>"
-			"<c9><ceos>color_abcd<brightmagenta>()<rst><c15>"
-			"<c9><ceos>color_abcd<brightmagenta>()<rst><c21>\r\n"
+			"<c9><ceos>abcd<brightmagenta>()<rst><c15><c9><ceos>abcd<brightmagenta>()<rst><c9>"
+			"<c9><ceos>cabcd<brightmagenta>()<rst><c10><c9><ceos>coabcd<brightmagenta>()<rst><c11>"
+			"<c9><ceos>color_abcd<brightmagenta>()<rst><c15><c9><ceos>color_abcd<brightmagenta>()<rst><c21>\r\n"
 			"color_abcd()\r\n",
 			"abcd()\n"
 		)
+	def test_completion_dictionary( self_ ):
+		self_.check_scenario(
+			"se<tab><cr>h<tab><c-down><cr><c-d>",
+			"<c9><ceos>s<gray>eamann<rst><c10>e<c9><ceos>seamann<c16><c9><ceos>seamann<c16>\r\n"
+			"seamann\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>h\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst>\r\n"
+			"        <gray>hello<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"<brightmagenta>h<rst>allo       <brightmagenta>h<rst>ans        <brightmagenta>h<rst>ansekogge  <brightmagenta>h<rst>ello\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>h\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst>\r\n"
+			"        <gray>hello<rst><u4><c10><c9><ceos>h<gray>allo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst>\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>h<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"h\r\n",
+			command = ReplxxTests._cSample_ + " q1 D1 H1"
+		)
+		self_.check_scenario(
+			"se<cr><c-d>",
+			"<c9><ceos>s<c10>e<c9><ceos>se<c11>\r\n"
+			"se\r\n",
+			command = ReplxxTests._cSample_ + " q1 D1"
+		)
+	def test_completion_ranking( self_ ):
+		self_.check_scenario(
+			"h<tab><cr><c-d>",
+			"<c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hansekogge<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hallo<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"<brightmagenta>h<rst>ello       <brightmagenta>h<rst>ansekogge  <brightmagenta>h<rst>ans        <brightmagenta>h<rst>allo\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hansekogge<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hallo<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"h\r\n",
+			"hans hello\n"
+			"hansekogge\n"
+			"hello\n"
+			"hello world\n",
+			command = ReplxxTests._cSample_ + " q1 r1"
+		)
+	def test_completion_display_limit( self_ ):
+		self_.check_scenario(
+			"h<tab>y<cr><c-d>",
+			"<c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10>\r\n"
+			"Display 2 of 4 possibilities? (y or n)<ceos>\r\n"
+			"<brightmagenta>h<rst>ello  <brightmagenta>h<rst>allo\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"h\r\n",
+			command = ReplxxTests._cSample_ + " q1 c3 l2"
+		)
+	def test_completion_menu( self_ ):
+		self_.check_scenario(
+			"h<tab><down><down>an<pgdown><cr><cr><c-d>",
+			"<c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>h\r\n"
+			"        <brightmagenta>hello<rst>\r\n"
+			"        hallo<u2><c10><c9><ceos>h\r\n"
+			"        hello\r\n"
+			"        <brightmagenta>hallo<rst><u2><c10><c9><ceos>h\r\n"
+			"        hallo\r\n"
+			"        <brightmagenta>hans<rst><u2><c10><c9><ceos>ha\r\n"
+			"        <brightmagenta>hallo<rst>\r\n"
+			"        hans<u2><c11><c9><ceos>han\r\n"
+			"        <brightmagenta>hans<rst>\r\n"
+			"        hansekogge<u2><c12><c9><ceos>han\r\n"
+			"        hans\r\n"
+			"        <brightmagenta>hansekogge<rst><u2><c12><c9><ceos>hansekogge<c19><c9><ceos>hansekogge<c19>\r\n"
+			"hansekogge\r\n",
+			command = ReplxxTests._cSample_ + " q1 M2"
+		)
+	def test_completion_menu_wide( self_ ):
+		self_.check_scenario(
+			"漢<tab><tab><cr><cr><c-d>",
+			"<c9><ceos>漢\r\n"
+			"        <gray>漢字漢字漢字漢字<rst>\r\n"
+			"        <gray>漢字漢字漢字漢語<rst><u2><c11><c9><ceos>漢字漢字漢字漢\r\n"
+			"        <gray>漢字漢字漢字漢字<rst>\r\n"
+			"        <gray>漢字漢字漢字漢語<rst><u2><c7><u1><c9><ceos>漢字漢字漢字漢\r\n"
+			"        <brightmagenta>漢字漢字<rst>\r\n"
+			"        漢字漢字<u2><c7><u1><c9><ceos>漢字漢字漢字漢字<c9><u1><c9><ceos>漢字漢字漢字漢字<c9>\r\n"
+			"漢字漢字漢字漢字\r\n",
+			command = ReplxxTests._cSample_ + " q1 M2 x漢字漢字漢字漢字,漢字漢字漢字漢語",
+			dimensions = ( 25, 16 )
+		)
+	def test_incremental_completion( self_ ):
+		self_.check_scenario(
+			"h<tab>a<tab>n<tab><backspace><backspace><backspace>d<tab><cr><c-d>",
+			"<c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"<brightmagenta>h<rst>ello       <brightmagenta>h<rst>allo       <brightmagenta>h<rst>ans        <brightmagenta>h<rst>ansekogge\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>ha\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u3><c11><c9><ceos>ha<c11>\r\n"
+			"<brightmagenta>ha<rst>llo       <brightmagenta>ha<rst>ns        <brightmagenta>ha<rst>nsekogge\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>ha\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u3><c11><c9><ceos>han\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u2><c12><c9><ceos>hans\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u2><c13><c9><ceos>han\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u2><c12><c9><ceos>ha\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u3><c11><c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>hd<c11><bell><c9><ceos>hd<c11>\r\n"
+			"hd\r\n",
+			command = ReplxxTests._cSample_ + " q1 I1"
+		)
+	def test_completion_sources( self_ ):
+		self_.check_scenario(
+			"h<tab><cr><c-d>",
+			"<c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"<brightmagenta>h<rst>elp        <brightmagenta>h<rst>ans        <brightmagenta>h<rst>int        <brightmagenta>h<rst>ello       <brightmagenta>h<rst>allo       <brightmagenta>h<rst>ansekogge\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>h\r\n"
+			"        <gray>hello<rst>\r\n"
+			"        <gray>hallo<rst>\r\n"
+			"        <gray>hans<rst>\r\n"
+			"        <gray>hansekogge<rst><u4><c10><c9><ceos>h<c10>\r\n"
+			"h\r\n",
+			command = ReplxxTests._cSample_ + " q1 Shelp,hans,hint"
+		)
+	def test_callback_deadline( self_ ):
+		self_.check_scenario(
+			"a1 h<tab>e<tab><cr><c-d>",
+			"<c9><ceos>a<c10>1<c10><brightmagenta>1<rst><c11> h<c9><ceos>a<brightmagenta>1<rst> h\r\n"
+			"           <gray>hello<rst>\r\n"
+			"           <gray>hallo<rst>\r\n"
+			"           <gray>hans<rst>\r\n"
+			"           <gray>hansekogge<rst><u4><c13><c9><ceos>a<brightmagenta>1<rst> h<c13>\r\n"
+			"<brightmagenta>h<rst>ello       <brightmagenta>h<rst>allo       <brightmagenta>h<rst>ans        <brightmagenta>h<rst>ansekogge\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>a<brightmagenta>1<rst> h\r\n"
+			"           <gray>hello<rst>\r\n"
+			"           <gray>hallo<rst>\r\n"
+			"           <gray>hans<rst>\r\n"
+			"           <gray>hansekogge<rst><u4><c13><c9><ceos>a<brightmagenta>1<rst> he<gray>llo<rst><c14>"
+			"<c9><ceos>a<brightmagenta>1<rst> hello<c17><c9><ceos>a<brightmagenta>1<rst> hello<c17>\r\n"
+			"a1 hello\r\n",
+			command = ReplxxTests._cSample_ + " q1 T1000"
+		)
+	def test_latency_trace( self_ ):
+		self_.check_scenario(
+			"ab<cr><c-d>",
+			"<c9><ceos>a<c10>b<c9><ceos>ab<c11>\r\n"
+			"ab\r\n",
+			command = ReplxxTests._cSample_ + " q1 Preplxx_trace.json"
+		)
+		with open( "replxx_trace.json", "r" ) as f:
+			events = json.load( f )
+		os.remove( "replxx_trace.json" )
+		keystrokes = [e for e in events if e["name"] == "keystroke"]
+		self_.assertSequenceEqual( [e["args"]["key"] for e in keystrokes], [97, 98, 13, 4] )
+		self_.assertTrue( all( e["ph"] == "X" and e["dur"] >= 0 for e in events ) )
+		self_.assertEqual( len( [e for e in events if e["name"] == "highlight"] ), 3 )
+	def test_quote_aware_brace_matching( self_ ):
+		self_.check_scenario(
+			"(\"(\")<home><cr><c-d>",
+			"<c9><ceos>(<c10>\"(\")<c9><ceos>(\"(\")<c9><c9><ceos>(\"(\")<c14>\r\n"
+			"(\"(\")\r\n",
+			command = ReplxxTests._cSample_ + " q1"
+		)
+		self_.check_scenario(
+			"(\"(\")<home><cr><c-d>",
+			"<c9><ceos>(<c10>\"(\")<c9><ceos>(\"(\"<brightred>)<rst><c9><c9><ceos>(\"(\")<c14>\r\n"
+			"(\"(\")\r\n",
+			command = ReplxxTests._cSample_ + " q1 Q1"
+		)
+	def test_cursor_motion_on_wrapped_line( self_ ):
+		self_.check_scenario(
+			"<up><home><right><right><c-e><cr><c-d>",
+			"<c9><ceos>(abcdefghijklmn)xyz<c8><u1><c9><ceos>(abcdefghijklmn<brightred>)<rst>xyz<u1><c9>\x1b[B\x1b[5D)\x1b[A<c10>\x1b[C"
+			"<c9><ceos>(abcdefghijklmn)xyz<c8><u1><c9><ceos>(abcdefghijklmn)xyz<c8>\r\n"
+			"(abcdefghijklmn)xyz\r\n",
+			"(abcdefghijklmn)xyz\n",
+			command = ReplxxTests._cSample_ + " q1",
+			dimensions = ( 10, 20 )
+		)
+	def test_multiline( self_ ):
+		self_.check_scenario(
+			"select 1,<m-enter>2<m-enter>from t<up><up><end> x<down>3<cr><c-d>",
+			"<c9><ceos>s<gray>eamann<rst><c10>el<c12>\x1b[K<c12>ect 1<c16><brightmagenta>1<rst><c17>,"
+			"<c9><ceos>select <brightmagenta>1<rst>,\r\n"
+			"<c1><c1><ceos><brightmagenta>2<rst><c2><c1><ceos><brightmagenta>2<rst>\r\n"
+			"<c1><c1><ceos>f<c2><c1><ceos>fr<c3><c1><ceos>fro<c4><c1><ceos>from<c5><c1><ceos>from <c6><c1><ceos>from t<c7>\x1b[A<c2>\x1b[A\x1b[7C\x1b[9C<c9>select <brightmagenta>1<rst>, \x1b[K<c19><c9>select <brightmagenta>1<rst>, x\x1b[K<c20>\x1b[B\x1b[18D<c1><brightmagenta>23<rst>\x1b[K<c3>\x1b[B<c7>\r\n"
+			"select 1, x\r\n"
+			"23\r\n"
+			"from t\r\n",
+			command = ReplxxTests._cSample_ + " q1 L1"
+		)
+		self_.check_scenario(
+			"<up><m-enter><m-enter>abc<left><up><up>x<c-e><backspace><cr><c-d>",
+			"<c9><ceos><brightmagenta>0123456789012345678901234567890<rst><c20>\x1b[A"
+			"<c9><ceos><brightmagenta>0123456789012345678901234567890<rst>\r\n"
+			"<c1><c1><ceos>\r\n"
+			"<c1><c1><ceos>a<c2><c1><ceos>ab<c3><c1><ceos>abc<c4><c3>\x1b[A\x1b[2D<u2>\x1b[8C"
+			"<c9><ceos>x<brightmagenta>0123456789012345678901234567890<rst>\r\n"
+			"\r\n"
+			"\r\n"
+			"abc<u4><c10>\x1b[2B\x1b[9D<u2><c9><ceos>x<brightmagenta>012345678901234567890123456789<rst>\r\n"
+			"\r\n"
+			"abc<u2><c20>\x1b[2B<c4>\r\n"
+			"x012345678901234567890123456789\r\n"
+			"\r\n"
+			"abc\r\n",
+			"0123456789012345678901234567890\n",
+			command = ReplxxTests._cSample_ + " q1 L1",
+			dimensions = ( 10, 20 )
+		)
+	def test_viewport( self_ ):
+		self_.check_scenario(
+			"<up><home><c-right><c-right><end><c-w><c-w><c-w><c-w><cr><c-d>",
+			"<c1><ceos><gray>-- 3 rows above --<rst>\r\n"
+			"appa lambda mu nu xi\r\n"
+			" omicron pi rho sigm\r\n"
+			"a<c2><u3><c1><ceos><brightgreen>replxx<rst>> alpha beta g\r\n"
+			"amma delta epsilon z\r\n"
+			"eta eta theta iota k\r\n"
+			"<gray>-- 3 rows below --<rst><u3><c9>\x1b[5C\x1b[5C<c1><ceos><gray>-- 3 rows above --<rst>\r\n"
+			"appa lambda mu nu xi\r\n"
+			" omicron pi rho sigm\r\n"
+			"a<c2><u3><c1><ceos><gray>-- 2 rows above --<rst>\r\n"
+			"eta eta theta iota k\r\n"
+			"appa lambda mu nu xi\r\n"
+			" omicron pi rho <c17><u3><c1><ceos><gray>-- 2 rows above --<rst>\r\n"
+			"eta eta theta iota k\r\n"
+			"appa lambda mu nu xi\r\n"
+			" omicron pi <c13><u3><c1><ceos><gray>-- 2 rows above --<rst>\r\n"
+			"eta eta theta iota k\r\n"
+			"appa lambda mu nu xi\r\n"
+			" omicron <c10><u3><c1><ceos><gray>-- 2 rows above --<rst>\r\n"
+			"eta eta theta iota k\r\n"
+			"appa lambda mu nu xi\r\n"
+			" <c2><u3><c1><ceos><gray>-- 2 rows above --<rst>\r\n"
+			"eta eta theta iota k\r\n"
+			"appa lambda mu nu xi\r\n"
+			" <c2>\r\n"
+			"alpha beta gamma delta epsilon zeta eta theta iota kappa lambda mu nu xi \r\n",
+			"alpha beta gamma delta epsilon zeta eta theta iota kappa lambda mu nu xi omicron pi rho sigma\n",
+			command = ReplxxTests._cSample_ + " q1",
+			dimensions = ( 4, 20 )
+		)
+		self_.check_scenario(
+			"<up><c-a><c-k>x<cr><c-d>",
+			"<c1><ceos><gray>-- 3 rows above --<rst>\r\n"
+			"appa lambda mu nu xi\r\n"
+			" omicron pi rho sigm\r\n"
+			"a<c2><u3><c1><ceos><brightgreen>replxx<rst>> alpha beta g\r\n"
+			"amma delta epsilon z\r\n"
+			"eta eta theta iota k\r\n"
+			"<gray>-- 3 rows below --<rst><u3><c9><c1><ceos><brightgreen>replxx<rst>> <c9><ceos><c9>x<c9><ceos>x<c10>\r\n"
+			"x\r\n",
+			"alpha beta gamma delta epsilon zeta eta theta iota kappa lambda mu nu xi omicron pi rho sigma\n",
+			command = ReplxxTests._cSample_ + " q1",
+			dimensions = ( 4, 20 )
+		)
 	def test_completion_pager( self_ ):
 		cmd = ReplxxTests._cSample_ + " q1 x" + ",".join( _words_ )
 		self_.check_scenario(
 			"<tab>py<cr><c-d>",
-			"<c9><ceos><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"<brightmagenta><rst>ada         <brightmagenta><rst>groovy      <brightmagenta><rst>perl\r\n"
 			"<brightmagenta><rst>algolbash   <brightmagenta><rst>haskell     <brightmagenta><rst>php\r\n"
 			"<brightmagenta><rst>basic       <brightmagenta><rst>huginn      <brightmagenta><rst>prolog\r\n"
@@ -490,19 +764,16 @@ class ReplxxTests( unittest.TestCase ):
 			"<brightmagenta><rst>eiffel      <brightmagenta><rst>kotlin      <brightmagenta><rst>rust\r\n"
 			"<brightmagenta><rst>erlang      <brightmagenta><rst>lisp        <brightmagenta><rst>scala\r\n"
 			"<brightmagenta><rst>forth       <brightmagenta><rst>lua         <brightmagenta><rst>scheme\r\n"
-			"--More--<bell>\r"
-			"\t\t\t\t\r"
-			"<brightmagenta><rst>fortran     <brightmagenta><rst>modula      <brightmagenta><rst>sql\r\n"
+			"--More--<bell>\r\t\t\t\t\r<brightmagenta><rst>fortran     <brightmagenta><rst>modula      <brightmagenta><rst>sql\r\n"
 			"<brightmagenta><rst>fsharp      <brightmagenta><rst>nemerle     <brightmagenta><rst>swift\r\n"
 			"<brightmagenta><rst>go          <brightmagenta><rst>ocaml       <brightmagenta><rst>typescript\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			dimensions = ( 10, 40 ),
 			command = cmd
 		)
 		self_.check_scenario(
 			"<tab><cr><cr><cr><cr><c-d>",
-			"<c9><ceos><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"<brightmagenta><rst>ada         <brightmagenta><rst>groovy      <brightmagenta><rst>perl\r\n"
 			"<brightmagenta><rst>algolbash   <brightmagenta><rst>haskell     <brightmagenta><rst>php\r\n"
 			"<brightmagenta><rst>basic       <brightmagenta><rst>huginn      <brightmagenta><rst>prolog\r\n"
@@ -512,23 +783,16 @@ class ReplxxTests( unittest.TestCase ):
 			"<brightmagenta><rst>eiffel      <brightmagenta><rst>kotlin      <brightmagenta><rst>rust\r\n"
 			"<brightmagenta><rst>erlang      <brightmagenta><rst>lisp        <brightmagenta><rst>scala\r\n"
 			"<brightmagenta><rst>forth       <brightmagenta><rst>lua         <brightmagenta><rst>scheme\r\n"
-			"--More--\r"
-			"\t\t\t\t\r"
-			"<brightmagenta><rst>fortran     <brightmagenta><rst>modula      <brightmagenta><rst>sql\r\n"
-			"--More--\r"
-			"\t\t\t\t\r"
-			"<brightmagenta><rst>fsharp      <brightmagenta><rst>nemerle     <brightmagenta><rst>swift\r\n"
-			"--More--\r"
-			"\t\t\t\t\r"
-			"<brightmagenta><rst>go          <brightmagenta><rst>ocaml       <brightmagenta><rst>typescript\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"--More--\r\t\t\t\t\r<brightmagenta><rst>fortran     <brightmagenta><rst>modula      <brightmagenta><rst>sql\r\n"
+			"--More--\r\t\t\t\t\r<brightmagenta><rst>fsharp      <brightmagenta><rst>nemerle     <brightmagenta><rst>swift\r\n"
+			"--More--\r\t\t\t\t\r<brightmagenta><rst>go          <brightmagenta><rst>ocaml       <brightmagenta><rst>typescript\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			dimensions = ( 10, 40 ),
 			command = cmd
 		)
 		self_.check_scenario(
 			"<tab><c-c><cr><c-d>",
-			"<c9><ceos><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"<brightmagenta><rst>ada         <brightmagenta><rst>kotlin\r\n"
 			"<brightmagenta><rst>algolbash   <brightmagenta><rst>lisp\r\n"
 			"<brightmagenta><rst>basic       <brightmagenta><rst>lua\r\n"
@@ -537,14 +801,13 @@ class ReplxxTests( unittest.TestCase ):
 			"<brightmagenta><rst>csharp      <brightmagenta><rst>ocaml\r\n"
 			"<brightmagenta><rst>eiffel      <brightmagenta><rst>perl\r\n"
 			"--More--^C\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			dimensions = ( 8, 32 ),
 			command = cmd
 		)
 		self_.check_scenario(
 			"<tab>q<cr><c-d>",
-			"<c9><ceos><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"<brightmagenta><rst>ada         <brightmagenta><rst>kotlin\r\n"
 			"<brightmagenta><rst>algolbash   <brightmagenta><rst>lisp\r\n"
 			"<brightmagenta><rst>basic       <brightmagenta><rst>lua\r\n"
@@ -552,10 +815,7 @@ class ReplxxTests( unittest.TestCase ):
 			"<brightmagenta><rst>cobol       <brightmagenta><rst>nemerle\r\n"
 			"<brightmagenta><rst>csharp      <brightmagenta><rst>ocaml\r\n"
 			"<brightmagenta><rst>eiffel      <brightmagenta><rst>perl\r\n"
-			"--More--\r"
-			"\t\t\t\t\r"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"--More--\r\t\t\t\t\r<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			dimensions = ( 8, 32 ),
 			command = cmd
 		)
@@ -563,15 +823,14 @@ class ReplxxTests( unittest.TestCase ):
 		cmd = ReplxxTests._cSample_ + " d1 q1 x" + ",".join( _words_ )
 		self_.check_scenario(
 			"fo<tab><tab>r<tab><cr><c-d>",
-			"<c9><ceos>f<rst><gray><rst>\r\n"
+			"<c9><ceos>f\r\n"
 			"        <gray>forth<rst>\r\n"
 			"        <gray>fortran<rst>\r\n"
-			"        <gray>fsharp<rst><u3><c10><c9><ceos>fo<rst><gray><rst>\r\n"
+			"        <gray>fsharp<rst><u3><c10><c9><ceos>fo\r\n"
 			"        <gray>forth<rst>\r\n"
-			"        <gray>fortran<rst><u2><c11><c9><ceos>fort<rst><gray><rst>\r\n"
+			"        <gray>fortran<rst><u2><c11><c9><ceos>fort\r\n"
 			"        <gray>forth<rst>\r\n"
-			"        "
-			"<gray>fortran<rst><u2><c13><c9><ceos>fortr<rst><gray>an<rst><c14><c9><ceos>fortran<rst><gray><rst><c16><c9><ceos>fortran<rst><c16>\r\n"
+			"        <gray>fortran<rst><u2><c13><c9><ceos>fortr<gray>an<rst><c14><c9><ceos>fortran<c16><c9><ceos>fortran<c16>\r\n"
 			"fortran\r\n",
 			command = cmd
 		)
@@ -579,29 +838,22 @@ class ReplxxTests( unittest.TestCase ):
 		cmd = ReplxxTests._cSample_ + " b1 d1 q1 x" + ",".join( _words_ )
 		self_.check_scenario(
 			"fo<tab><tab>r<tab><cr><c-d>",
-			"<c9><ceos>f<rst><gray><rst>\r\n"
+			"<c9><ceos>f\r\n"
 			"        <gray>forth<rst>\r\n"
 			"        <gray>fortran<rst>\r\n"
-			"        <gray>fsharp<rst><u3><c10><c9><ceos>fo<rst><gray><rst>\r\n"
+			"        <gray>fsharp<rst><u3><c10><c9><ceos>fo\r\n"
 			"        <gray>forth<rst>\r\n"
-			"        <gray>fortran<rst><u2><c11><bell><c9><ceos>fort<rst><gray><rst>\r\n"
+			"        <gray>fortran<rst><u2><c11><bell><c9><ceos>fort\r\n"
 			"        <gray>forth<rst>\r\n"
-			"        "
-			"<gray>fortran<rst><u2><c13><bell><c9><ceos>fortr<rst><gray>an<rst><c14><c9><ceos>fortran<rst><gray><rst><c16><c9><ceos>fortran<rst><c16>\r\n"
+			"        <gray>fortran<rst><u2><c13><bell><c9><ceos>fortr<gray>an<rst><c14><c9><ceos>fortran<c16><c9><ceos>fortran<c16>\r\n"
 			"fortran\r\n",
 			command = cmd
 		)
 	def test_history_search_backward( self_ ):
 		self_.check_scenario(
 			"<c-r>repl<c-r><cr><c-d>",
-			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(reverse-i-search)`': "
-			"<c23><c1><ceos>(reverse-i-search)`r': echo repl "
-			"golf<c29><c1><ceos>(reverse-i-search)`re': echo repl "
-			"golf<c30><c1><ceos>(reverse-i-search)`rep': echo repl "
-			"golf<c31><c1><ceos>(reverse-i-search)`repl': echo repl "
-			"golf<c32><c1><ceos>(reverse-i-search)`repl': charlie repl "
-			"delta<c35><c1><ceos><brightgreen>replxx<rst>> charlie repl "
-			"delta<c17><c9><ceos>charlie repl delta<rst><c27>\r\n"
+			"<c9><ceos><c9><c1><ceos>(reverse-i-search)`': <c23><c1><ceos>(reverse-i-search)`r': echo repl golf<c29><c1><ceos>(reverse-i-search)`re': echo repl golf<c30><c1><ceos>(reverse-i-search)`rep': echo repl golf<c31><c1><ceos>(reverse-i-search)`repl': echo repl golf<c32><c1><ceos>(reverse-i-search)`repl': charlie repl delta<c35><c1><ceos><brightgreen>replxx<rst>> charlie repl delta<c17>"
+			"<c9><ceos>charlie repl delta<c27>\r\n"
 			"charlie repl delta\r\n",
 			"some command\n"
 			"alfa repl bravo\n"
@@ -613,35 +865,21 @@ class ReplxxTests( unittest.TestCase ):
 		)
 		self_.check_scenario(
 			"<c-r>for<backspace><backspace>s<cr><c-d>",
-			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(reverse-i-search)`': "
-			"<c23><c1><ceos>(reverse-i-search)`f': "
-			"swift<c27><c1><ceos>(reverse-i-search)`fo': "
-			"fortran<c25><c1><ceos>(reverse-i-search)`for': "
-			"fortran<c26><c1><ceos>(reverse-i-search)`fo': "
-			"fortran<c25><c1><ceos>(reverse-i-search)`f': "
-			"swift<c27><c1><ceos>(reverse-i-search)`fs': "
-			"fsharp<c25><c1><ceos><brightgreen>replxx<rst>> "
-			"fsharp<c9><c9><ceos>fsharp<rst><c15>\r\n"
+			"<c9><ceos><c9><c1><ceos>(reverse-i-search)`': <c23><c1><ceos>(reverse-i-search)`f': swift<c27><c1><ceos>(reverse-i-search)`fo': fortran<c25><c1><ceos>(reverse-i-search)`for': fortran<c26><c1><ceos>(reverse-i-search)`fo': fortran<c25><c1><ceos>(reverse-i-search)`f': swift<c27><c1><ceos>(reverse-i-search)`fs': fsharp<c25><c1><ceos><brightgreen>replxx<rst>> fsharp<c9>"
+			"<c9><ceos>fsharp<c15>\r\n"
 			"fsharp\r\n",
 			"\n".join( _words_ ) + "\n"
 		)
 		self_.check_scenario(
 			"<c-r>mod<c-l><cr><c-d>",
-			"<c9><ceos><rst><gray><rst><c9><c1><ceos>(reverse-i-search)`': "
-			"<c23><c1><ceos>(reverse-i-search)`m': "
-			"scheme<c28><c1><ceos>(reverse-i-search)`mo': "
-			"modula<c25><c1><ceos>(reverse-i-search)`mod': "
-			"modula<c26><c1><ceos><brightgreen>replxx<rst>> "
-			"<c9><RIS><mvhm><clr><rst><brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"<c9><ceos><c9><c1><ceos>(reverse-i-search)`': <c23><c1><ceos>(reverse-i-search)`m': scheme<c28><c1><ceos>(reverse-i-search)`mo': modula<c25><c1><ceos>(reverse-i-search)`mod': modula<c26><c1><ceos><brightgreen>replxx<rst>> <c9><RIS><mvhm><clr><rst><brightgreen>replxx<rst>> "
+			"<c9><ceos><c9><c9><ceos><c9>\r\n",
 			"\n".join( _words_ ) + "\n"
 		)
 	def test_history_prefix_search_backward( self_ ):
 		self_.check_scenario(
 			"repl<m-p><m-p><cr><c-d>",
-			"<c9><ceos>r<rst><gray><rst><c10><c9><ceos>re<rst><gray><rst><c11><c9><ceos>rep<rst><gray><rst><c12><c9><ceos>repl<rst><gray><rst><c13><c9><ceos>repl_echo "
-			"golf<rst><gray><rst><c23><c9><ceos>repl_charlie "
-			"delta<rst><gray><rst><c27><c9><ceos>repl_charlie delta<rst><c27>\r\n"
+			"<c9><ceos>r<c10>epl<c9><ceos>repl_echo golf<c23><c9><ceos>repl_charlie delta<c27><c9><ceos>repl_charlie delta<c27>\r\n"
 			"repl_charlie delta\r\n",
 			"some command\n"
 			"repl_alfa bravo\n"
@@ -654,17 +892,8 @@ class ReplxxTests( unittest.TestCase ):
 	def test_history_browse( self_ ):
 		self_.check_scenario(
 			"<up><aup><pgup><down><up><up><adown><pgdown><up><down><down><up><cr><c-d>",
-			"<c9><ceos>twelve<rst><gray><rst><c15>"
-			"<c9><ceos>eleven<rst><gray><rst><c15>"
-			"<c9><ceos>one<rst><gray><rst><c12>"
-			"<c9><ceos>two<rst><gray><rst><c12>"
-			"<c9><ceos>one<rst><gray><rst><c12>"
-			"<c9><ceos>two<rst><gray><rst><c12>"
-			"<c9><ceos><rst><gray><rst><c9>"
-			"<c9><ceos>twelve<rst><gray><rst><c15>"
-			"<c9><ceos><rst><gray><rst><c9>"
-			"<c9><ceos>twelve<rst><gray><rst><c15>"
-			"<c9><ceos>twelve<rst><c15>\r\n"
+			"<c9><ceos>twelve<c15><c9><ceos>eleven<c15><c9><ceos>one<c12><c9><ceos>two<c12><c9><ceos>one<c12><c9><ceos>two<c12>"
+			"<c9><ceos><c9><c9><ceos>twelve<c15><c9><ceos><c9><c9><ceos>twelve<c15><c9><ceos>twelve<c15>\r\n"
 			"twelve\r\n",
 			"one\n"
 			"two\n"
@@ -679,13 +908,22 @@ class ReplxxTests( unittest.TestCase ):
 			"eleven\n"
 			"twelve\n"
 		)
+	def test_history_preloaded_last( self_ ):
+		self_.check_scenario(
+			"<c-c><up><cr><c-d>",
+			"<c9><ceos>two<c12><c9><ceos>two<c12>^C\r\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>two<c12><c9><ceos>two<c12>\r\n"
+			"two\r\n",
+			"one\n"
+			"two\n",
+			command = ReplxxTests._cSample_ + " q1 itwo"
+		)
 	def test_history_max_size( self_ ):
 		self_.check_scenario(
 			"<pgup><pgdown>a<cr><pgup><cr><c-d>",
-			"<c9><ceos>three<rst><gray><rst><c14><c9><ceos><rst><gray><rst><c9><c9><ceos>a<rst><gray><rst><c10><c9><ceos>a<rst><c10>\r\n"
+			"<c9><ceos>three<c14><c9><ceos><c9>a<c9><ceos>a<c10>\r\n"
 			"a\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos>four<rst><gray><rst><c13><c9><ceos>four<rst><c13>\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos>four<c13><c9><ceos>four<c13>\r\n"
 			"four\r\n",
 			"one\n"
 			"two\n"
@@ -697,191 +935,115 @@ class ReplxxTests( unittest.TestCase ):
 	def test_capitalize( self_ ):
 		self_.check_scenario(
 			"<up><home><right><m-c><m-c><right><right><m-c><m-c><m-c><cr><c-d>",
-			"<c9><ceos>abc defg ijklmn zzxq<rst><gray><rst><c29><c9><ceos>abc defg ijklmn "
-			"zzxq<rst><c9><c9><ceos>abc defg ijklmn zzxq<rst><c10><c9><ceos>aBc defg "
-			"ijklmn zzxq<rst><c12><c9><ceos>aBc Defg ijklmn zzxq<rst><c17><c9><ceos>aBc "
-			"Defg ijklmn zzxq<rst><c18><c9><ceos>aBc Defg ijklmn "
-			"zzxq<rst><c19><c9><ceos>aBc Defg iJklmn zzxq<rst><c24><c9><ceos>aBc Defg "
-			"iJklmn Zzxq<rst><gray><rst><c29><c9><ceos>aBc Defg iJklmn Zzxq<rst><c29>\r\n"
+			"<c9><ceos>abc defg ijklmn zzxq<c29><c9><ceos>abc defg ijklmn zzxq<c9>\x1b[C<c9><ceos>aBc defg ijklmn zzxq<c12>"
+			"<c9><ceos>aBc Defg ijklmn zzxq<c17>\x1b[C\x1b[C<c9><ceos>aBc Defg iJklmn zzxq<c24><c9><ceos>aBc Defg iJklmn Zzxq<c29>"
+			"<c9><ceos>aBc Defg iJklmn Zzxq<c29>\r\n"
 			"aBc Defg iJklmn Zzxq\r\n",
 			"abc defg ijklmn zzxq\n"
 		)
 	def test_make_upper_case( self_ ):
 		self_.check_scenario(
 			"<up><home><right><right><right><m-u><m-u><right><m-u><cr><c-d>",
-			"<c9><ceos>abcdefg hijklmno pqrstuvw<rst><gray><rst><c34><c9><ceos>abcdefg "
-			"hijklmno pqrstuvw<rst><c9><c9><ceos>abcdefg hijklmno "
-			"pqrstuvw<rst><c10><c9><ceos>abcdefg hijklmno "
-			"pqrstuvw<rst><c11><c9><ceos>abcdefg hijklmno "
-			"pqrstuvw<rst><c12><c9><ceos>abcDEFG hijklmno "
-			"pqrstuvw<rst><c16><c9><ceos>abcDEFG HIJKLMNO "
-			"pqrstuvw<rst><c25><c9><ceos>abcDEFG HIJKLMNO "
-			"pqrstuvw<rst><c26><c9><ceos>abcDEFG HIJKLMNO "
-			"PQRSTUVW<rst><gray><rst><c34><c9><ceos>abcDEFG HIJKLMNO "
-			"PQRSTUVW<rst><c34>\r\n"
+			"<c9><ceos>abcdefg hijklmno pqrstuvw<c34><c9><ceos>abcdefg hijklmno pqrstuvw<c9>\x1b[C\x1b[C\x1b[C"
+			"<c9><ceos>abcDEFG hijklmno pqrstuvw<c16><c9><ceos>abcDEFG HIJKLMNO pqrstuvw<c25>\x1b[C"
+			"<c9><ceos>abcDEFG HIJKLMNO PQRSTUVW<c34><c9><ceos>abcDEFG HIJKLMNO PQRSTUVW<c34>\r\n"
 			"abcDEFG HIJKLMNO PQRSTUVW\r\n",
 			"abcdefg hijklmno pqrstuvw\n"
 		)
 	def test_make_lower_case( self_ ):
 		self_.check_scenario(
 			"<up><home><right><right><right><m-l><m-l><right><m-l><cr><c-d>",
-			"<c9><ceos>ABCDEFG HIJKLMNO PQRSTUVW<rst><gray><rst><c34><c9><ceos>ABCDEFG "
-			"HIJKLMNO PQRSTUVW<rst><c9><c9><ceos>ABCDEFG HIJKLMNO "
-			"PQRSTUVW<rst><c10><c9><ceos>ABCDEFG HIJKLMNO "
-			"PQRSTUVW<rst><c11><c9><ceos>ABCDEFG HIJKLMNO "
-			"PQRSTUVW<rst><c12><c9><ceos>ABCdefg HIJKLMNO "
-			"PQRSTUVW<rst><c16><c9><ceos>ABCdefg hijklmno "
-			"PQRSTUVW<rst><c25><c9><ceos>ABCdefg hijklmno "
-			"PQRSTUVW<rst><c26><c9><ceos>ABCdefg hijklmno "
-			"pqrstuvw<rst><gray><rst><c34><c9><ceos>ABCdefg hijklmno "
-			"pqrstuvw<rst><c34>\r\n"
+			"<c9><ceos>ABCDEFG HIJKLMNO PQRSTUVW<c34><c9><ceos>ABCDEFG HIJKLMNO PQRSTUVW<c9>\x1b[C\x1b[C\x1b[C"
+			"<c9><ceos>ABCdefg HIJKLMNO PQRSTUVW<c16><c9><ceos>ABCdefg hijklmno PQRSTUVW<c25>\x1b[C"
+			"<c9><ceos>ABCdefg hijklmno pqrstuvw<c34><c9><ceos>ABCdefg hijklmno pqrstuvw<c34>\r\n"
 			"ABCdefg hijklmno pqrstuvw\r\n",
 			"ABCDEFG HIJKLMNO PQRSTUVW\n"
 		)
 	def test_transpose( self_ ):
 		self_.check_scenario(
 			"<up><home><c-t><right><c-t><c-t><c-t><c-t><c-t><cr><c-d>",
-			"<c9><ceos>abcd<rst><gray><rst><c13>"
-			"<c9><ceos>abcd<rst><c9>"
-			"<c9><ceos>abcd<rst><c10>"
-			"<c9><ceos>bacd<rst><c11>"
-			"<c9><ceos>bcad<rst><c12>"
-			"<c9><ceos>bcda<rst><gray><rst><c13>"
-			"<c9><ceos>bcad<rst><gray><rst><c13>"
-			"<c9><ceos>bcda<rst><gray><rst><c13>"
-			"<c9><ceos>bcda<rst><c13>\r\n"
+			"<c9><ceos>abcd<c13><c9><ceos>abcd<c9>\x1b[C<c9><ceos>bacd<c11><c9><ceos>bcad<c12><c9><ceos>bcda<c13><c9><ceos>bcad<c13>"
+			"<c9><ceos>bcda<c13><c9><ceos>bcda<c13>\r\n"
 			"bcda\r\n",
 			"abcd\n"
 		)
 	def test_kill_to_beginning_of_line( self_ ):
 		self_.check_scenario(
 			"<up><home><c-right><c-right><right><c-u><end><c-y><cr><c-d>",
-			"<c9><ceos><brightblue>+<rst>abc defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><gray><rst><c32><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c9><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c13><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c18><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c19><c9><ceos><brightblue>-<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c9><c9><ceos><brightblue>-<rst>ijklmn "
-			"zzxq<brightblue>+<rst><gray><rst><c22><c9><ceos><brightblue>-<rst>ijklmn "
-			"zzxq<brightblue>++<rst>abc "
-			"defg<brightblue>-<rst><gray><rst><c32><c9><ceos><brightblue>-<rst>ijklmn "
-			"zzxq<brightblue>++<rst>abc defg<brightblue>-<rst><c32>\r\n"
+			"<c9><ceos><brightblue>+<rst>abc defg<brightblue>--<rst>ijklmn zzxq<brightblue>+<rst><c32>"
+			"<c9><ceos><brightblue>+<rst>abc defg<brightblue>--<rst>ijklmn zzxq<brightblue>+<rst><c9>\x1b[4C\x1b[5C\x1b[C"
+			"<c9><ceos><brightblue>-<rst>ijklmn zzxq<brightblue>+<rst><c9>"
+			"<c9><ceos><brightblue>-<rst>ijklmn zzxq<brightblue>+<rst><c22>"
+			"<c9><ceos><brightblue>-<rst>ijklmn zzxq<brightblue>++<rst>abc defg<brightblue>-<rst><c32>"
+			"<c9><ceos><brightblue>-<rst>ijklmn zzxq<brightblue>++<rst>abc defg<brightblue>-<rst><c32>\r\n"
 			"-ijklmn zzxq++abc defg-\r\n",
 			"+abc defg--ijklmn zzxq+\n"
 		)
 	def test_kill_to_end_of_line( self_ ):
 		self_.check_scenario(
 			"<up><home><c-right><c-right><right><c-k><home><c-y><cr><c-d>",
-			"<c9><ceos><brightblue>+<rst>abc defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><gray><rst><c32><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c9><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c13><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c18><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>--<rst>ijklmn "
-			"zzxq<brightblue>+<rst><c19><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>-<rst><gray><rst><c19><c9><ceos><brightblue>+<rst>abc "
-			"defg<brightblue>-<rst><c9><c9><ceos><brightblue>-<rst>ijklmn "
-			"zzxq<brightblue>++<rst>abc "
-			"defg<brightblue>-<rst><c22><c9><ceos><brightblue>-<rst>ijklmn "
-			"zzxq<brightblue>++<rst>abc defg<brightblue>-<rst><c32>\r\n"
+			"<c9><ceos><brightblue>+<rst>abc defg<brightblue>--<rst>ijklmn zzxq<brightblue>+<rst><c32>"
+			"<c9><ceos><brightblue>+<rst>abc defg<brightblue>--<rst>ijklmn zzxq<brightblue>+<rst><c9>\x1b[4C\x1b[5C\x1b[C"
+			"<c9><ceos><brightblue>+<rst>abc defg<brightblue>-<rst><c19><c9><ceos><brightblue>+<rst>abc defg<brightblue>-<rst><c9>"
+			"<c9><ceos><brightblue>-<rst>ijklmn zzxq<brightblue>++<rst>abc defg<brightblue>-<rst><c22>"
+			"<c9><ceos><brightblue>-<rst>ijklmn zzxq<brightblue>++<rst>abc defg<brightblue>-<rst><c32>\r\n"
 			"-ijklmn zzxq++abc defg-\r\n",
 			"+abc defg--ijklmn zzxq+\n"
 		)
 	def test_kill_next_word( self_ ):
 		self_.check_scenario(
 			"<up><home><c-right><m-d><c-right><c-y><cr><c-d>",
-			"<c9><ceos>alpha charlie bravo delta<rst><gray><rst><c34><c9><ceos>alpha "
-			"charlie bravo delta<rst><c9><c9><ceos>alpha charlie bravo "
-			"delta<rst><c14><c9><ceos>alpha bravo delta<rst><c14><c9><ceos>alpha bravo "
-			"delta<rst><c20><c9><ceos>alpha bravo charlie delta<rst><c28><c9><ceos>alpha "
-			"bravo charlie delta<rst><c34>\r\n"
+			"<c9><ceos>alpha charlie bravo delta<c34><c9><ceos>alpha charlie bravo delta<c9>\x1b[5C<c9><ceos>alpha bravo delta<c14>\x1b[6C"
+			"<c9><ceos>alpha bravo charlie delta<c28><c9><ceos>alpha bravo charlie delta<c34>\r\n"
 			"alpha bravo charlie delta\r\n",
 			"alpha charlie bravo delta\n"
 		)
 	def test_kill_prev_word_to_white_space( self_ ):
 		self_.check_scenario(
 			"<up><c-left><c-w><c-left><c-y><cr><c-d>",
-			"<c9><ceos>alpha charlie bravo delta<rst><gray><rst><c34><c9><ceos>alpha "
-			"charlie bravo delta<rst><c29><c9><ceos>alpha charlie "
-			"delta<rst><c23><c9><ceos>alpha charlie delta<rst><c15><c9><ceos>alpha bravo "
-			"charlie delta<rst><c21><c9><ceos>alpha bravo charlie delta<rst><c34>\r\n"
+			"<c9><ceos>alpha charlie bravo delta<c34><c9><ceos>alpha charlie bravo delta<c29><c9><ceos>alpha charlie delta<c23>\x1b[8D"
+			"<c9><ceos>alpha bravo charlie delta<c21><c9><ceos>alpha bravo charlie delta<c34>\r\n"
 			"alpha bravo charlie delta\r\n",
 			"alpha charlie bravo delta\n"
 		)
 	def test_kill_prev_word( self_ ):
 		self_.check_scenario(
 			"<up><c-left><m-backspace><c-left><c-y><cr><c-d>",
-			"<c9><ceos>alpha<brightmagenta>.<rst>charlie "
-			"bravo<brightmagenta>.<rst>delta<rst><gray><rst><c34><c9><ceos>alpha<brightmagenta>.<rst>charlie "
-			"bravo<brightmagenta>.<rst>delta<rst><c29><c9><ceos>alpha<brightmagenta>.<rst>charlie "
-			"delta<rst><c23><c9><ceos>alpha<brightmagenta>.<rst>charlie "
-			"delta<rst><c15><c9><ceos>alpha<brightmagenta>.<rst>bravo<brightmagenta>.<rst>charlie "
-			"delta<rst><c21><c9><ceos>alpha<brightmagenta>.<rst>bravo<brightmagenta>.<rst>charlie "
-			"delta<rst><c34>\r\n"
+			"<c9><ceos>alpha<brightmagenta>.<rst>charlie bravo<brightmagenta>.<rst>delta<c34>"
+			"<c9><ceos>alpha<brightmagenta>.<rst>charlie bravo<brightmagenta>.<rst>delta<c29>"
+			"<c9><ceos>alpha<brightmagenta>.<rst>charlie delta<c23>\x1b[8D"
+			"<c9><ceos>alpha<brightmagenta>.<rst>bravo<brightmagenta>.<rst>charlie delta<c21>"
+			"<c9><ceos>alpha<brightmagenta>.<rst>bravo<brightmagenta>.<rst>charlie delta<c34>\r\n"
 			"alpha.bravo.charlie delta\r\n",
 			"alpha.charlie bravo.delta\n"
 		)
 	def test_kill_ring( self_ ):
 		self_.check_scenario(
 			"<up><c-w><backspace><c-w><backspace><c-w><backspace><c-u><c-y><m-y><m-y><m-y> <c-y><m-y><m-y><m-y> <c-y><m-y><m-y><m-y> <c-y><m-y><m-y><m-y><cr><c-d>",
-			"<c9><ceos>delta charlie bravo alpha<rst><gray><rst><c34><c9><ceos>delta "
-			"charlie bravo <rst><gray><rst><c29><c9><ceos>delta charlie "
-			"bravo<rst><gray><rst><c28><c9><ceos>delta charlie "
-			"<rst><gray><rst><c23><c9><ceos>delta "
-			"charlie<rst><gray><rst><c22><c9><ceos>delta "
-			"<rst><gray><rst><c15>"
-			"<c9><ceos>delta<rst><gray><rst><c14>"
-			"<c9><ceos><rst><gray><rst><c9>"
-			"<c9><ceos>delta<rst><gray><rst><c14>"
-			"<c9><ceos>charlie<rst><gray><rst><c16>"
-			"<c9><ceos>bravo<rst><gray><rst><c14>"
-			"<c9><ceos>alpha<rst><gray><rst><c14>"
-			"<c9><ceos>alpha "
-			"<rst><gray><rst><c15><c9><ceos>alpha "
-			"alpha<rst><gray><rst><c20><c9><ceos>alpha "
-			"delta<rst><gray><rst><c20><c9><ceos>alpha "
-			"charlie<rst><gray><rst><c22><c9><ceos>alpha "
-			"bravo<rst><gray><rst><c20><c9><ceos>alpha bravo "
-			"<rst><gray><rst><c21><c9><ceos>alpha bravo "
-			"bravo<rst><gray><rst><c26><c9><ceos>alpha bravo "
-			"alpha<rst><gray><rst><c26><c9><ceos>alpha bravo "
-			"delta<rst><gray><rst><c26><c9><ceos>alpha bravo "
-			"charlie<rst><gray><rst><c28><c9><ceos>alpha bravo charlie "
-			"<rst><gray><rst><c29><c9><ceos>alpha bravo charlie "
-			"charlie<rst><gray><rst><c36><c9><ceos>alpha bravo charlie "
-			"bravo<rst><gray><rst><c34><c9><ceos>alpha bravo charlie "
-			"alpha<rst><gray><rst><c34><c9><ceos>alpha bravo charlie "
-			"delta<rst><gray><rst><c34><c9><ceos>alpha bravo charlie delta<rst><c34>\r\n"
+			"<c9><ceos>delta charlie bravo alpha<c34><c9><ceos>delta charlie bravo <c29><c9><ceos>delta charlie bravo<c28>"
+			"<c9><ceos>delta charlie <c23><c9><ceos>delta charlie<c22><c9><ceos>delta <c15><c9><ceos>delta<c14><c9><ceos><c9>"
+			"<c9><ceos>delta<c14><c9><ceos>charlie<c16><c9><ceos>bravo<c14><c9><ceos>alpha<c14> <c9><ceos>alpha alpha<c20>"
+			"<c9><ceos>alpha delta<c20><c9><ceos>alpha charlie<c22><c9><ceos>alpha bravo<c20> <c9><ceos>alpha bravo bravo<c26>"
+			"<c9><ceos>alpha bravo alpha<c26><c9><ceos>alpha bravo delta<c26><c9><ceos>alpha bravo charlie<c28> "
+			"<c9><ceos>alpha bravo charlie charlie<c36><c9><ceos>alpha bravo charlie bravo<c34>"
+			"<c9><ceos>alpha bravo charlie alpha<c34><c9><ceos>alpha bravo charlie delta<c34>"
+			"<c9><ceos>alpha bravo charlie delta<c34>\r\n"
 			"alpha bravo charlie delta\r\n",
 			"delta charlie bravo alpha\n"
 		)
 		self_.check_scenario(
 			"<up><c-w><c-w><backspace><c-a><c-y> <cr><c-d>",
-			"<c9><ceos>charlie delta alpha bravo<rst><gray><rst><c34><c9><ceos>charlie "
-			"delta alpha <rst><gray><rst><c29><c9><ceos>charlie delta "
-			"<rst><gray><rst><c23><c9><ceos>charlie "
-			"delta<rst><gray><rst><c22><c9><ceos>charlie delta<rst><c9><c9><ceos>alpha "
-			"bravocharlie delta<rst><c20><c9><ceos>alpha bravo charlie "
-			"delta<rst><c21><c9><ceos>alpha bravo charlie delta<rst><c34>\r\n"
+			"<c9><ceos>charlie delta alpha bravo<c34><c9><ceos>charlie delta alpha <c29><c9><ceos>charlie delta <c23>"
+			"<c9><ceos>charlie delta<c22><c9><ceos>charlie delta<c9><c9><ceos>alpha bravocharlie delta<c20>"
+			"<c9><ceos>alpha bravo charlie delta<c21><c9><ceos>alpha bravo charlie delta<c34>\r\n"
 			"alpha bravo charlie delta\r\n",
 			"charlie delta alpha bravo\n"
 		)
 		self_.check_scenario(
 			"<up><home><m-d><m-d><del><c-e> <c-y><cr><c-d>",
-			"<c9><ceos>charlie delta alpha bravo<rst><gray><rst><c34><c9><ceos>charlie "
-			"delta alpha bravo<rst><c9><c9><ceos> delta alpha bravo<rst><c9><c9><ceos> "
-			"alpha bravo<rst><c9><c9><ceos>alpha bravo<rst><c9><c9><ceos>alpha "
-			"bravo<rst><gray><rst><c20><c9><ceos>alpha bravo "
-			"<rst><gray><rst><c21><c9><ceos>alpha bravo charlie "
-			"delta<rst><gray><rst><c34><c9><ceos>alpha bravo charlie delta<rst><c34>\r\n"
+			"<c9><ceos>charlie delta alpha bravo<c34><c9><ceos>charlie delta alpha bravo<c9><c9><ceos> delta alpha bravo<c9>"
+			"<c9><ceos> alpha bravo<c9><c9><ceos>alpha bravo<c9><c9><ceos>alpha bravo<c20> <c9><ceos>alpha bravo charlie delta<c34>"
+			"<c9><ceos>alpha bravo charlie delta<c34>\r\n"
 			"alpha bravo charlie delta\r\n",
 			"charlie delta alpha bravo\n"
 		)
@@ -889,99 +1051,104 @@ class ReplxxTests( unittest.TestCase ):
 			"<up><c-w><backspace><c-w><backspace><c-w><backspace><c-w><backspace><c-w><backspace>"
 			"<c-w><backspace><c-w><backspace><c-w><backspace><c-w><backspace><c-w><backspace>"
 			"<c-w><c-y><m-y><m-y><m-y><m-y><m-y><m-y><m-y><m-y><m-y><m-y><cr><c-d>",
-			"<c9><ceos>a b c d e f g h i j k<rst><gray><rst><c30><c9><ceos>a b c d e f g "
-			"h i j <rst><gray><rst><c29><c9><ceos>a b c d e f g h i "
-			"j<rst><gray><rst><c28><c9><ceos>a b c d e f g h i "
-			"<rst><gray><rst><c27><c9><ceos>a b c d e f g h "
-			"i<rst><gray><rst><c26><c9><ceos>a b c d e f g h "
-			"<rst><gray><rst><c25><c9><ceos>a b c d e f g "
-			"h<rst><gray><rst><c24><c9><ceos>a b c d e f g "
-			"<rst><gray><rst><c23><c9><ceos>a b c d e f g<rst><gray><rst><c22><c9><ceos>a "
-			"b c d e f <rst><gray><rst><c21><c9><ceos>a b c d e "
-			"f<rst><gray><rst><c20><c9><ceos>a b c d e <rst><gray><rst><c19><c9><ceos>a b "
-			"c d e<rst><gray><rst><c18><c9><ceos>a b c d <rst><gray><rst><c17><c9><ceos>a "
-			"b c d<rst><gray><rst><c16><c9><ceos>a b c <rst><gray><rst><c15><c9><ceos>a b "
-			"c<rst><gray><rst><c14><c9><ceos>a b <rst><gray><rst><c13><c9><ceos>a "
-			"b<rst><gray><rst><c12><c9><ceos>a "
-			"<rst><gray><rst><c11>"
-			"<c9><ceos>a<rst><gray><rst><c10>"
-			"<c9><ceos><rst><gray><rst><c9>"
-			"<c9><ceos>a<rst><gray><rst><c10>"
-			"<c9><ceos>b<rst><gray><rst><c10>"
-			"<c9><ceos>c<rst><gray><rst><c10>"
-			"<c9><ceos>d<rst><gray><rst><c10>"
-			"<c9><ceos>e<rst><gray><rst><c10>"
-			"<c9><ceos>f<rst><gray><rst><c10>"
-			"<c9><ceos>g<rst><gray><rst><c10>"
-			"<c9><ceos>h<rst><gray><rst><c10>"
-			"<c9><ceos>i<rst><gray><rst><c10>"
-			"<c9><ceos>j<rst><gray><rst><c10>"
-			"<c9><ceos>a<rst><gray><rst><c10>"
-			"<c9><ceos>a<rst><c10>\r\n"
+			"<c9><ceos>a b c d e f g h i j k<c30><c9><ceos>a b c d e f g h i j <c29><c9><ceos>a b c d e f g h i j<c28>"
+			"<c9><ceos>a b c d e f g h i <c27><c9><ceos>a b c d e f g h i<c26><c9><ceos>a b c d e f g h <c25>"
+			"<c9><ceos>a b c d e f g h<c24><c9><ceos>a b c d e f g <c23><c9><ceos>a b c d e f g<c22><c9><ceos>a b c d e f <c21>"
+			"<c9><ceos>a b c d e f<c20><c9><ceos>a b c d e <c19><c9><ceos>a b c d e<c18><c9><ceos>a b c d <c17><c9><ceos>a b c d<c16>"
+			"<c9><ceos>a b c <c15><c9><ceos>a b c<c14><c9><ceos>a b <c13><c9><ceos>a b<c12><c9><ceos>a <c11><c9><ceos>a<c10>"
+			"<c9><ceos><c9><c9><ceos>a<c10><c9><ceos>b<c10><c9><ceos>c<c10><c9><ceos>d<c10><c9><ceos>e<c10><c9><ceos>f<c10>"
+			"<c9><ceos>g<c10><c9><ceos>h<c10><c9><ceos>i<c10><c9><ceos>j<c10><c9><ceos>a<c10><c9><ceos>a<c10>\r\n"
 			"a\r\n",
 			"a b c d e f g h i j k\n"
 		)
+		self_.check_scenario(
+			"<up><c-w><backspace><c-w><backspace><c-w><backspace><c-u><c-y><m-y><m-y><m-y><cr><c-d>",
+			"<c9><ceos>delta charlie bravo alpha<c34><c9><ceos>delta charlie bravo <c29><c9><ceos>delta charlie bravo<c28>"
+			"<c9><ceos>delta charlie <c23><c9><ceos>delta charlie<c22><c9><ceos>delta <c15><c9><ceos>delta<c14><c9><ceos><c9>"
+			"<c9><ceos>delta<c14><c9><ceos>charlie<c16><c9><ceos>bravo<c14><c9><ceos>delta<c14><c9><ceos>delta<c14>\r\n"
+			"delta\r\n",
+			"delta charlie bravo alpha\n",
+			command = ReplxxTests._cSample_ + " q1 k3"
+		)
+		self_.check_scenario(
+			"<up><c-w><backspace><c-w><backspace><c-w><backspace><c-u><c-y><m-y><m-y><cr><c-d>",
+			"<c9><ceos>delta charlie bravo alpha<c34><c9><ceos>delta charlie bravo <c29><c9><ceos>delta charlie bravo<c28>"
+			"<c9><ceos>delta charlie <c23><c9><ceos>delta charlie<c22><c9><ceos>delta <c15><c9><ceos>delta<c14><c9><ceos><c9>"
+			"<c9><ceos>delta<c14><c9><ceos>charlie<c16><c9><ceos>delta<c14><c9><ceos>delta<c14>\r\n"
+			"delta\r\n",
+			"delta charlie bravo alpha\n",
+			command = ReplxxTests._cSample_ + " q1 k10,12"
+		)
+	def test_undo( self_ ):
+		self_.check_scenario(
+			"hello world<c-_><c-_><c-_><m-_><m-_><m-_>!<m-_><cr><c-d>",
+			"<c9><ceos>h<c10>e<c11><green>llo<rst><c11>llo wo<c17><green>rld<rst><c17>rld<c9><ceos>hello<c14><c9><ceos><c9><bell>"
+			"<c9><ceos>hello<c14><c9><ceos>hello world<c20><bell>!<bell><c9><ceos>hello world!<c21>\r\n"
+			"hello world!\r\n"
+		)
+		self_.check_scenario(
+			"<up><c-w><c-y> <c-y><c-_><c-_><c-_><m-_><c-_><c-_><c-_><cr><c-d>",
+			"<c9><ceos>alpha bravo<c20><c9><ceos>alpha <c15><c9><ceos>alpha bravo<c20> <c9><ceos>alpha bravo bravo<c26>"
+			"<c9><ceos>alpha bravo <c21><c9><ceos>alpha bravo<c20><c9><ceos>alpha <c15><c9><ceos>alpha bravo<c20>"
+			"<c9><ceos>alpha <c15><c9><ceos>alpha bravo<c20><c9><ceos><c9><c9><ceos><c9>\r\n",
+			"alpha bravo\n"
+		)
+		self_.check_scenario(
+			"<up><home><m-u><left><left><c-t><c-_><c-_><c-_><c-_><cr><c-d>",
+			"<c9><ceos>alpha bravo<c20><c9><ceos>alpha bravo<c9><c9><ceos>ALPHA bravo<c14>\x1b[D\x1b[D<c9><ceos>ALHPA bravo<c13>"
+			"<c9><ceos>ALPHA bravo<c12><c9><ceos>alpha bravo<c9><c9><ceos><c9><bell><c9><ceos><c9>\r\n",
+			"alpha bravo\n"
+		)
 	def test_tab_completion_cutoff( self_ ):
 		self_.check_scenario(
 			"<tab>n<tab>y<cr><c-d>",
-			"<c9><ceos><rst><gray><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"Display all 9 possibilities? (y or n)\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><gray><rst><c9>\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n"
 			"Display all 9 possibilities? (y or n)<ceos>\r\n"
-			"<brightmagenta><rst>db            <brightmagenta><rst>hallo         "
-			"<brightmagenta><rst>hansekogge    <brightmagenta><rst>quetzalcoatl  "
-			"<brightmagenta><rst>power\r\n"
-			"<brightmagenta><rst>hello         <brightmagenta><rst>hans          "
-			"<brightmagenta><rst>seamann       <brightmagenta><rst>quit\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"<brightmagenta><rst>db            <brightmagenta><rst>hallo         <brightmagenta><rst>hansekogge    <brightmagenta><rst>quetzalcoatl  <brightmagenta><rst>power\r\n"
+			"<brightmagenta><rst>hello         <brightmagenta><rst>hans          <brightmagenta><rst>seamann       <brightmagenta><rst>quit\r\n"
+			"<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			command = ReplxxTests._cSample_ + " q1 c3"
 		)
 		self_.check_scenario(
 			"<tab>n<cr><c-d>",
-			"<c9><ceos><rst><gray><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"Display all 9 possibilities? (y or n)\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			command = ReplxxTests._cSample_ + " q1 c3"
 		)
 		self_.check_scenario(
 			"<tab><c-c><cr><c-d>",
-			"<c9><ceos><rst><gray><rst><c9>\r\n"
+			"<c9><ceos><c9>\r\n"
 			"Display all 9 possibilities? (y or n)^C\r\n"
-			"<brightgreen>replxx<rst>> "
-			"<c9><ceos><rst><gray><rst><c9><c9><ceos><rst><c9>\r\n",
+			"<brightgreen>replxx<rst>> <c9><ceos><c9><c9><ceos><c9>\r\n",
 			command = ReplxxTests._cSample_ + " q1 c3"
 		)
 	def test_preload( self_ ):
 		self_.check_scenario(
 			"<cr><c-d>",
-			"<c9><ceos>Alice has a cat.<rst><gray><rst><c25>"
-			"<c9><ceos>Alice has a cat.<rst><c25>\r\n"
+			"<c9><ceos>Alice has a cat.<c25><c9><ceos>Alice has a cat.<c25>\r\n"
 			"Alice has a cat.\r\n",
 			command = ReplxxTests._cSample_ + " q1 'iAlice has a cat.'"
 		)
 		self_.check_scenario(
 			"<cr><c-d>",
 			"<c9><ceos>Cat  eats  mice.\r\n"
-			"<rst><gray><rst><u1><c26><c9><ceos>Cat  eats  mice.\r\n"
-			"<rst><u1><c26>\r\n"
+			"<c1><c1>\r\n"
 			"Cat  eats  mice.\r\n"
 			"\r\n",
 			command = ReplxxTests._cSample_ + " q1 'iCat\teats\tmice.\r\n'"
 		)
 		self_.check_scenario(
 			"<cr><c-d>",
-			"<c9><ceos>M Alice has a cat.<rst><gray><rst><c27>"
-			"<c9><ceos>M Alice has a cat.<rst><c27>\r\n"
+			"<c9><ceos>M Alice has a cat.<c27><c9><ceos>M Alice has a cat.<c27>\r\n"
 			"M Alice has a cat.\r\n",
 			command = ReplxxTests._cSample_ + " q1 'iMAlice has a cat.'"
 		)
 		self_.check_scenario(
 			"<cr><c-d>",
-			"<c9><ceos>M  Alice has a cat.<rst><gray><rst><c28>"
-			"<c9><ceos>M  Alice has a cat.<rst><c28>\r\n"
+			"<c9><ceos>M  Alice has a cat.<c28><c9><ceos>M  Alice has a cat.<c28>\r\n"
 			"M  Alice has a cat.\r\n",
 			command = ReplxxTests._cSample_ + " q1 'iM\t\t\t\tAlice has a cat.'"
 		)
@@ -989,139 +1156,89 @@ class ReplxxTests( unittest.TestCase ):
 		prompt = "date: now\nrepl> "
 		self_.check_scenario(
 			"<up><cr><up><up><cr><c-d>",
-			"<c7><ceos>three<rst><gray><rst><c12><c7><ceos>three<rst><c12>\r\n"
+			"<c7><ceos>three<c12><c7><ceos>three<c12>\r\n"
 			"three\r\n"
 			"date: now\r\n"
-			"repl> "
-			"<c7><ceos>three<rst><gray><rst><c12><c7><ceos>two<rst><gray><rst><c10><c7><ceos>two<rst><c10>\r\n"
+			"repl> <c7><ceos>three<c12><c7><ceos>two<c10><c7><ceos>two<c10>\r\n"
 			"two\r\n",
 			command = ReplxxTests._cSample_ + " q1 'p{}'".format( prompt ),
 			prompt = prompt,
 			end = prompt + ReplxxTests._end_
 		)
+	def test_prompt_escapes( self_ ):
+		prompt = "\x1b]0;title\x07\x1b[38;5;200mX\x1b[0m> "
+		self_.check_scenario(
+			"<up><cr><c-d>",
+			"<c4><ceos>three<c9><c4><ceos>three<c9>\r\n"
+			"three\r\n",
+			command = ReplxxTests._cSample_ + " q1 'p{}'".format( prompt ),
+			prompt = re.escape( prompt ),
+			end = re.escape( prompt ) + ReplxxTests._end_
+		)
+	def test_rich_colors( self_ ):
+		self_.check_scenario(
+			"A1B2c<cr><c-d>",
+			"<c9><ceos>\x1b[4;38;5;208;44mA<rst><c10>1<c10>\x1b[38;2;255;128;0m1<rst><c11>B<c11>\x1b[4;38;5;208;44mB<rst><c12>2<c12>\x1b[38;2;255;128;0m2<rst><c13>c"
+			"<c9><ceos>\x1b[4;38;5;208;44mA\x1b[0;38;2;255;128;0m1\x1b[4;38;5;208;44mB\x1b[0;38;2;255;128;0m2<rst>c<c14>\r\n"
+			"A1B2c\r\n",
+			command = ReplxxTests._cSample_ + " q1 R1"
+		)
 	def test_long_line( self_ ):
 		self_.check_scenario(
 			"<up><c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left>~<c-left><cr><c-d>",
-			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin modula perl python "
-			"rust sql<rst><gray><rst><c2><u2><c9><ceos>ada clojure eiffel fortran groovy "
-			"java kotlin modula perl python rust sql<rst><u1><c39><u1><c9><ceos>ada "
-			"clojure eiffel fortran groovy java kotlin modula perl python rust "
-			"~sql<rst><u1><c40><u1><c9><ceos>ada clojure eiffel fortran groovy java "
-			"kotlin modula perl python rust ~sql<rst><u1><c34><u1><c9><ceos>ada clojure "
-			"eiffel fortran groovy java kotlin modula perl python ~rust "
-			"~sql<rst><u1><c35><u1><c9><ceos>ada clojure eiffel fortran groovy java "
-			"kotlin modula perl python ~rust ~sql<rst><u1><c27><u1><c9><ceos>ada clojure "
-			"eiffel fortran groovy java kotlin modula perl ~python ~rust "
-			"~sql<rst><u1><c28><u1><c9><ceos>ada clojure eiffel fortran groovy java "
-			"kotlin modula perl ~python ~rust ~sql<rst><u1><c22><u1><c9><ceos>ada clojure "
-			"eiffel fortran groovy java kotlin modula ~perl ~python ~rust "
-			"~sql<rst><u1><c23><u1><c9><ceos>ada clojure eiffel fortran groovy java "
-			"kotlin modula ~perl ~python ~rust ~sql<rst><u1><c15><u1><c9><ceos>ada "
-			"clojure eiffel fortran groovy java kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u1><c16><u1><c9><ceos>ada clojure eiffel fortran groovy java "
-			"kotlin ~modula ~perl ~python ~rust ~sql<rst><u1><c8><u1><c9><ceos>ada "
-			"clojure eiffel fortran groovy java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u1><c9><u1><c9><ceos>ada clojure eiffel fortran groovy java "
-			"~kotlin ~modula ~perl ~python ~rust ~sql<rst><u1><c3><u1><c9><ceos>ada "
-			"clojure eiffel fortran groovy ~java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u1><c4><u1><c9><ceos>ada clojure eiffel fortran groovy ~java "
-			"~kotlin ~modula ~perl ~python ~rust ~sql<rst><u2><c36><c9><ceos>ada clojure "
-			"eiffel fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u2><c37><c9><ceos>ada clojure eiffel fortran ~groovy ~java ~kotlin "
-			"~modula ~perl ~python ~rust ~sql<rst><u2><c28><c9><ceos>ada clojure eiffel "
-			"~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u2><c29><c9><ceos>ada clojure eiffel ~fortran ~groovy ~java "
-			"~kotlin ~modula ~perl ~python ~rust ~sql<rst><u2><c21><c9><ceos>ada clojure "
-			"~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u2><c22><c9><ceos>ada clojure ~eiffel ~fortran ~groovy ~java "
-			"~kotlin ~modula ~perl ~python ~rust ~sql<rst><u2><c13><c9><ceos>ada ~clojure "
-			"~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u2><c14><c9><ceos>ada ~clojure ~eiffel ~fortran ~groovy ~java "
-			"~kotlin ~modula ~perl ~python ~rust ~sql<rst><u2><c9><c9><ceos>~ada ~clojure "
-			"~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><u2><c10><c9><ceos>~ada ~clojure ~eiffel ~fortran ~groovy ~java "
-			"~kotlin ~modula ~perl ~python ~rust ~sql<rst><u2><c9><c9><ceos>~ada ~clojure "
-			"~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust "
-			"~sql<rst><c14>\r\n"
-			"~ada ~clojure ~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python "
-			"~rust ~sql\r\n",
+			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin modula perl python rust sql<c2><u2>"
+			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin modula perl python rust sql<u1><c39><u1>"
+			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin modula perl python rust ~sql<u1><c40>\x1b[6D<u1>"
+			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin modula perl python ~rust ~sql<u1><c35>\x1b[8D<u1>"
+			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin modula perl ~python ~rust ~sql<u1><c28>\x1b[6D<u1>"
+			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin modula ~perl ~python ~rust ~sql<u1><c23>\x1b[8D<u1>"
+			"<c9><ceos>ada clojure eiffel fortran groovy java kotlin ~modula ~perl ~python ~rust ~sql<u1><c16>\x1b[8D<u1>"
+			"<c9><ceos>ada clojure eiffel fortran groovy java ~kotlin ~modula ~perl ~python ~rust ~sql<u1><c9>\x1b[6D<u1>"
+			"<c9><ceos>ada clojure eiffel fortran groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql<u1><c4>\x1b[A\x1b[32C"
+			"<c9><ceos>ada clojure eiffel fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql<u2><c37>\x1b[9D"
+			"<c9><ceos>ada clojure eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql<u2><c29>\x1b[8D"
+			"<c9><ceos>ada clojure ~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql<u2><c22>\x1b[9D"
+			"<c9><ceos>ada ~clojure ~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql<u2><c14>\x1b[5D"
+			"<c9><ceos>~ada ~clojure ~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql<u2><c10>\x1b[D"
+			"<c9><ceos>~ada ~clojure ~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql<c14>\r\n"
+			"~ada ~clojure ~eiffel ~fortran ~groovy ~java ~kotlin ~modula ~perl ~python ~rust ~sql\r\n",
 			" ".join( _words_[::3] ) + "\n",
 			dimensions = ( 10, 40 )
 		)
 	def test_colors( self_ ):
 		self_.check_scenario(
 			"<up><cr><c-d>",
-			"<c9><ceos><black>color_black<rst> <red>color_red<rst> "
-			"<green>color_green<rst> <brown>color_brown<rst> <blue>color_blue<rst> "
-			"<magenta>color_magenta<rst> <cyan>color_cyan<rst> "
-			"<lightgray>color_lightgray<rst> <gray>color_gray<rst> "
-			"<brightred>color_brightred<rst> <brightgreen>color_brightgreen<rst> "
-			"<yellow>color_yellow<rst> <brightblue>color_brightblue<rst> "
-			"<brightmagenta>color_brightmagenta<rst> <brightcyan>color_brightcyan<rst> "
-			"<white>color_white<rst><green><rst><c70><u2><c9><ceos><black>color_black<rst> "
-			"<red>color_red<rst> <green>color_green<rst> <brown>color_brown<rst> "
-			"<blue>color_blue<rst> <magenta>color_magenta<rst> <cyan>color_cyan<rst> "
-			"<lightgray>color_lightgray<rst> <gray>color_gray<rst> "
-			"<brightred>color_brightred<rst> <brightgreen>color_brightgreen<rst> "
-			"<yellow>color_yellow<rst> <brightblue>color_brightblue<rst> "
-			"<brightmagenta>color_brightmagenta<rst> <brightcyan>color_brightcyan<rst> "
-			"<white>color_white<rst><c70>\r\n"
-			"color_black color_red color_green color_brown color_blue color_magenta "
-			"color_cyan color_lightgray color_gray color_brightred color_brightgreen "
-			"color_yellow color_brightblue color_brightmagenta color_brightcyan "
-			"color_white\r\n",
+			"<c9><ceos><black>color_black<rst> <red>color_red<rst> <green>color_green<rst> <brown>color_brown<rst> <blue>color_blue<rst> <magenta>color_magenta<rst> <cyan>color_cyan<rst> <lightgray>color_lightgray<rst> <gray>color_gray<rst> <brightred>color_brightred<rst> <brightgreen>color_brightgreen<rst> <yellow>color_yellow<rst> <brightblue>color_brightblue<rst> <brightmagenta>color_brightmagenta<rst> <brightcyan>color_brightcyan<rst> <white>color_white<rst><c70><u2>"
+			"<c9><ceos><black>color_black<rst> <red>color_red<rst> <green>color_green<rst> <brown>color_brown<rst> <blue>color_blue<rst> <magenta>color_magenta<rst> <cyan>color_cyan<rst> <lightgray>color_lightgray<rst> <gray>color_gray<rst> <brightred>color_brightred<rst> <brightgreen>color_brightgreen<rst> <yellow>color_yellow<rst> <brightblue>color_brightblue<rst> <brightmagenta>color_brightmagenta<rst> <brightcyan>color_brightcyan<rst> <white>color_white<rst><c70>\r\n"
+			"color_black color_red color_green color_brown color_blue color_magenta color_cyan color_lightgray color_gray color_brightred color_brightgreen color_yellow color_brightblue color_brightmagenta color_brightcyan color_white\r\n",
 			"color_black color_red color_green color_brown color_blue color_magenta color_cyan color_lightgray"
 			" color_gray color_brightred color_brightgreen color_yellow color_brightblue color_brightmagenta color_brightcyan color_white\n"
 		)
 	def test_word_break_characters( self_ ):
 		self_.check_scenario(
 			"<up><c-left>x<c-left><c-left>x<c-left><c-left>x<c-left><c-left>x<c-left><c-left>x<c-left><c-left>x<cr><c-d>",
-			"<c9><ceos>one_two three-four five_six "
-			"seven-eight<rst><gray><rst><c48><c9><ceos>one_two three-four five_six "
-			"seven-eight<rst><c43><c9><ceos>one_two three-four five_six "
-			"seven-xeight<rst><c44><c9><ceos>one_two three-four five_six "
-			"seven-xeight<rst><c43><c9><ceos>one_two three-four five_six "
-			"seven-xeight<rst><c37><c9><ceos>one_two three-four five_six "
-			"xseven-xeight<rst><c38><c9><ceos>one_two three-four five_six "
-			"xseven-xeight<rst><c37><c9><ceos>one_two three-four five_six "
-			"xseven-xeight<rst><c28><c9><ceos>one_two three-four xfive_six "
-			"xseven-xeight<rst><c29><c9><ceos>one_two three-four xfive_six "
-			"xseven-xeight<rst><c28><c9><ceos>one_two three-four xfive_six "
-			"xseven-xeight<rst><c23><c9><ceos>one_two three-xfour xfive_six "
-			"xseven-xeight<rst><c24><c9><ceos>one_two three-xfour xfive_six "
-			"xseven-xeight<rst><c23><c9><ceos>one_two three-xfour xfive_six "
-			"xseven-xeight<rst><c17><c9><ceos>one_two xthree-xfour xfive_six "
-			"xseven-xeight<rst><c18><c9><ceos>one_two xthree-xfour xfive_six "
-			"xseven-xeight<rst><c17><c9><ceos>one_two xthree-xfour xfive_six "
-			"xseven-xeight<rst><c9><c9><ceos>xone_two xthree-xfour xfive_six "
-			"xseven-xeight<rst><c10><c9><ceos>xone_two xthree-xfour xfive_six "
-			"xseven-xeight<rst><c54>\r\n"
+			"<c9><ceos>one_two three-four five_six seven-eight<c48><c9><ceos>one_two three-four five_six seven-eight<c43>"
+			"<c9><ceos>one_two three-four five_six seven-xeight<c44>\x1b[D\x1b[6D"
+			"<c9><ceos>one_two three-four five_six xseven-xeight<c38>\x1b[D\x1b[9D"
+			"<c9><ceos>one_two three-four xfive_six xseven-xeight<c29>\x1b[D\x1b[5D"
+			"<c9><ceos>one_two three-xfour xfive_six xseven-xeight<c24>\x1b[D\x1b[6D"
+			"<c9><ceos>one_two xthree-xfour xfive_six xseven-xeight<c18>\x1b[D\x1b[8D"
+			"<c9><ceos>xone_two xthree-xfour xfive_six xseven-xeight<c10>"
+			"<c9><ceos>xone_two xthree-xfour xfive_six xseven-xeight<c54>\r\n"
 			"xone_two xthree-xfour xfive_six xseven-xeight\r\n",
 			"one_two three-four five_six seven-eight\n",
 			command = ReplxxTests._cSample_ + " q1 'w \t-'"
 		)
 		self_.check_scenario(
 			"<up><c-left>x<c-left><c-left>x<c-left><c-left>x<c-left><c-left>x<c-left><c-left>x<c-left><c-left>x<cr><c-d>",
-			"<c9><ceos>one_two three-four five_six "
-			"seven-eight<rst><gray><rst><c48><c9><ceos>one_two three-four five_six "
-			"seven-eight<rst><c37><c9><ceos>one_two three-four five_six "
-			"xseven-eight<rst><c38><c9><ceos>one_two three-four five_six "
-			"xseven-eight<rst><c37><c9><ceos>one_two three-four five_six "
-			"xseven-eight<rst><c33><c9><ceos>one_two three-four five_xsix "
-			"xseven-eight<rst><c34><c9><ceos>one_two three-four five_xsix "
-			"xseven-eight<rst><c33><c9><ceos>one_two three-four five_xsix "
-			"xseven-eight<rst><c28><c9><ceos>one_two three-four xfive_xsix "
-			"xseven-eight<rst><c29><c9><ceos>one_two three-four xfive_xsix "
-			"xseven-eight<rst><c28><c9><ceos>one_two three-four xfive_xsix "
-			"xseven-eight<rst><c17><c9><ceos>one_two xthree-four xfive_xsix "
-			"xseven-eight<rst><c18><c9><ceos>one_two xthree-four xfive_xsix "
-			"xseven-eight<rst><c17><c9><ceos>one_two xthree-four xfive_xsix "
-			"xseven-eight<rst><c13><c9><ceos>one_xtwo xthree-four xfive_xsix "
-			"xseven-eight<rst><c14><c9><ceos>one_xtwo xthree-four xfive_xsix "
-			"xseven-eight<rst><c13><c9><ceos>one_xtwo xthree-four xfive_xsix "
-			"xseven-eight<rst><c9><c9><ceos>xone_xtwo xthree-four xfive_xsix "
-			"xseven-eight<rst><c10><c9><ceos>xone_xtwo xthree-four xfive_xsix "
-			"xseven-eight<rst><c54>\r\n"
+			"<c9><ceos>one_two three-four five_six seven-eight<c48><c9><ceos>one_two three-four five_six seven-eight<c37>"
+			"<c9><ceos>one_two three-four five_six xseven-eight<c38>\x1b[D\x1b[4D"
+			"<c9><ceos>one_two three-four five_xsix xseven-eight<c34>\x1b[D\x1b[5D"
+			"<c9><ceos>one_two three-four xfive_xsix xseven-eight<c29>\x1b[D\x1b[11D"
+			"<c9><ceos>one_two xthree-four xfive_xsix xseven-eight<c18>\x1b[D\x1b[4D"
+			"<c9><ceos>one_xtwo xthree-four xfive_xsix xseven-eight<c14>\x1b[D\x1b[4D"
+			"<c9><ceos>xone_xtwo xthree-four xfive_xsix xseven-eight<c10>"
+			"<c9><ceos>xone_xtwo xthree-four xfive_xsix xseven-eight<c54>\r\n"
 			"xone_xtwo xthree-four xfive_xsix xseven-eight\r\n",
 			"one_two three-four five_six seven-eight\n",
 			command = ReplxxTests._cSample_ + " q1 'w \t_'"
@@ -1147,6 +1264,9 @@ class ReplxxTests( unittest.TestCase ):
 	def test_no_terminal( self_ ):
 		res = subprocess.run( [ ReplxxTests._cSample_, "q1" ], input = b"replxx FTW!\n", stdout = subprocess.PIPE, stderr = subprocess.PIPE )
 		self_.assertSequenceEqual( res.stdout, b"starting...\nreplxx FTW!\n\nExiting Replxx\n" )
+	def test_no_terminal_batch( self_ ):
+		res = subprocess.run( [ ReplxxTests._cSample_, "q1", "B2" ], input = b"one\r\ntwo\n\nthree\nfour", stdout = subprocess.PIPE, stderr = subprocess.PIPE )
+		self_.assertSequenceEqual( res.stdout, b"starting...\none\ntwo\n\nthree\nfour\n\nExiting Replxx\n" )
 
 def parseArgs( self, func, argv ):
 	global verbosity